@@ -0,0 +1,478 @@
+/**
+ * @file   bench.c
+ * @brief  Headless compile and preview benchmark
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include <gtksourceview/gtksource.h>
+#include <poppler.h>
+
+#include "configfile.h"
+#include "constants.h"
+#include "editor.h"
+#include "environment.h"
+#include "external.h"
+#include "latex.h"
+#include "pagediff.h"
+#include "utils.h"
+#include "gui/gui-render.h"
+
+/* gummi-bench drives the compile and preview pipeline without a display:
+ * the editor buffer is written to the workfile, compiled with the configured
+ * typesetter, the PDF is loaded and diffed the way the preview does it and
+ * the part of the document that would be visible is rendered through the
+ * tile cache. Every corpus document is compiled once cold and then edited
+ * and recompiled for the requested number of runs. The latencies of each
+ * stage, the peak memory use and the cache statistics are printed as JSON
+ * on stdout, all other output goes to stderr. */
+
+extern Gummi* gummi;
+
+enum {
+    STAGE_WORKFILE = 0,
+    STAGE_COMPILE,
+    STAGE_LOAD,
+    STAGE_RENDER,
+    STAGE_TOTAL,
+    N_STAGES
+};
+
+static const gchar* stage_names[N_STAGES] = {
+    "workfile", "compile", "load", "render", "total"
+};
+
+static gchar* corpus = NULL;
+static gchar* output = NULL;
+static gchar* typesetter = NULL;
+static gint runs = 10;
+static gdouble scale = 1.0;
+static int debug = 0;
+
+static GOptionEntry entries[] = {
+    { "corpus", 'c', 0, G_OPTION_ARG_FILENAME, &corpus,
+        "directory with the .tex documents to compile", "DIR" },
+    { "runs", 'n', 0, G_OPTION_ARG_INT, &runs,
+        "number of edit and compile runs per document (default 10)", "N" },
+    { "scale", 's', 0, G_OPTION_ARG_DOUBLE, &scale,
+        "preview zoom level to render at (default 1.0)", "SCALE" },
+    { "typesetter", 't', 0, G_OPTION_ARG_STRING, &typesetter,
+        "typesetter to use instead of the default", "NAME" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+        "write the report to FILE instead of stdout", "FILE" },
+    { "debug", 'd', 0, G_OPTION_ARG_NONE, &debug,
+        "show debug info", NULL },
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+typedef struct {
+    gchar* name;
+    gint n_pages;
+    guint64* signatures;
+    guint* revisions;
+    gboolean signed_pages;
+    guint revision;
+
+    GArray* samples[N_STAGES];  /* gdouble milliseconds, warm runs only */
+    gdouble cold[N_STAGES];
+    gint changed_pages;
+    gint tiles;
+    GuRenderCache* cache;
+} BenchDocument;
+
+static gdouble bench_ms_since (gint64* start) {
+    gint64 now = g_get_monotonic_time ();
+    gdouble ms = (now - *start) / 1000.0;
+    *start = now;
+    return ms;
+}
+
+static gint bench_compare_double (gconstpointer a, gconstpointer b) {
+    gdouble da = *(const gdouble*)a;
+    gdouble db = *(const gdouble*)b;
+    return (da > db) - (da < db);
+}
+
+static gint bench_compare_name (gconstpointer a, gconstpointer b) {
+    return g_strcmp0 (*(gchar* const*)a, *(gchar* const*)b);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static gdouble bench_percentile (GArray* sorted, gdouble p) {
+    gint rank = 0;
+
+    if (sorted->len == 0) return 0;
+    rank = (gint)ceil (p / 100.0 * sorted->len) - 1;
+    rank = CLAMP (rank, 0, (gint)sorted->len - 1);
+    return g_array_index (sorted, gdouble, rank);
+}
+
+/* Loads the compiled document the way the preview does: unchanged pages
+ * keep their revision so their cached tiles stay valid. Returns the first
+ * changed page, or -1 when nothing changed. */
+static gint bench_load (BenchDocument* bd, const gchar* pdffile) {
+    gchar* uri = g_filename_to_uri (pdffile, NULL, NULL);
+    PopplerDocument* doc = poppler_document_new_from_file (uri, NULL, NULL);
+    guint64* signatures = NULL;
+    guint* revisions = NULL;
+    gboolean signed_pages = FALSE;
+    gint n_pages = 0, first_changed = -1, i;
+
+    g_free (uri);
+    if (doc == NULL) return -1;
+
+    n_pages = poppler_document_get_n_pages (doc);
+    signatures = g_new0 (guint64, n_pages);
+    revisions = g_new0 (guint, n_pages);
+    signed_pages = pagediff_scan (pdffile, n_pages, signatures);
+
+    for (i = 0; i < n_pages; i++) {
+        if (signed_pages && bd->signed_pages && i < bd->n_pages &&
+            bd->signatures[i] == signatures[i]) {
+            revisions[i] = bd->revisions[i];
+            continue;
+        }
+        PopplerPage* page = poppler_document_get_page (doc, i);
+        gdouble width, height;
+        poppler_page_get_size (page, &width, &height);
+        g_object_unref (page);
+
+        revisions[i] = ++bd->revision;
+        bd->changed_pages++;
+        if (first_changed < 0) first_changed = i;
+    }
+
+    g_free (bd->signatures);
+    g_free (bd->revisions);
+    bd->signatures = signatures;
+    bd->revisions = revisions;
+    bd->signed_pages = signed_pages;
+    bd->n_pages = n_pages;
+    g_object_unref (doc);
+    return first_changed;
+}
+
+static void bench_render_page (BenchDocument* bd, PopplerDocument* doc,
+                               gint page) {
+    PopplerPage* ppage = NULL;
+    gdouble width, height;
+    gint cols, rows, tx, ty;
+
+    if (page < 0 || page >= bd->n_pages) return;
+    if (!(ppage = poppler_document_get_page (doc, page))) return;
+
+    poppler_page_get_size (ppage, &width, &height);
+    cols = (gint)ceil (width * scale / TILE_SIZE);
+    rows = (gint)ceil (height * scale / TILE_SIZE);
+
+    for (ty = 0; ty < rows; ty++) {
+        for (tx = 0; tx < cols; tx++) {
+            GuRenderKey key = { page, tx, ty, scale, bd->revisions[page] };
+            cairo_surface_t* surface = NULL;
+            gint x, y, w, h;
+
+            if (rendercache_lookup (bd->cache, &key)) continue;
+
+            render_tile_rect (ppage, scale, tx, ty, &x, &y, &w, &h);
+            if ((surface = render_tile (ppage, scale, x, y, w, h))) {
+                rendercache_insert (bd->cache, &key, surface);
+                cairo_surface_destroy (surface);
+                bd->tiles++;
+            }
+        }
+    }
+    g_object_unref (ppage);
+}
+
+/* Renders the first page and the first changed page, which is what the
+ * preview shows while somebody types at the start of a document or in
+ * the middle of it */
+static void bench_render (BenchDocument* bd, const gchar* pdffile,
+                          gint changed) {
+    gchar* uri = g_filename_to_uri (pdffile, NULL, NULL);
+    PopplerDocument* doc = poppler_document_new_from_file (uri, NULL, NULL);
+
+    g_free (uri);
+    if (doc == NULL) return;
+
+    rendercache_new_frame (bd->cache);
+    bench_render_page (bd, doc, 0);
+    if (changed > 0) bench_render_page (bd, doc, changed);
+    g_object_unref (doc);
+}
+
+static gboolean bench_document (BenchDocument* bd, const gchar* texfile,
+                                GuLatex* latex) {
+    GuEditor* ec = g_new0 (GuEditor, 1);
+    GtkTextBuffer* buffer = NULL;
+    GtkTextIter start, match;
+    gchar* text = NULL;
+    gboolean ok = TRUE;
+    gint run, i;
+
+    if (!g_file_get_contents (texfile, &text, NULL, NULL)) return FALSE;
+
+    ec->workfd = -1;
+    ec->log = logparser_new ();
+    ec->buffer = gtk_source_buffer_new (NULL);
+    buffer = GTK_TEXT_BUFFER (ec->buffer);
+    gtk_text_buffer_set_text (buffer, text, -1);
+    g_free (text);
+    editor_fileinfo_update (ec, texfile);
+
+    for (run = 0; run <= runs && ok; run++) {
+        gdouble stage[N_STAGES] = { 0 };
+        gint64 t = g_get_monotonic_time ();
+        gint64 t0 = t;
+        gint changed = 0;
+
+        /* Every run after the cold one types a word after the marker */
+        if (run > 0) {
+            gtk_text_buffer_get_start_iter (buffer, &start);
+            if (gtk_text_iter_forward_search (&start, "% bench-edit\n", 0,
+                                              NULL, &match, NULL)) {
+                gtk_text_buffer_insert (buffer, &match, "edited ", -1);
+            } else {
+                gtk_text_buffer_get_end_iter (buffer, &match);
+                gtk_text_buffer_insert (buffer, &match, "%", -1);
+            }
+            bench_ms_since (&t);
+        }
+
+        latex_update_workfile (ec);
+        stage[STAGE_WORKFILE] = bench_ms_since (&t);
+
+        g_atomic_int_set (&ec->modified_since_compile, TRUE);
+        ok = latex_update_pdffile (latex, ec);
+        stage[STAGE_COMPILE] = bench_ms_since (&t);
+        if (!ok) {
+            slog (L_ERROR, "Compiling %s failed:\n%s\n", texfile,
+                           ec->compilelog);
+            break;
+        }
+
+        changed = bench_load (bd, ec->pdffile);
+        stage[STAGE_LOAD] = bench_ms_since (&t);
+
+        bench_render (bd, ec->pdffile, changed);
+        stage[STAGE_RENDER] = bench_ms_since (&t);
+        stage[STAGE_TOTAL] = (t - t0) / 1000.0;
+
+        for (i = 0; i < N_STAGES; i++) {
+            if (run == 0) bd->cold[i] = stage[i];
+            else g_array_append_val (bd->samples[i], stage[i]);
+        }
+        slog (L_INFO, "%s run %d: %.1f ms, %d pages\n", bd->name, run,
+                      stage[STAGE_TOTAL], bd->n_pages);
+    }
+
+    editor_fileinfo_cleanup (ec);
+    g_object_unref (ec->buffer);
+    snapshot_unref (ec->snapshot);
+    logparser_free (ec->log);
+    depgraph_free (ec->deps);
+    g_free (ec->compilelog);
+    g_free (ec->compiled_hash);
+    g_free (ec);
+    return ok;
+}
+
+static void bench_report_document (GString* json, BenchDocument* bd) {
+    gint i;
+
+    g_string_append_printf (json, "    {\n      \"name\": \"%s\",\n"
+                                  "      \"pages\": %d,\n"
+                                  "      \"changed_pages\": %d,\n"
+                                  "      \"rendered_tiles\": %d,\n"
+                                  "      \"stages\": {\n",
+                            bd->name, bd->n_pages, bd->changed_pages,
+                            bd->tiles);
+    for (i = 0; i < N_STAGES; i++) {
+        GArray* s = bd->samples[i];
+        g_array_sort (s, bench_compare_double);
+        g_string_append_printf (json,
+            "        \"%s\": { \"cold_ms\": %.3f, \"p50_ms\": %.3f, "
+            "\"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f }%s\n",
+            stage_names[i], bd->cold[i], bench_percentile (s, 50),
+            bench_percentile (s, 90), bench_percentile (s, 99),
+            bench_percentile (s, 100), i + 1 < N_STAGES ? "," : "");
+    }
+    g_string_append_printf (json, "      },\n      \"cache\": { "
+            "\"hits\": %" G_GUINT64_FORMAT ", "
+            "\"misses\": %" G_GUINT64_FORMAT ", "
+            "\"evictions\": %" G_GUINT64_FORMAT ", "
+            "\"size_bytes\": %" G_GSIZE_FORMAT ", "
+            "\"max_size_bytes\": %" G_GSIZE_FORMAT " }\n    }",
+            bd->cache->hits, bd->cache->misses, bd->cache->evictions,
+            bd->cache->size, bd->cache->max_size);
+}
+
+int main (int argc, char *argv[]) {
+    GError* error = NULL;
+    GOptionContext* context = g_option_context_new ("- benchmark the "
+                                                     "compile pipeline");
+    GPtrArray* documents = g_ptr_array_new ();
+    GString* json = NULL;
+    GDir* dir = NULL;
+    const gchar* name = NULL;
+    gchar* home = NULL;
+    gchar* path = NULL;
+    gboolean ok = TRUE;
+    struct rusage self, children;
+    guint i;
+
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 2;
+    }
+    if (corpus == NULL || runs < 1 || scale <= 0) {
+        g_printerr ("%s", g_option_context_get_help (context, TRUE, NULL));
+        return 2;
+    }
+
+    /* Keep the user's configuration and cache out of the measurements,
+     * this has to happen before glib looks up the XDG directories */
+    if (!(home = g_dir_make_tmp ("gummi-bench-XXXXXX", &error))) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    path = g_build_filename (home, "config", NULL);
+    g_setenv ("XDG_CONFIG_HOME", path, TRUE);
+    g_free (path);
+    path = g_build_filename (home, "cache", NULL);
+    g_setenv ("XDG_CACHE_HOME", path, TRUE);
+    g_mkdir_with_parents (C_TMPDIR, DIR_PERMS);
+    g_free (path);
+
+    slog_init (debug);
+    config_init ();
+    if (typesetter) {
+        config_set_string ("Compile", "typesetter", typesetter);
+    }
+    if (!external_exists (config_get_string ("Compile", "typesetter"))) {
+        slog (L_ERROR, "Could not locate the typesetter program\n");
+        utils_remove_tree (home);
+        return 77;
+    }
+
+    GuLatex* latex = latex_init ();
+    external_probe_wait ();
+    gummi = gummi_init (NULL, NULL, latex, NULL, NULL, NULL, NULL, NULL);
+
+    /* The documents are copied so the workfiles do not end up in the
+     * source tree */
+    if (!(dir = g_dir_open (corpus, 0, &error))) {
+        g_printerr ("%s\n", error->message);
+        utils_remove_tree (home);
+        return 1;
+    }
+    while ((name = g_dir_read_name (dir))) {
+        if (g_str_has_suffix (name, ".tex"))
+            g_ptr_array_add (documents, g_strdup (name));
+    }
+    g_dir_close (dir);
+    g_ptr_array_sort (documents, bench_compare_name);
+
+    json = g_string_new ("{\n");
+    g_string_append_printf (json, "  \"version\": \"%s\",\n"
+                                  "  \"typesetter\": \"%s\",\n"
+                                  "  \"runs\": %d,\n"
+                                  "  \"scale\": %.2f,\n"
+                                  "  \"documents\": [\n",
+                            C_PACKAGE_VERSION,
+                            config_get_string ("Compile", "typesetter"),
+                            runs, scale);
+
+    for (i = 0; i < documents->len && ok; i++) {
+        BenchDocument bd;
+        gchar* src = g_build_filename (corpus, documents->pdata[i], NULL);
+        gchar* dst = g_build_filename (home, documents->pdata[i], NULL);
+        gchar* text = NULL;
+        gsize len = 0;
+        gint s;
+
+        memset (&bd, 0, sizeof (bd));
+        bd.name = g_strndup (documents->pdata[i],
+                             strlen (documents->pdata[i]) - 4);
+        for (s = 0; s < N_STAGES; s++)
+            bd.samples[s] = g_array_new (FALSE, FALSE, sizeof (gdouble));
+        bd.cache = rendercache_new ((gsize)config_get_integer (
+                        "Preview", "cache_size") * 1024 * 1024);
+        rendercache_use_scale (bd.cache, scale);
+
+        if (g_file_get_contents (src, &text, &len, NULL) &&
+            g_file_set_contents (dst, text, len, NULL)) {
+            ok = bench_document (&bd, dst, latex);
+        } else {
+            slog (L_ERROR, "Could not copy %s\n", src);
+            ok = FALSE;
+        }
+
+        if (ok) {
+            if (i > 0) g_string_append (json, ",\n");
+            bench_report_document (json, &bd);
+        }
+
+        for (s = 0; s < N_STAGES; s++)
+            g_array_free (bd.samples[s], TRUE);
+        rendercache_free (bd.cache);
+        g_free (bd.signatures);
+        g_free (bd.revisions);
+        g_free (bd.name);
+        g_free (text);
+        g_free (src);
+        g_free (dst);
+    }
+
+    getrusage (RUSAGE_SELF, &self);
+    getrusage (RUSAGE_CHILDREN, &children);
+    g_string_append_printf (json, "\n  ],\n"
+                                  "  \"peak_rss_kb\": %ld,\n"
+                                  "  \"children_peak_rss_kb\": %ld\n}\n",
+                            self.ru_maxrss, children.ru_maxrss);
+
+    if (ok) {
+        if (output) {
+            ok = g_file_set_contents (output, json->str, json->len, NULL);
+        } else {
+            fputs (json->str, stdout);
+        }
+    }
+
+    g_string_free (json, TRUE);
+    g_ptr_array_free (documents, TRUE);
+    utils_remove_tree (home);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,457 @@
+/**
+ * @file   bibindex.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bibindex.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "utils.h"
+
+typedef struct {
+    const gchar* word;
+    guint entry;
+} BibTerm;
+
+typedef struct {
+    const gchar* p;
+    const gchar* end;
+    GHashTable* macros;     /* lower case @string name -> value */
+} BibScanner;
+
+/* Characters BibTeX does not allow in identifiers */
+#define BIB_SPECIAL "\"#%'(),={}"
+
+static void bib_entry_free (gpointer data) {
+    GuBibEntry* entry = data;
+    g_free (entry->type);
+    g_free (entry->key);
+    g_free (entry->title);
+    g_free (entry->author);
+    g_free (entry->year);
+    g_free (entry->crossref);
+    g_free (entry);
+}
+
+static void scan_space (BibScanner* s) {
+    while (s->p < s->end && g_ascii_isspace (*s->p)) ++s->p;
+}
+
+static gchar* scan_ident (BibScanner* s) {
+    const gchar* start = s->p;
+    while (s->p < s->end && !g_ascii_isspace (*s->p) &&
+           !strchr (BIB_SPECIAL, *s->p)) {
+        ++s->p;
+    }
+    return g_ascii_strdown (start, s->p - start);
+}
+
+/* Appends the text between the delimiters, nested braces included. The
+ * scanner is left behind the closing delimiter. */
+static gboolean scan_delimited (BibScanner* s, GString* out) {
+    gchar close = (*s->p == '"')? '"': '}';
+    gint depth = 0;
+
+    for (++s->p; s->p < s->end; ++s->p) {
+        if (*s->p == '{') {
+            ++depth;
+        } else if (*s->p == '}' && depth > 0) {
+            --depth;
+        } else if (*s->p == close && depth == 0) {
+            ++s->p;
+            return TRUE;
+        } else if (*s->p == '\\' && s->p + 1 < s->end) {
+            /* \{ and \" don't count as delimiters */
+            g_string_append_c (out, *s->p++);
+        }
+        g_string_append_c (out, *s->p);
+    }
+    return FALSE;
+}
+
+/* value = part { '#' part }, a part being {..}, "..", a number or the name
+ * of a @string macro */
+static gboolean scan_value (BibScanner* s, GString* out) {
+    for (;;) {
+        scan_space (s);
+        if (s->p >= s->end) return FALSE;
+
+        if (*s->p == '{' || *s->p == '"') {
+            if (!scan_delimited (s, out)) return FALSE;
+        } else if (g_ascii_isdigit (*s->p)) {
+            while (s->p < s->end && g_ascii_isdigit (*s->p))
+                g_string_append_c (out, *s->p++);
+        } else {
+            gchar* name = scan_ident (s);
+            const gchar* value = g_hash_table_lookup (s->macros, name);
+            if (!*name) {
+                g_free (name);
+                return FALSE;
+            }
+            if (value) g_string_append (out, value);
+            g_free (name);
+        }
+
+        scan_space (s);
+        if (s->p < s->end && *s->p == '#') {
+            ++s->p;
+            continue;
+        }
+        return TRUE;
+    }
+}
+
+/* Skips a {..} or (..) group whose opening delimiter was consumed */
+static void scan_skip_group (BibScanner* s, gchar close) {
+    gint depth = 0;
+    for (; s->p < s->end; ++s->p) {
+        if (*s->p == '{') {
+            ++depth;
+        } else if (*s->p == '}' && depth > 0) {
+            --depth;
+        } else if (*s->p == close && depth == 0) {
+            ++s->p;
+            return;
+        }
+    }
+}
+
+static gchar* bib_display_value (const gchar* value) {
+    GString* out = g_string_sized_new (strlen (value));
+    gboolean space = FALSE;
+    const gchar* c = NULL;
+
+    for (c = value; *c; ++c) {
+        if (*c == '{' || *c == '}' || *c == '$') continue;
+        if (g_ascii_isspace (*c)) {
+            space = out->len > 0;
+            continue;
+        }
+        if (space) g_string_append_c (out, ' ');
+        g_string_append_c (out, *c);
+        space = FALSE;
+    }
+    return g_string_free (out, FALSE);
+}
+
+static void bib_entry_set (GuBibEntry* entry, const gchar* field,
+                           const gchar* value) {
+    gchar** slot = NULL;
+
+    if (STR_EQU (field, "title")) slot = &entry->title;
+    else if (STR_EQU (field, "author")) slot = &entry->author;
+    else if (STR_EQU (field, "year")) slot = &entry->year;
+    else if (STR_EQU (field, "crossref")) slot = &entry->crossref;
+    else return;
+
+    g_free (*slot);
+    *slot = bib_display_value (value);
+}
+
+static GuBibEntry* scan_entry (BibScanner* s, gchar* type, gchar close) {
+    GuBibEntry* entry = g_new0 (GuBibEntry, 1);
+    GString* value = g_string_new (NULL);
+    const gchar* start = NULL;
+
+    entry->type = type;
+
+    scan_space (s);
+    start = s->p;
+    while (s->p < s->end && *s->p != ',' && *s->p != close &&
+           !g_ascii_isspace (*s->p)) {
+        ++s->p;
+    }
+    entry->key = g_strndup (start, s->p - start);
+
+    for (;;) {
+        gchar* field = NULL;
+
+        scan_space (s);
+        if (s->p >= s->end) break;
+        if (*s->p == ',') {
+            ++s->p;
+            continue;
+        }
+        if (*s->p == close) {
+            ++s->p;
+            break;
+        }
+
+        field = scan_ident (s);
+        scan_space (s);
+        if (!*field || s->p >= s->end || *s->p != '=') {
+            /* malformed, resynchronize at the end of the entry */
+            g_free (field);
+            scan_skip_group (s, close);
+            break;
+        }
+        ++s->p;
+
+        g_string_truncate (value, 0);
+        if (!scan_value (s, value)) {
+            g_free (field);
+            scan_skip_group (s, close);
+            break;
+        }
+        bib_entry_set (entry, field, value->str);
+        g_free (field);
+    }
+    g_string_free (value, TRUE);
+
+    if (!*entry->key) {
+        bib_entry_free (entry);
+        return NULL;
+    }
+    return entry;
+}
+
+static void scan_string (BibScanner* s, gchar close) {
+    GString* value = g_string_new (NULL);
+    gchar* name = NULL;
+
+    scan_space (s);
+    name = scan_ident (s);
+    scan_space (s);
+    if (*name && s->p < s->end && *s->p == '=') {
+        ++s->p;
+        if (scan_value (s, value)) {
+            g_hash_table_replace (s->macros, name, g_string_free (value, FALSE));
+            name = NULL;
+            value = NULL;
+        }
+    }
+    scan_skip_group (s, close);
+    g_free (name);
+    if (value) g_string_free (value, TRUE);
+}
+
+static void bib_resolve_crossrefs (GPtrArray* entries) {
+    GHashTable* keys = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+    guint i = 0;
+
+    for (i = 0; i < entries->len; ++i) {
+        GuBibEntry* entry = g_ptr_array_index (entries, i);
+        g_hash_table_insert (keys, g_ascii_strdown (entry->key, -1), entry);
+    }
+    for (i = 0; i < entries->len; ++i) {
+        GuBibEntry* entry = g_ptr_array_index (entries, i);
+        GuBibEntry* parent = NULL;
+        gchar* key = NULL;
+
+        if (!entry->crossref) continue;
+        key = g_ascii_strdown (entry->crossref, -1);
+        if ((parent = g_hash_table_lookup (keys, key)) && parent != entry) {
+            if (!entry->title) entry->title = g_strdup (parent->title);
+            if (!entry->author) entry->author = g_strdup (parent->author);
+            if (!entry->year) entry->year = g_strdup (parent->year);
+        }
+        g_free (key);
+    }
+    g_hash_table_destroy (keys);
+}
+
+/* Splits @text into case folded alphanumeric words */
+static gchar** bib_split_words (const gchar* text) {
+    GPtrArray* words = g_ptr_array_new ();
+    gchar* folded = g_utf8_casefold (text, -1);
+    gchar* start = NULL;
+    gchar* c = NULL;
+
+    for (c = folded; ; c = g_utf8_next_char (c)) {
+        gboolean alnum = *c && g_unichar_isalnum (g_utf8_get_char (c));
+        if (alnum && !start) {
+            start = c;
+        } else if (!alnum && start) {
+            g_ptr_array_add (words, g_strndup (start, c - start));
+            start = NULL;
+        }
+        if (!*c) break;
+    }
+    g_ptr_array_add (words, NULL);
+    g_free (folded);
+    return (gchar**)g_ptr_array_free (words, FALSE);
+}
+
+static void bib_add_terms (GuBibIndex* bi, guint n, const gchar* text) {
+    gchar** words = NULL;
+    gint i = 0;
+
+    if (!text || !g_utf8_validate (text, -1, NULL)) return;
+
+    words = bib_split_words (text);
+    for (i = 0; words[i]; ++i) {
+        BibTerm term = { g_string_chunk_insert_const (bi->words, words[i]), n };
+        g_array_append_val (bi->terms, term);
+    }
+    g_strfreev (words);
+}
+
+static gint bib_term_compare (gconstpointer a, gconstpointer b) {
+    const BibTerm* ta = a;
+    const BibTerm* tb = b;
+    gint res = strcmp (ta->word, tb->word);
+    if (res == 0) return (ta->entry > tb->entry) - (ta->entry < tb->entry);
+    return res;
+}
+
+GuBibIndex* bibindex_new_from_text (const gchar* text, gsize length) {
+    GuBibIndex* bi = g_new0 (GuBibIndex, 1);
+    BibScanner s = { text, text + length, NULL };
+    guint i = 0;
+
+    bi->entries = g_ptr_array_new_with_free_func (bib_entry_free);
+    bi->terms = g_array_new (FALSE, FALSE, sizeof (BibTerm));
+    bi->words = g_string_chunk_new (4096);
+    s.macros = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    while (s.p < s.end) {
+        gchar* type = NULL;
+        gchar close = 0;
+
+        /* everything outside of entries is a comment */
+        if (!(s.p = memchr (s.p, '@', s.end - s.p))) break;
+        ++s.p;
+        scan_space (&s);
+        type = scan_ident (&s);
+        scan_space (&s);
+
+        if (!*type || s.p >= s.end || (*s.p != '{' && *s.p != '(')) {
+            g_free (type);
+            continue;
+        }
+        close = (*s.p++ == '{')? '}': ')';
+
+        if (STR_EQU (type, "comment") || STR_EQU (type, "preamble")) {
+            scan_skip_group (&s, close);
+            g_free (type);
+        } else if (STR_EQU (type, "string")) {
+            scan_string (&s, close);
+            g_free (type);
+        } else {
+            GuBibEntry* entry = scan_entry (&s, type, close);
+            if (entry) g_ptr_array_add (bi->entries, entry);
+        }
+    }
+    g_hash_table_destroy (s.macros);
+
+    bib_resolve_crossrefs (bi->entries);
+
+    for (i = 0; i < bi->entries->len; ++i) {
+        GuBibEntry* entry = g_ptr_array_index (bi->entries, i);
+        bib_add_terms (bi, i, entry->key);
+        bib_add_terms (bi, i, entry->title);
+        bib_add_terms (bi, i, entry->author);
+        bib_add_terms (bi, i, entry->year);
+    }
+    g_array_sort (bi->terms, bib_term_compare);
+    return bi;
+}
+
+GuBibIndex* bibindex_new_from_file (const gchar* filename, GError** err) {
+    GuBibIndex* bi = NULL;
+    gchar* text = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents (filename, &text, &length, err))
+        return NULL;
+
+    bi = bibindex_new_from_text (text, length);
+    g_free (text);
+    return bi;
+}
+
+void bibindex_free (GuBibIndex* bi) {
+    if (!bi) return;
+    g_ptr_array_free (bi->entries, TRUE);
+    g_array_free (bi->terms, TRUE);
+    g_string_chunk_free (bi->words);
+    g_free (bi);
+}
+
+guint bibindex_count (GuBibIndex* bi) {
+    return bi? bi->entries->len: 0;
+}
+
+GuBibEntry* bibindex_get (GuBibIndex* bi, guint n) {
+    g_return_val_if_fail (bi && n < bi->entries->len, NULL);
+    return g_ptr_array_index (bi->entries, n);
+}
+
+/* First term that is not smaller than @prefix */
+static guint bib_lower_bound (GuBibIndex* bi, const gchar* prefix) {
+    guint low = 0;
+    guint high = bi->terms->len;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        if (strcmp (g_array_index (bi->terms, BibTerm, mid).word, prefix) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+GArray* bibindex_search (GuBibIndex* bi, const gchar* query) {
+    GArray* result = NULL;
+    gchar** words = NULL;
+    guint* hits = NULL;
+    guint n_words = 0;
+    guint i = 0;
+
+    words = bib_split_words (query);
+    n_words = g_strv_length (words);
+    if (n_words == 0) {
+        g_strfreev (words);
+        return NULL;
+    }
+
+    /* hits[n] counts the leading query words that entry n matched */
+    hits = g_new0 (guint, bibindex_count (bi));
+    for (i = 0; i < n_words; ++i) {
+        gsize len = strlen (words[i]);
+        guint t = 0;
+
+        for (t = bib_lower_bound (bi, words[i]); t < bi->terms->len; ++t) {
+            BibTerm* term = &g_array_index (bi->terms, BibTerm, t);
+            if (strncmp (term->word, words[i], len) != 0) break;
+            if (hits[term->entry] == i) ++hits[term->entry];
+        }
+    }
+
+    result = g_array_new (FALSE, FALSE, sizeof (guint));
+    for (i = 0; i < bibindex_count (bi); ++i) {
+        if (hits[i] == n_words) g_array_append_val (result, i);
+    }
+    g_free (hits);
+    g_strfreev (words);
+    return result;
+}
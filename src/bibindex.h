@@ -0,0 +1,80 @@
+/**
+ * @file   bibindex.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_BIBINDEX_H__
+#define __GUMMI_BIBINDEX_H__
+
+#include <glib.h>
+
+#define GU_BIB_ENTRY(x) ((GuBibEntry*)x)
+typedef struct _GuBibEntry GuBibEntry;
+
+struct _GuBibEntry {
+    gchar* type;        /* lower case entry type, e.g. "article" */
+    gchar* key;
+    gchar* title;       /* display values with braces removed, or NULL */
+    gchar* author;
+    gchar* year;
+    gchar* crossref;
+};
+
+#define GU_BIB_INDEX(x) ((GuBibIndex*)x)
+typedef struct _GuBibIndex GuBibIndex;
+
+struct _GuBibIndex {
+    GPtrArray* entries;     /* GuBibEntry, in file order */
+    GArray* terms;          /* sorted words of the searchable fields */
+    GStringChunk* words;
+};
+
+/**
+ * bibindex_new_from_text:
+ *
+ * Tokenizes a BibTeX database in a single pass. @string macros, '#'
+ * concatenation, nested braces and quotes are handled, @comment and
+ * @preamble blocks are skipped and missing fields are inherited through
+ * crossref. Touches no GTK state, so it can run on any thread.
+ */
+GuBibIndex* bibindex_new_from_text (const gchar* text, gsize length);
+GuBibIndex* bibindex_new_from_file (const gchar* filename, GError** err);
+void bibindex_free (GuBibIndex* bi);
+
+guint bibindex_count (GuBibIndex* bi);
+GuBibEntry* bibindex_get (GuBibIndex* bi, guint n);
+
+/**
+ * bibindex_search:
+ *
+ * Returns the ascending indices of the entries that have, for every word
+ * of @query, a word in their key, title, author or year that starts with
+ * it. Case is ignored. Returns NULL when @query has no words at all.
+ */
+GArray* bibindex_search (GuBibIndex* bi, const gchar* query);
+
+#endif /* __GUMMI_BIBINDEX_H__ */
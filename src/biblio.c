@@ -37,6 +37,8 @@
 #include "latex.h"
 #include "utils.h"
 
+#include "compile/auxcache.h"
+
 
 extern GuEditor* ec;
 
@@ -59,6 +61,9 @@ GuBiblio* biblio_init (GtkBuilder* builder) {
     b->biblio_treeview =
         GTK_TREE_VIEW (gtk_builder_get_object (builder, "bibtreeview"));
 
+    /* the store gets replaced by biblio_load_entries */
+    g_object_ref (b->list_biblios);
+
     return b;
 }
 
@@ -92,115 +97,198 @@ gboolean biblio_detect_bibliography (GuEditor* ec) {
     return state;
 }
 
-gboolean biblio_compile_bibliography (GuBiblio* bc, GuEditor* ec) {
-    gchar* dirname = g_path_get_dirname (ec->workfile);
+/**
+ * @brief Runs bibtex for the text last written to the workfile of ec, from
+ * any thread. output receives what bibtex printed, NULL if it did not run
+ */
+gboolean biblio_run_bibtex (GuEditor* ec, gchar** output) {
+    gchar* dirname = NULL;
     gchar* auxname = NULL;
+    gchar* bibtex = NULL;
+    gchar* command = NULL;
+    gboolean success = FALSE;
 
-    if (ec->filename) {
-        auxname = g_strdup (ec->pdffile);
-        auxname[strlen (auxname) -4] = 0;
-    } else
-        auxname = g_strdup (ec->fdname);
+    if (output) *output = NULL;
 
-    if (g_find_program_in_path ("bibtex")) {
-        gboolean success = FALSE;
-        char* command = g_strdup_printf ("%s bibtex \"%s\"",
-                                         C_TEXSEC, auxname);
+    if (!(bibtex = g_find_program_in_path ("bibtex"))) {
+        slog (L_WARNING, "bibtex command is not present or executable.\n");
+        return FALSE;
+    }
+    g_free (bibtex);
 
-        g_free (auxname);
-        latex_update_workfile (ec);
+    /* the last compile already left an .aux file for this text */
+    if (!auxcache_aux_current (ec)) {
         latex_update_auxfile (ec);
-        Tuple2 res = utils_popen_r (command, dirname);
-        gtk_widget_set_tooltip_text (GTK_WIDGET (bc->progressbar),
-                (gchar*)res.second);
-        g_free (command);
-        g_free (dirname);
-        success = ! (strstr ((gchar*)res.second, "Database file #1") == NULL);
-        g_free (res.second);
-        return success;
     }
-    slog (L_WARNING, "bibtex command is not present or executable.\n");
+    if (!auxcache_pass_needed (ec, "bibtex")) {
+        return TRUE;
+    }
+
+    auxname = g_strdup (ec->jobfile);
+
+    dirname = g_path_get_dirname (ec->workfile);
+    command = g_strdup_printf ("%s bibtex \"%s\"", C_TEXSEC, auxname);
+    Tuple2 res = utils_popen_r (command, dirname);
+    g_free (command);
     g_free (auxname);
     g_free (dirname);
+
+    success = ! (strstr ((gchar*)res.second, "Database file #1") == NULL);
+    if (success) {
+        auxcache_pass_done (ec, "bibtex");
+    }
+    if (output) *output = (gchar*)res.second;
+    else g_free (res.second);
+    return success;
+}
+
+gboolean biblio_compile_bibliography (GuBiblio* bc, GuEditor* ec) {
+    gchar* output = NULL;
+    gboolean success = FALSE;
+
+    latex_update_workfile (ec);
+    success = biblio_run_bibtex (ec, &output);
+
+    if (output) {
+        gtk_widget_set_tooltip_text (GTK_WIDGET (bc->progressbar), output);
+    } else if (success) {
+        gtk_widget_set_tooltip_text (GTK_WIDGET (bc->progressbar),
+                _("Bibliography is up to date"));
+    }
+    g_free (output);
+    return success;
+}
+
+typedef struct {
+    GuBiblio* bc;
+    gchar* filename;
+    guint generation;
+    GuBibIndex* index;
+} BiblioLoad;
+
+static gboolean biblio_visible_func (GtkTreeModel* model, GtkTreeIter* iter,
+                                     gpointer data) {
+    GuBiblio* bc = GU_BIBLIO (data);
+    guint entry = 0;
+
+    if (!bc->visible) return TRUE;
+
+    gtk_tree_model_get (model, iter, 4, &entry, -1);
+    return entry < bibindex_count (bc->index) && bc->visible[entry];
+}
+
+void biblio_set_filter (GuBiblio* bc, const gchar* text) {
+    GtkTreeModel* filter = NULL;
+    GArray* matches = NULL;
+    guint i = 0;
+
+    g_free (bc->visible);
+    bc->visible = NULL;
+
+    if (bc->index && (matches = bibindex_search (bc->index, text))) {
+        bc->visible = g_new0 (guint8, bibindex_count (bc->index) + 1);
+        for (i = 0; i < matches->len; ++i)
+            bc->visible[g_array_index (matches, guint, i)] = TRUE;
+        g_array_free (matches, TRUE);
+    }
+
+    /* no filter model at all when everything is shown */
+    if (!bc->visible) {
+        gtk_tree_view_set_model (bc->biblio_treeview,
+                                 GTK_TREE_MODEL (bc->list_biblios));
+        return;
+    }
+    filter = gtk_tree_model_filter_new (GTK_TREE_MODEL (bc->list_biblios),
+                                        NULL);
+    gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (filter),
+                                            biblio_visible_func, bc, NULL);
+    gtk_tree_view_set_model (bc->biblio_treeview, filter);
+    g_object_unref (filter);
+}
+
+static void biblio_load_free (BiblioLoad* load) {
+    bibindex_free (load->index);
+    g_free (load->filename);
+    g_free (load);
+}
+
+static gboolean biblio_load_finished (gpointer user) {
+    BiblioLoad* load = user;
+    GuBiblio* bc = load->bc;
+    GtkListStore* store = NULL;
+    gchar* basename = NULL;
+    gchar* number = NULL;
+    guint i = 0;
+
+    if (load->generation != bc->generation) {
+        biblio_load_free (load);
+        return FALSE;
+    }
+    if (!load->index) {
+        gtk_label_set_text (bc->refnr_label, _("N/A"));
+        biblio_load_free (load);
+        return FALSE;
+    }
+
+    /* fill a store that is not attached to the view yet, so the view sees
+     * a single model change instead of one per row */
+    store = gtk_list_store_new (5, G_TYPE_STRING, G_TYPE_STRING,
+                                   G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT);
+    for (i = 0; i < bibindex_count (load->index); ++i) {
+        GuBibEntry* entry = bibindex_get (load->index, i);
+        gtk_list_store_insert_with_values (store, NULL, -1,
+                                           0, entry->key,
+                                           1, entry->title,
+                                           2, entry->author,
+                                           3, entry->year,
+                                           4, i, -1);
+    }
+
+    g_object_unref (bc->list_biblios);
+    bc->list_biblios = store;
+    bibindex_free (bc->index);
+    bc->index = load->index;
+    load->index = NULL;
+
+    biblio_set_filter (bc, gtk_entry_get_text (bc->list_filter));
+    gtk_widget_set_sensitive (GTK_WIDGET (bc->list_filter), TRUE);
+
+    basename = g_path_get_basename (load->filename);
+    number = g_strdup_printf ("%u", bibindex_count (bc->index));
+    gtk_label_set_text (bc->filenm_label, basename);
+    gtk_label_set_text (bc->refnr_label, number);
+
+    g_free (number);
+    g_free (basename);
+    biblio_load_free (load);
     return FALSE;
 }
 
-int biblio_parse_entries (GuBiblio* bc, gchar *bib_content) {
-    int entry_total = 0;
-
-    GtkTreeIter iter;
-    GRegex* regex_entry;
-    GRegex* subregex_ident;
-    GRegex* subregex_title;
-    GRegex* subregex_author;
-    GRegex* subregex_year;
-    GRegex* regex_formatting;
-
-    gchar* author_out = NULL;
-    gchar* title_out = NULL;
-
-    GMatchInfo *match_entry;
-
-    regex_entry = g_regex_new (
-        "(@article|@book|@booklet|@conference|@inbook|@incollection|"
-        "@inproceedings|@manual|@mastersthesis|@misc|@phdthesis|"
-        "@proceedings|@techreport|@unpublished)([^@]*)",
-        (G_REGEX_CASELESS | G_REGEX_DOTALL), 0, NULL);
-
-    subregex_ident = g_regex_new ("@.+{([^,]+),", 0, 0, NULL);
-    subregex_title = g_regex_new
-		("[^book]title[\\s]*=[\\s]*(.*)", G_REGEX_CASELESS, 0, NULL);
-    subregex_author = g_regex_new
-		("author[\\s]*=[\\s]*(.*)", G_REGEX_CASELESS, 0, NULL);
-    subregex_year = g_regex_new
-		("year[\\s]*=[\\s]*[{|\"]?([1|2][0-9]{3})", G_REGEX_CASELESS, 0, NULL);
-    regex_formatting = g_regex_new ("[{|}|\"|,|\\$]", 0, 0, NULL);
-
-
-    g_regex_match (regex_entry, bib_content, 0, &match_entry);
-
-    while (g_match_info_matches (match_entry)) {
-
-        gchar *entry = g_match_info_fetch (match_entry, 0);
-
-        gchar **ident_res = g_regex_split (subregex_ident, entry, 0);
-        gchar **title_res = g_regex_split (subregex_title, entry, 0);
-        gchar **author_res = g_regex_split (subregex_author, entry, 0);
-        gchar **year_res = g_regex_split (subregex_year, entry, 0);
-
-        if (author_res[1])
-            author_out = g_regex_replace (regex_formatting, author_res[1],
-                                         -1, 0, "", 0, 0);
-        else author_out = NULL;
-
-        if (title_res[1])
-            title_out = g_regex_replace (regex_formatting, title_res[1],
-                                         -1, 0, "", 0, 0);
-        else title_out = NULL;
-
-        gtk_list_store_append (bc->list_biblios, &iter);
-        gtk_list_store_set (bc->list_biblios, &iter, 0, ident_res[1],
-                                                    1, title_out,
-                                                    2, author_out,
-                                                    3, year_res[1], -1);
-        g_free (author_out);
-        g_free (title_out);
-        g_strfreev (ident_res);
-        g_strfreev (title_res);
-        g_strfreev (author_res);
-        g_strfreev (year_res);
-        g_free (entry);
-        ++entry_total;
-
-        g_match_info_next (match_entry, NULL);
+static gpointer biblio_load_thread (gpointer user) {
+    BiblioLoad* load = user;
+    GError* err = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    load->index = bibindex_new_from_file (load->filename, &err);
+    if (load->index) {
+        slog (L_DEBUG, "indexed %u bibliography entries in %.1f ms\n",
+                        bibindex_count (load->index),
+                        (g_get_monotonic_time () - start) / 1000.0);
+    } else {
+        slog (L_ERROR, "unable to index %s: %s\n", load->filename,
+                        err->message);
+        g_error_free (err);
     }
-    g_match_info_free (match_entry);
-    g_regex_unref (regex_entry);
-    g_regex_unref (subregex_ident);
-    g_regex_unref (subregex_title);
-    g_regex_unref (subregex_author);
-    g_regex_unref (subregex_year);
-    g_regex_unref (regex_formatting);
-
-    return entry_total;
+    gdk_threads_add_idle (biblio_load_finished, load);
+    return NULL;
+}
+
+void biblio_load_entries (GuBiblio* bc, const gchar* filename) {
+    BiblioLoad* load = g_new0 (BiblioLoad, 1);
+
+    load->bc = bc;
+    load->filename = g_strdup (filename);
+    load->generation = ++bc->generation;
+
+    g_thread_unref (g_thread_new ("biblio", biblio_load_thread, load));
 }
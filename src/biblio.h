@@ -32,6 +32,7 @@
 
 #include <gtk/gtk.h>
 
+#include "bibindex.h"
 #include "editor.h"
 
 #define GU_BIBLIO(x) ((GuBiblio*)x)
@@ -46,12 +47,25 @@ struct _GuBiblio {
     GtkEntry* list_filter;
     gchar* basename;
     double progressval;
+
+    GuBibIndex* index;      /* entries shown in list_biblios */
+    guint8* visible;        /* per entry filter state, NULL shows all */
+    guint generation;       /* drops results of superseded loads */
 };
 
 GuBiblio* biblio_init (GtkBuilder* builder);
 gboolean biblio_detect_bibliography (GuEditor* ec);
 gboolean biblio_compile_bibliography (GuBiblio* bc, GuEditor* ec);
-int biblio_parse_entries (GuBiblio* bc, gchar *bib_content);
+gboolean biblio_run_bibtex (GuEditor* ec, gchar** output);
+
+/**
+ * biblio_load_entries:
+ *
+ * Indexes @filename on a worker thread. The list store is replaced in one
+ * go once the index is complete, the labels and the filter follow.
+ */
+void biblio_load_entries (GuBiblio* bc, const gchar* filename);
+void biblio_set_filter (GuBiblio* bc, const gchar* text);
 
 
 #endif /* __GUMMI_BIBLIO_H__ */
@@ -0,0 +1,369 @@
+/**
+ * @file   bench.c
+ * @brief  Headless compile and preview benchmark
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "build.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "biblio.h"
+#include "configfile.h"
+#include "constants.h"
+#include "editor.h"
+#include "environment.h"
+#include "external.h"
+#include "latex.h"
+#include "logparser.h"
+#include "project.h"
+#include "snapshot.h"
+#include "utils.h"
+
+#include "compile/auxcache.h"
+#include "compile/depgraph.h"
+#include "compile/preformat.h"
+
+/* gummi --build typesets documents without a display, through the same
+ * latex_update_pdffile the editor uses, so the compile flags come from the
+ * user's configuration just like in the GUI. The text is taken from disk
+ * instead of an editor buffer and written to a workfile of its own, the
+ * finished pdf is copied next to the document. Documents are built on a
+ * thread pool, each one is reported on stdout when it is done. */
+
+extern Gummi* gummi;
+
+typedef struct {
+    gchar* source;      /* as given on the command line */
+    gchar* texfile;     /* document that is typeset */
+    gchar* pdffile;     /* where the result is copied to */
+    gboolean ok;
+    gdouble seconds;
+    guint errors;
+    guint warnings;
+    GString* report;    /* diagnostics printed below the result */
+} BuildJob;
+
+static GMutex print_mutex;
+
+/* Staging directory root, looked up on the main thread before the workers
+ * start */
+static gchar* build_root = NULL;
+static gint build_serial = 0;
+
+/* The root file of a project, relative to the project file */
+static gchar* build_project_root (const gchar* projfile) {
+    gchar* content = NULL;
+    gchar* dir = NULL;
+    gchar* root = NULL;
+    GList* files = NULL;
+
+    if (!g_file_get_contents (projfile, &content, NULL, NULL) ||
+        !project_file_integrity (content)) {
+        g_free (content);
+        return NULL;
+    }
+
+    files = project_list_files (content);
+    if (files && files->data) {
+        dir = g_path_get_dirname (projfile);
+        root = g_path_is_absolute (files->data)?
+               g_strdup (files->data):
+               g_build_filename (dir, files->data, NULL);
+        g_free (dir);
+    }
+    g_list_free (files);
+    g_free (content);
+    return root;
+}
+
+static BuildJob* build_job_new (const gchar* source) {
+    BuildJob* job = g_new0 (BuildJob, 1);
+    gchar* stem = NULL;
+
+    job->source = g_strdup (source);
+    job->report = g_string_new ("");
+
+    if (g_str_has_suffix (source, ".gummi")) {
+        job->texfile = build_project_root (source);
+        if (!job->texfile) {
+            g_string_append (job->report, "  project has no root file\n");
+            return job;
+        }
+    } else {
+        job->texfile = g_strdup (source);
+    }
+
+    if (!g_file_test (job->texfile, G_FILE_TEST_IS_REGULAR)) {
+        g_string_append_printf (job->report, "  %s: No such file\n",
+                                job->texfile);
+        g_free (job->texfile);
+        job->texfile = NULL;
+        return job;
+    }
+
+    stem = g_str_has_suffix (job->texfile, ".tex")?
+           g_strndup (job->texfile, strlen (job->texfile) - 4):
+           g_strdup (job->texfile);
+    job->pdffile = g_strconcat (stem, ".pdf", NULL);
+    g_free (stem);
+    return job;
+}
+
+static void build_job_free (BuildJob* job) {
+    g_free (job->source);
+    g_free (job->texfile);
+    g_free (job->pdffile);
+    g_string_free (job->report, TRUE);
+    g_free (job);
+}
+
+/* The file as it is on disk, in place of an editor buffer */
+static GuSnapshot* build_snapshot (const gchar* filename) {
+    GPtrArray* chunks = NULL;
+    gchar* text = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents (filename, &text, &length, NULL))
+        return NULL;
+
+    chunks = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+    g_ptr_array_add (chunks, g_bytes_new_take (text, length));
+    return snapshot_new (0, chunks);
+}
+
+static void build_collect_diagnostics (BuildJob* job, GuEditor* ec) {
+    GArray* entries = ec->log->entries;
+    guint i;
+
+    job->errors = logparser_count (ec->log, LOG_ERROR);
+    job->warnings = logparser_count (ec->log, LOG_WARNING);
+
+    for (i = 0; i < entries->len; i++) {
+        GuLogEntry* e = &g_array_index (entries, GuLogEntry, i);
+        const gchar* file = e->file;
+
+        if (e->severity == LOG_BADBOX) continue;
+
+        // Messages about the workfile are about the document
+        if (file == NULL || STR_EQU (file, ec->workfile))
+            file = job->texfile;
+
+        g_string_append_printf (job->report, "  %s:%d: %s: %s\n", file,
+                                e->line, e->severity == LOG_ERROR?
+                                "error": "warning", e->message);
+    }
+
+    // The typesetter failed before anything could be parsed
+    if (!job->ok && job->errors == 0 && ec->compilelog) {
+        g_string_append (job->report, ec->compilelog);
+        if (!g_str_has_suffix (ec->compilelog, "\n"))
+            g_string_append_c (job->report, '\n');
+    }
+}
+
+/* The names the editor uses for a document are taken by a gummi that has
+ * it open, a batch build must not share its workfile, staging directory
+ * or caches. To the compile code the build looks like an unsaved document
+ * whose temporary file is the workfile */
+static void build_fileinfo (GuEditor* ec, const gchar* texfile) {
+    gchar* cwd = g_get_current_dir ();
+    gchar* path = g_path_is_absolute (texfile)? g_strdup (texfile):
+                  g_build_filename (cwd, texfile, NULL);
+    gchar* base = g_path_get_basename (path);
+    gchar* dir = g_path_get_dirname (path);
+    gchar* tag = g_strdup_printf ("build-%d-%d", (gint)getpid (),
+                                  g_atomic_int_add (&build_serial, 1));
+
+    ec->workfile = g_strdup_printf ("%s%c.%s.%s.swp", dir, G_DIR_SEPARATOR,
+                                    base, tag);
+    ec->fdname = g_strdup (ec->workfile);
+    ec->pdffile = g_strdup_printf ("%s%c.%s.%s.pdf", C_TMPDIR,
+                                   G_DIR_SEPARATOR, base, tag);
+    ec->builddir = g_build_filename (build_root, tag, NULL);
+    ec->jobfile = g_strdup_printf ("%s%c.%s", ec->builddir,
+                                   G_DIR_SEPARATOR, base);
+    if (g_mkdir_with_parents (ec->builddir, DIR_PERMS) != 0) {
+        slog (L_ERROR, "unable to create staging directory %s\n",
+                       ec->builddir);
+    }
+
+    g_free (tag);
+    g_free (dir);
+    g_free (base);
+    g_free (path);
+    g_free (cwd);
+}
+
+/* Unlike editor_fileinfo_cleanup nothing is kept for later sessions */
+static void build_fileinfo_cleanup (GuEditor* ec) {
+    gint len = strlen (ec->pdffile) - strlen (".pdf");
+    gchar* syncfile = g_strdup_printf ("%.*s.synctex", len, ec->pdffile);
+    gchar* syncgzfile = g_strconcat (syncfile, ".gz", NULL);
+
+    auxcache_clear (ec);
+    preformat_forget (ec, FALSE);
+
+    g_remove (syncfile);
+    g_remove (syncgzfile);
+    g_remove (ec->pdffile);
+    g_remove (ec->workfile);
+    utils_remove_tree (ec->builddir);
+
+    g_free (syncfile);
+    g_free (syncgzfile);
+    g_free (ec->fdname);
+    g_free (ec->workfile);
+    g_free (ec->pdffile);
+    g_free (ec->builddir);
+    g_free (ec->jobfile);
+    g_free (ec->workfile_hash);
+}
+
+static void build_document (gpointer data, gpointer user) {
+    BuildJob* job = data;
+    GuLatex* latex = GU_LATEX (user);
+    GuEditor* ec = NULL;
+    GuSnapshot* snap = NULL;
+    GError* err = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    if (job->texfile == NULL) goto report;
+
+    ec = g_new0 (GuEditor, 1);
+    ec->workfd = -1;
+    ec->log = logparser_new ();
+    ec->settle_refs = TRUE;
+    build_fileinfo (ec, job->texfile);
+
+    snap = build_snapshot (job->texfile);
+    if (snap == NULL || !latex_write_workfile (ec, snap)) {
+        g_string_append (job->report, "  could not write the workfile\n");
+    } else {
+        g_atomic_int_set (&ec->modified_since_compile, TRUE);
+        job->ok = latex_update_pdffile (latex, ec);
+
+        // References to a bibliography need a bibtex pass and another run
+        if (job->ok && auxcache_has_bibdata (ec) &&
+            biblio_run_bibtex (ec, NULL)) {
+            g_atomic_int_set (&ec->modified_since_compile, TRUE);
+            ec->force_compile = TRUE;
+            job->ok = latex_update_pdffile (latex, ec);
+        }
+
+        if (job->ok && !utils_copy_file (ec->pdffile, job->pdffile, &err)) {
+            g_string_append_printf (job->report, "  %s\n", err->message);
+            g_error_free (err);
+            job->ok = FALSE;
+        }
+        build_collect_diagnostics (job, ec);
+    }
+
+    build_fileinfo_cleanup (ec);
+    snapshot_unref (snap);
+    logparser_free (ec->log);
+    depgraph_free (ec->deps);
+    g_free (ec->compilelog);
+    g_free (ec->compiled_hash);
+    g_free (ec);
+
+report:
+    job->seconds = (g_get_monotonic_time () - start) / 1e6;
+
+    g_mutex_lock (&print_mutex);
+    printf ("%-6s %7.2fs  %s", job->ok? "ok": "FAILED", job->seconds,
+            job->source);
+    if (job->errors || job->warnings)
+        printf (" (%u errors, %u warnings)", job->errors, job->warnings);
+    printf ("\n%s", job->report->str);
+    fflush (stdout);
+    g_mutex_unlock (&print_mutex);
+}
+
+gint build_run (gchar** files, gint jobs) {
+    GuLatex* latex = NULL;
+    GThreadPool* pool = NULL;
+    GPtrArray* builds = NULL;
+    GError* error = NULL;
+    gint64 start = 0;
+    guint failed = 0;
+    guint i;
+
+    if (files == NULL || files[0] == NULL) {
+        g_printerr ("No documents to build\n");
+        return 2;
+    }
+    if (jobs < 1) jobs = g_get_num_processors ();
+
+    if (!external_exists (config_get_string ("Compile", "typesetter"))) {
+        slog (L_ERROR, "Could not locate the typesetter program\n");
+        return 1;
+    }
+
+    g_mkdir_with_parents (C_TMPDIR, DIR_PERMS);
+    latex = latex_init ();
+    external_probe_wait ();
+    gummi = gummi_init (NULL, NULL, latex, NULL, NULL, NULL, NULL,
+                        project_init ());
+
+    build_root = editor_staging_root ();
+    builds = g_ptr_array_new_with_free_func ((GDestroyNotify)build_job_free);
+    for (i = 0; files[i]; i++) {
+        g_ptr_array_add (builds, build_job_new (files[i]));
+    }
+
+    slog (L_INFO, "Building %u documents, %d at a time\n", builds->len, jobs);
+    start = g_get_monotonic_time ();
+
+    pool = g_thread_pool_new (build_document, latex, jobs, FALSE, &error);
+    if (pool == NULL) {
+        slog (L_ERROR, "%s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+    for (i = 0; i < builds->len; i++) {
+        g_thread_pool_push (pool, builds->pdata[i], NULL);
+    }
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+    for (i = 0; i < builds->len; i++) {
+        if (!((BuildJob*)builds->pdata[i])->ok) failed++;
+    }
+    printf ("%u documents built, %u failed in %.2fs\n",
+            builds->len - failed, failed,
+            (g_get_monotonic_time () - start) / 1e6);
+
+    g_ptr_array_free (builds, TRUE);
+    g_free (build_root);
+    build_root = NULL;
+    return failed? 1: 0;
+}
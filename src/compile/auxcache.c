@@ -0,0 +1,435 @@
+/**
+ * @file   auxcache.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "auxcache.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "constants.h"
+#include "utils.h"
+
+/* Build state that only changes every now and then, the cross reference
+ * data and the output of bibtex and makeindex, is kept per document under
+ * C_TMPDIR/auxcache/<hash of the document path>. Next to copies of the
+ * build files the directory holds a small state file which records the
+ * preamble the files were produced with and the inputs of the last bibtex
+ * and makeindex runs. */
+
+static const gchar* auxcache_exts[] = {
+    "aux", "toc", "lof", "lot", "out", "bbl", "idx", "ind", NULL
+};
+
+static GMutex auxcache_mutex;
+static GHashTable* compiled_hashes = NULL;
+
+void auxcache_init (void) {
+    compiled_hashes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, g_free);
+}
+
+static gchar* auxcache_build_file (GuEditor* ec, const gchar* ext) {
+    /* all build files share the jobname of the pdf */
+    return g_strdup_printf ("%s.%s", ec->jobfile, ext);
+}
+
+static gchar* auxcache_get_dir (GuEditor* ec) {
+    const gchar* key = ec->filename? ec->filename: ec->fdname;
+    gchar* hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+    gchar* name = g_strndup (hash, 16);
+    gchar* dir = g_build_filename (C_TMPDIR, "auxcache", name, NULL);
+    g_free (name);
+    g_free (hash);
+    return dir;
+}
+
+static gchar* auxcache_file_hash (const gchar* path) {
+    gchar* contents = NULL;
+    gchar* hash = NULL;
+    gsize length = 0;
+
+    if (g_file_get_contents (path, &contents, &length, NULL)) {
+        hash = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+                                            (const guchar*)contents, length);
+        g_free (contents);
+    }
+    return hash;
+}
+
+static gchar* auxcache_preamble_hash (const gchar* path) {
+    gchar* text = NULL;
+    gchar* end = NULL;
+    gchar* hash = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents (path, &text, &length, NULL))
+        return NULL;
+
+    if ((end = strstr (text, "\\begin{document}")))
+        length = end - text;
+    hash = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+                                        (const guchar*)text, length);
+    g_free (text);
+    return hash;
+}
+
+static GKeyFile* auxcache_load_state (const gchar* dir) {
+    GKeyFile* state = g_key_file_new ();
+    gchar* path = g_build_filename (dir, "state", NULL);
+    g_key_file_load_from_file (state, path, G_KEY_FILE_NONE, NULL);
+    g_free (path);
+    return state;
+}
+
+static void auxcache_save_state (const gchar* dir, GKeyFile* state) {
+    gchar* path = g_build_filename (dir, "state", NULL);
+    gchar* data = g_key_file_to_data (state, NULL, NULL);
+
+    g_mkdir_with_parents (dir, DIR_PERMS);
+    if (!utils_set_file_contents (path, data, -1))
+        slog (L_WARNING, "unable to write build cache state %s\n", path);
+    g_free (data);
+    g_free (path);
+}
+
+static void auxcache_forget (GuEditor* ec) {
+    if (!compiled_hashes) return;
+    g_mutex_lock (&auxcache_mutex);
+    g_hash_table_remove (compiled_hashes, ec->workfile);
+    g_mutex_unlock (&auxcache_mutex);
+}
+
+static void auxcache_remove_dir (const gchar* dir) {
+    gchar* path = NULL;
+    gint i = 0;
+
+    for (i = 0; auxcache_exts[i]; ++i) {
+        path = g_build_filename (dir, auxcache_exts[i], NULL);
+        g_remove (path);
+        g_free (path);
+    }
+    path = g_build_filename (dir, "state", NULL);
+    g_remove (path);
+    g_free (path);
+    g_rmdir (dir);
+}
+
+void auxcache_restore (GuEditor* ec) {
+    gchar* auxfile = NULL;
+    gchar* dir = NULL;
+    gchar* cached = NULL;
+    gchar* hash = NULL;
+    GKeyFile* state = NULL;
+    gint restored = 0;
+    gint i = 0;
+
+    if (!ec->filename) return;
+
+    /* never overwrite the state of a compile that already happened */
+    auxfile = auxcache_build_file (ec, "aux");
+    if (g_file_test (auxfile, G_FILE_TEST_EXISTS)) {
+        g_free (auxfile);
+        return;
+    }
+
+    dir = auxcache_get_dir (ec);
+    state = auxcache_load_state (dir);
+    cached = g_key_file_get_string (state, "Document", "preamble", NULL);
+    hash = auxcache_preamble_hash (ec->filename);
+
+    if (cached && STR_EQU (cached, hash)) {
+        for (i = 0; auxcache_exts[i]; ++i) {
+            gchar* source = g_build_filename (dir, auxcache_exts[i], NULL);
+            gchar* dest = auxcache_build_file (ec, auxcache_exts[i]);
+            if (g_file_test (source, G_FILE_TEST_EXISTS) &&
+                utils_copy_file (source, dest, NULL)) {
+                ++restored;
+            }
+            g_free (source);
+            g_free (dest);
+        }
+        slog (L_DEBUG, "restored %d build files of %s\n", restored,
+                        ec->filename);
+    }
+
+    g_key_file_free (state);
+    g_free (cached);
+    g_free (hash);
+    g_free (dir);
+    g_free (auxfile);
+}
+
+void auxcache_store (GuEditor* ec) {
+    gchar* auxfile = NULL;
+    gchar* dir = auxcache_get_dir (ec);
+    GKeyFile* state = NULL;
+    gchar* hash = NULL;
+    gint i = 0;
+
+    auxcache_forget (ec);
+
+    /* pass bookkeeping of unsaved documents is of no use afterwards */
+    if (!ec->filename) {
+        auxcache_remove_dir (dir);
+        g_free (dir);
+        return;
+    }
+
+    /* nothing was compiled, keep what the cache holds from before */
+    auxfile = auxcache_build_file (ec, "aux");
+    if (!g_file_test (auxfile, G_FILE_TEST_EXISTS)) {
+        g_free (auxfile);
+        g_free (dir);
+        return;
+    }
+
+    g_mkdir_with_parents (dir, DIR_PERMS);
+    for (i = 0; auxcache_exts[i]; ++i) {
+        gchar* source = auxcache_build_file (ec, auxcache_exts[i]);
+        gchar* dest = g_build_filename (dir, auxcache_exts[i], NULL);
+        if (!g_file_test (source, G_FILE_TEST_EXISTS) ||
+            !utils_copy_file (source, dest, NULL)) {
+            g_remove (dest);
+        }
+        g_free (source);
+        g_free (dest);
+    }
+
+    /* the workfile holds the text that was compiled last */
+    if (!(hash = auxcache_preamble_hash (ec->workfile)))
+        hash = auxcache_preamble_hash (ec->filename);
+
+    state = auxcache_load_state (dir);
+    g_key_file_set_string (state, "Document", "preamble", hash? hash: "");
+    auxcache_save_state (dir, state);
+
+    g_key_file_free (state);
+    g_free (hash);
+    g_free (auxfile);
+    g_free (dir);
+}
+
+void auxcache_clear (GuEditor* ec) {
+    gchar* dir = auxcache_get_dir (ec);
+    auxcache_forget (ec);
+    auxcache_remove_dir (dir);
+    g_free (dir);
+}
+
+void auxcache_compiled (GuEditor* ec) {
+    gchar* hash = auxcache_file_hash (ec->workfile);
+
+    if (!hash || !compiled_hashes) {
+        g_free (hash);
+        return;
+    }
+    g_mutex_lock (&auxcache_mutex);
+    g_hash_table_insert (compiled_hashes, g_strdup (ec->workfile), hash);
+    g_mutex_unlock (&auxcache_mutex);
+}
+
+gboolean auxcache_aux_current (GuEditor* ec) {
+    gchar* auxfile = auxcache_build_file (ec, "aux");
+    gchar* hash = NULL;
+    gboolean current = FALSE;
+
+    if (compiled_hashes && g_file_test (auxfile, G_FILE_TEST_EXISTS)) {
+        hash = auxcache_file_hash (ec->workfile);
+        g_mutex_lock (&auxcache_mutex);
+        current = hash && STR_EQU (hash,
+                         g_hash_table_lookup (compiled_hashes, ec->workfile));
+        g_mutex_unlock (&auxcache_mutex);
+    }
+    g_free (hash);
+    g_free (auxfile);
+    return current;
+}
+
+gchar* auxcache_aux_hash (GuEditor* ec) {
+    gchar* auxfile = auxcache_build_file (ec, "aux");
+    gchar* hash = auxcache_file_hash (auxfile);
+    g_free (auxfile);
+    return hash;
+}
+
+/* The document names bibtex databases, \bibdata only goes to the .aux
+ * file of the root document */
+gboolean auxcache_has_bibdata (GuEditor* ec) {
+    gchar* auxfile = auxcache_build_file (ec, "aux");
+    gchar* contents = NULL;
+    gboolean found = FALSE;
+
+    if (g_file_get_contents (auxfile, &contents, NULL, NULL))
+        found = (strstr (contents, "\\bibdata{") != NULL);
+    g_free (contents);
+    g_free (auxfile);
+    return found;
+}
+
+gboolean auxcache_rerun_needed (GuEditor* ec, const gchar* aux_hash,
+                                const gchar* log) {
+    gchar* hash = NULL;
+    gboolean rerun = FALSE;
+
+    if (!log) return FALSE;
+
+    /* Only trust the warning when the .aux file really changed, a document
+     * that never settles would otherwise be typeset twice every time */
+    if (strstr (log, "Rerun to get") ||
+        strstr (log, "Label(s) may have changed") ||
+        strstr (log, "Rerun LaTeX")) {
+        hash = auxcache_aux_hash (ec);
+        rerun = hash && !STR_EQU (hash, aux_hash);
+        g_free (hash);
+    }
+    return rerun;
+}
+
+static void auxcache_hash_bibdata (GChecksum* checksum, const gchar* line,
+                                   const gchar* docdir) {
+    gchar* list = g_strndup (line + strlen ("\\bibdata{"),
+                             strcspn (line + strlen ("\\bibdata{"), "}"));
+    gchar** names = g_strsplit (list, ",", 0);
+    gint i = 0;
+
+    for (i = 0; names[i]; ++i) {
+        gchar* name = g_str_has_suffix (names[i], ".bib")?
+                      g_strdup (names[i]):
+                      g_strconcat (names[i], ".bib", NULL);
+        gchar* path = g_path_is_absolute (name)? g_strdup (name):
+                      g_build_filename (docdir, name, NULL);
+        gchar* hash = auxcache_file_hash (path);
+
+        /* databases found through kpathsea are not expected to change */
+        g_checksum_update (checksum, (const guchar*)(hash? hash: name), -1);
+        g_free (hash);
+        g_free (path);
+        g_free (name);
+    }
+    g_strfreev (names);
+    g_free (list);
+}
+
+static void auxcache_hash_citations (GChecksum* checksum, const gchar* auxfile,
+                                     const gchar* docdir, gint depth) {
+    gchar* contents = NULL;
+    gchar** lines = NULL;
+    gint i = 0;
+
+    if (depth > 4 || !g_file_get_contents (auxfile, &contents, NULL, NULL))
+        return;
+
+    lines = g_strsplit (contents, "\n", 0);
+    for (i = 0; lines[i]; ++i) {
+        const gchar* line = lines[i];
+
+        if (g_str_has_prefix (line, "\\citation{") ||
+            g_str_has_prefix (line, "\\bibstyle{")) {
+            g_checksum_update (checksum, (const guchar*)line, -1);
+        } else if (g_str_has_prefix (line, "\\bibdata{")) {
+            g_checksum_update (checksum, (const guchar*)line, -1);
+            auxcache_hash_bibdata (checksum, line, docdir);
+        } else if (g_str_has_prefix (line, "\\@input{")) {
+            /* aux files of \include'd chapters */
+            gchar* name = g_strndup (line + strlen ("\\@input{"),
+                                     strcspn (line + strlen ("\\@input{"), "}"));
+            gchar* auxdir = g_path_get_dirname (auxfile);
+            gchar* path = g_build_filename (auxdir, name, NULL);
+            auxcache_hash_citations (checksum, path, docdir, depth + 1);
+            g_free (path);
+            g_free (auxdir);
+            g_free (name);
+        }
+    }
+    g_strfreev (lines);
+    g_free (contents);
+}
+
+static gchar* auxcache_pass_inputs (GuEditor* ec, const gchar* pass) {
+    gchar* path = NULL;
+    gchar* hash = NULL;
+
+    if (STR_EQU (pass, "bibtex")) {
+        GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA1);
+        gchar* docdir = g_path_get_dirname (ec->workfile);
+
+        path = auxcache_build_file (ec, "aux");
+        if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+            auxcache_hash_citations (checksum, path, docdir, 0);
+            hash = g_strdup (g_checksum_get_string (checksum));
+        }
+        g_checksum_free (checksum);
+        g_free (docdir);
+    } else {
+        path = auxcache_build_file (ec, "idx");
+        hash = auxcache_file_hash (path);
+    }
+    g_free (path);
+    return hash;
+}
+
+gboolean auxcache_pass_needed (GuEditor* ec, const gchar* pass) {
+    gchar* dir = auxcache_get_dir (ec);
+    gchar* inputs = auxcache_pass_inputs (ec, pass);
+    gchar* output = auxcache_build_file (ec, STR_EQU (pass, "bibtex")?
+                                             "bbl": "ind");
+    GKeyFile* state = auxcache_load_state (dir);
+    gchar* last = g_key_file_get_string (state, "Passes", pass, NULL);
+    gboolean needed = TRUE;
+
+    if (inputs && last && STR_EQU (inputs, last) &&
+        g_file_test (output, G_FILE_TEST_EXISTS)) {
+        slog (L_DEBUG, "inputs of %s are unchanged, skipping it\n", pass);
+        needed = FALSE;
+    }
+
+    g_key_file_free (state);
+    g_free (last);
+    g_free (output);
+    g_free (inputs);
+    g_free (dir);
+    return needed;
+}
+
+void auxcache_pass_done (GuEditor* ec, const gchar* pass) {
+    gchar* dir = auxcache_get_dir (ec);
+    gchar* inputs = auxcache_pass_inputs (ec, pass);
+    GKeyFile* state = NULL;
+
+    if (inputs) {
+        state = auxcache_load_state (dir);
+        g_key_file_set_string (state, "Passes", pass, inputs);
+        auxcache_save_state (dir, state);
+        g_key_file_free (state);
+    }
+    g_free (inputs);
+    g_free (dir);
+}
@@ -0,0 +1,78 @@
+/**
+ * @file   auxcache.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_COMPILE_AUXCACHE_H__
+#define __GUMMI_COMPILE_AUXCACHE_H__
+
+#include <glib.h>
+
+#include "editor.h"
+
+void auxcache_init (void);
+
+/**
+ * auxcache_restore:
+ *
+ * Copies the .aux/.toc/.bbl/.. state of a previous session back into the
+ * build directory, provided the preamble of the document did not change
+ * in the meantime. Only the first compile after opening a file profits.
+ */
+void auxcache_restore (GuEditor* ec);
+
+/**
+ * auxcache_store:
+ *
+ * Saves the build state of @ec for later sessions and drops everything
+ * that was kept about it in memory. Must run before the build files are
+ * removed.
+ */
+void auxcache_store (GuEditor* ec);
+void auxcache_clear (GuEditor* ec);
+
+/* Bookkeeping of successful typesetter runs, used to avoid a separate
+ * draftmode pass when the .aux file is known to be up to date */
+void auxcache_compiled (GuEditor* ec);
+gboolean auxcache_aux_current (GuEditor* ec);
+
+gchar* auxcache_aux_hash (GuEditor* ec);
+gboolean auxcache_has_bibdata (GuEditor* ec);
+gboolean auxcache_rerun_needed (GuEditor* ec, const gchar* aux_hash,
+                                const gchar* log);
+
+/**
+ * auxcache_pass_needed:
+ *
+ * Tells whether the auxiliary @pass ("bibtex" or "makeindex") has to run,
+ * which is not the case when its inputs are the same as on the last run
+ * and the output is still around.
+ */
+gboolean auxcache_pass_needed (GuEditor* ec, const gchar* pass);
+void auxcache_pass_done (GuEditor* ec, const gchar* pass);
+
+#endif /* __GUMMI_COMPILE_AUXCACHE_H__ */
@@ -0,0 +1,512 @@
+/**
+ * @file   depgraph.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "depgraph.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "constants.h"
+#include "utils.h"
+
+typedef enum {
+    DEP_INPUT = 0,
+    DEP_INCLUDE,
+    DEP_GRAPHIC,
+    DEP_BIBLIOGRAPHY,
+    DEP_PACKAGE,
+    DEP_CLASS
+} GuDepKind;
+
+typedef struct {
+    GuDepKind kind;
+    gchar* name;
+} GuDepRef;
+
+typedef struct {
+    gchar* path;            /* absolute, resolved against the root directory */
+    const gchar* relpath;   /* points into path, NULL if outside the root */
+    gchar* source;          /* what was read, path or the workfile of a tab */
+    gchar* include;         /* name the root \include's it by, if it does */
+    gint64 mtime;
+    gint64 size;
+    gchar* hash;            /* NULL while the file does not exist */
+    GArray* refs;           /* GuDepRef, TeX sources only */
+    gboolean tex;
+    gboolean preamble;      /* a package or class, or pulled in by one */
+    guint visit;
+} GuDepNode;
+
+struct _GuDepGraph {
+    gchar* rootfile;
+    gchar* rootdir;
+    GHashTable* nodes;      /* path -> GuDepNode */
+    GPtrArray* order;       /* nodes reached by the last update */
+    GPtrArray* links;       /* overlay entries written last time */
+    gchar* hash;
+    gchar* preamble_hash;
+    guint visit;
+};
+
+static const struct {
+    const gchar* command;
+    GuDepKind kind;
+} dep_commands[] = {
+    { "input", DEP_INPUT },
+    { "include", DEP_INCLUDE },
+    { "includegraphics", DEP_GRAPHIC },
+    { "bibliography", DEP_BIBLIOGRAPHY },
+    { "usepackage", DEP_PACKAGE },
+    { "RequirePackage", DEP_PACKAGE },
+    { "documentclass", DEP_CLASS },
+    { "LoadClass", DEP_CLASS },
+};
+
+/* Tried in this order when a name has no extension, like the typesetter
+ * and graphicx do */
+static const gchar* tex_exts[] = { ".tex", "", NULL };
+static const gchar* include_exts[] = { ".tex", NULL };
+static const gchar* graphic_exts[] = {
+    "", ".pdf", ".png", ".jpg", ".jpeg", ".eps", NULL
+};
+static const gchar* bib_exts[] = { ".bib", "", NULL };
+/* only local ones exist next to the root, those found through kpathsea
+ * are not expected to change */
+static const gchar* package_exts[] = { ".sty", NULL };
+static const gchar* class_exts[] = { ".cls", NULL };
+
+static void depgraph_free_ref (gpointer data) {
+    g_free (((GuDepRef*)data)->name);
+}
+
+static void depgraph_free_node (gpointer data) {
+    GuDepNode* node = data;
+
+    g_free (node->path);
+    g_free (node->source);
+    g_free (node->include);
+    g_free (node->hash);
+    if (node->refs) g_array_free (node->refs, TRUE);
+    g_free (node);
+}
+
+GuDepGraph* depgraph_new (void) {
+    GuDepGraph* g = g_new0 (GuDepGraph, 1);
+
+    g->nodes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                      depgraph_free_node);
+    g->order = g_ptr_array_new ();
+    g->links = g_ptr_array_new_with_free_func (g_free);
+    return g;
+}
+
+void depgraph_free (GuDepGraph* g) {
+    guint i;
+
+    if (!g) return;
+    for (i = 0; i < g->links->len; ++i)
+        g_remove (g_ptr_array_index (g->links, i));
+    g_hash_table_destroy (g->nodes);
+    g_ptr_array_free (g->order, TRUE);
+    g_ptr_array_free (g->links, TRUE);
+    g_free (g->rootfile);
+    g_free (g->rootdir);
+    g_free (g->hash);
+    g_free (g->preamble_hash);
+    g_free (g);
+}
+
+static gboolean depgraph_stat (const gchar* path, gint64* mtime,
+                               gint64* size) {
+    GFile* file = g_file_new_for_path (path);
+    GFileInfo* info = g_file_query_info (file,
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                                         G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    g_object_unref (file);
+    if (!info) return FALSE;
+
+    /* a save and the next workfile write often fall into the same second */
+    *mtime = g_file_info_get_attribute_uint64 (info,
+                        G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+             g_file_info_get_attribute_uint32 (info,
+                        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    *size = g_file_info_get_size (info);
+    g_object_unref (info);
+    return TRUE;
+}
+
+/* editor_fileinfo_update names the workfile of DIR/FILE DIR/.FILE.swp */
+static gchar* depgraph_workfile (const gchar* path) {
+    gchar* dir = g_path_get_dirname (path);
+    gchar* base = g_path_get_basename (path);
+    gchar* workfile = g_strdup_printf ("%s%c.%s.swp", dir, G_DIR_SEPARATOR,
+                                       base);
+    g_free (base);
+    g_free (dir);
+    return workfile;
+}
+
+static gchar* depgraph_canonical_path (const gchar* dir, const gchar* name) {
+    gchar* path = g_path_is_absolute (name)? g_strdup (name):
+                  g_build_filename (dir? dir: ".", name, NULL);
+    GFile* file = g_file_new_for_path (path);
+    gchar* result = g_file_get_path (file);
+
+    g_object_unref (file);
+    g_free (path);
+    return result;
+}
+
+static void depgraph_add_ref (GArray* refs, GuDepKind kind,
+                              const gchar* start, gsize length) {
+    GuDepRef ref = { kind, NULL };
+
+    ref.name = g_strstrip (g_strndup (start, length));
+    /* macro arguments and names built from macros can't be followed */
+    if (ref.name[0] == '\0' || strpbrk (ref.name, "\\#")) {
+        g_free (ref.name);
+        return;
+    }
+    g_array_append_val (refs, ref);
+}
+
+/* One pass over the source, commented out text is skipped */
+static GArray* depgraph_scan (const gchar* text, gsize length) {
+    GArray* refs = g_array_new (FALSE, FALSE, sizeof (GuDepRef));
+    const gchar* end = text + length;
+    const gchar* p = text;
+    guint i;
+
+    g_array_set_clear_func (refs, depgraph_free_ref);
+
+    while (p < end) {
+        if (*p == '%') {
+            while (p < end && *p != '\n') ++p;
+            continue;
+        }
+        if (*p++ != '\\') continue;
+
+        const gchar* cmd = p;
+        while (p < end && g_ascii_isalpha (*p)) ++p;
+        if (p == cmd) {
+            ++p;    /* \% and friends */
+            continue;
+        }
+        for (i = 0; i < G_N_ELEMENTS (dep_commands); ++i) {
+            if (strlen (dep_commands[i].command) == (gsize)(p - cmd) &&
+                !strncmp (dep_commands[i].command, cmd, p - cmd))
+                break;
+        }
+        if (i == G_N_ELEMENTS (dep_commands)) continue;
+        GuDepKind kind = dep_commands[i].kind;
+
+        if (kind == DEP_GRAPHIC && p < end && *p == '*') ++p;
+        while (p < end && g_ascii_isspace (*p)) ++p;
+        if ((kind == DEP_GRAPHIC || kind == DEP_PACKAGE ||
+             kind == DEP_CLASS) && p < end && *p == '[') {
+            while (p < end && *p != ']') ++p;
+            if (p < end) ++p;
+            while (p < end && g_ascii_isspace (*p)) ++p;
+        }
+
+        const gchar* arg = NULL;
+        if (p < end && *p == '{') {
+            arg = ++p;
+            while (p < end && *p != '}') ++p;
+        } else if (kind == DEP_INPUT) {
+            /* plain TeX syntax, \input file */
+            arg = p;
+            while (p < end && !g_ascii_isspace (*p) && !strchr ("%\\{}", *p))
+                ++p;
+        }
+        if (!arg) continue;
+
+        if (kind == DEP_BIBLIOGRAPHY || kind == DEP_PACKAGE) {
+            const gchar* item = arg;
+            const gchar* q;
+            for (q = arg; q <= p; ++q) {
+                if (q == p || *q == ',') {
+                    depgraph_add_ref (refs, kind, item, q - item);
+                    item = q + 1;
+                }
+            }
+        } else {
+            depgraph_add_ref (refs, kind, arg, p - arg);
+        }
+    }
+    return refs;
+}
+
+/* The first existing candidate, or the first one if none exists so that
+ * the file turning up later is noticed */
+static gchar* depgraph_resolve (GuDepGraph* g, const GuDepRef* ref) {
+    const gchar** exts = NULL;
+    gchar* first = NULL;
+    gint i;
+
+    switch (ref->kind) {
+        case DEP_INPUT:
+            exts = g_str_has_suffix (ref->name, ".tex")? tex_exts + 1:
+                                                         tex_exts;
+            break;
+        case DEP_INCLUDE: exts = include_exts; break;
+        case DEP_GRAPHIC: exts = graphic_exts; break;
+        case DEP_BIBLIOGRAPHY: exts = bib_exts; break;
+        case DEP_PACKAGE: exts = package_exts; break;
+        case DEP_CLASS: exts = class_exts; break;
+    }
+    for (i = 0; exts[i]; ++i) {
+        gchar* name = g_strconcat (ref->name, exts[i], NULL);
+        gchar* path = depgraph_canonical_path (g->rootdir, name);
+        g_free (name);
+
+        if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+            g_free (first);
+            return path;
+        }
+        if (first) g_free (path);
+        else first = path;
+    }
+    return first;
+}
+
+static void depgraph_refresh (GuDepNode* node) {
+    gchar* workfile = node->tex? depgraph_workfile (node->path): NULL;
+    gchar* source = g_strdup (node->path);
+    gint64 mtime = 0, size = 0, wmtime = 0, wsize = 0;
+    gboolean exists = depgraph_stat (node->path, &mtime, &size);
+
+    /* open in a tab, the workfile has what the user sees unless the file
+     * was saved after it was written (or it is left over from a crash) */
+    if (workfile && depgraph_stat (workfile, &wmtime, &wsize) &&
+        (!exists || wmtime >= mtime)) {
+        g_free (source);
+        source = workfile;
+        workfile = NULL;
+        mtime = wmtime;
+        size = wsize;
+        exists = TRUE;
+    }
+    g_free (workfile);
+
+    if (exists && node->hash && STR_EQU (source, node->source) &&
+        mtime == node->mtime && size == node->size) {
+        g_free (source);
+        return;
+    }
+
+    g_free (node->source);
+    g_free (node->hash);
+    if (node->refs) g_array_free (node->refs, TRUE);
+    node->source = source;
+    node->hash = NULL;
+    node->refs = NULL;
+    node->mtime = mtime;
+    node->size = size;
+    if (!exists) return;
+
+    GMappedFile* mapped = g_mapped_file_new (source, FALSE, NULL);
+    if (!mapped) return;
+
+    const gchar* contents = g_mapped_file_get_contents (mapped);
+    gsize length = g_mapped_file_get_length (mapped);
+
+    node->hash = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+                                              (const guchar*)contents, length);
+    if (node->tex && contents)
+        node->refs = depgraph_scan (contents, length);
+    g_mapped_file_unref (mapped);
+}
+
+static void depgraph_visit (GuDepGraph* g, const gchar* path, GuDepKind kind,
+                            const gchar* include, gboolean preamble) {
+    GuDepNode* node = g_hash_table_lookup (g->nodes, path);
+    gsize rootlen = strlen (g->rootdir);
+    gboolean top = STR_EQU (path, g->rootfile);
+    guint i;
+
+    if (!node) {
+        node = g_new0 (GuDepNode, 1);
+        node->path = g_strdup (path);
+        if (!strncmp (path, g->rootdir, rootlen) &&
+            path[rootlen] == G_DIR_SEPARATOR)
+            node->relpath = node->path + rootlen + 1;
+        g_hash_table_insert (g->nodes, node->path, node);
+    }
+    /* documents including each other */
+    if (node->visit == g->visit) return;
+
+    node->visit = g->visit;
+    node->tex = (kind == DEP_INPUT || kind == DEP_INCLUDE ||
+                 kind == DEP_PACKAGE || kind == DEP_CLASS);
+    node->preamble = preamble || kind == DEP_PACKAGE || kind == DEP_CLASS;
+    g_free (node->include);
+    node->include = g_strdup (include);
+    g_ptr_array_add (g->order, node);
+
+    depgraph_refresh (node);
+    if (!node->refs) return;
+
+    for (i = 0; i < node->refs->len; ++i) {
+        GuDepRef* ref = &g_array_index (node->refs, GuDepRef, i);
+        gchar* child = depgraph_resolve (g, ref);
+
+        depgraph_visit (g, child, ref->kind,
+                        top && ref->kind == DEP_INCLUDE? ref->name: NULL,
+                        node->preamble);
+        g_free (child);
+    }
+}
+
+static gboolean depgraph_unvisited (gpointer key, gpointer value,
+                                    gpointer user) {
+    return ((GuDepNode*)value)->visit != GPOINTER_TO_UINT (user);
+}
+
+const gchar* depgraph_update (GuDepGraph* g, const gchar* rootfile) {
+    GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    GChecksum* preamble = g_checksum_new (G_CHECKSUM_SHA1);
+    guint i;
+
+    if (!STR_EQU (rootfile, g->rootfile)) {
+        g_hash_table_remove_all (g->nodes);
+        g_free (g->rootfile);
+        g_free (g->rootdir);
+        g->rootfile = depgraph_canonical_path (NULL, rootfile);
+        g->rootdir = g_path_get_dirname (g->rootfile);
+    }
+
+    ++g->visit;
+    g_ptr_array_set_size (g->order, 0);
+    depgraph_visit (g, g->rootfile, DEP_INPUT, NULL, FALSE);
+    g_hash_table_foreach_remove (g->nodes, depgraph_unvisited,
+                                 GUINT_TO_POINTER (g->visit));
+
+    for (i = 0; i < g->order->len; ++i) {
+        GuDepNode* node = g_ptr_array_index (g->order, i);
+        g_checksum_update (checksum, (const guchar*)node->path,
+                           strlen (node->path) + 1);
+        g_checksum_update (checksum, (const guchar*)
+                           (node->hash? node->hash: "-"), -1);
+        if (node->preamble) {
+            g_checksum_update (preamble, (const guchar*)node->path,
+                               strlen (node->path) + 1);
+            g_checksum_update (preamble, (const guchar*)
+                               (node->hash? node->hash: "-"), -1);
+        }
+    }
+    g_free (g->hash);
+    g->hash = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+    g_free (g->preamble_hash);
+    g->preamble_hash = g_strdup (g_checksum_get_string (preamble));
+    g_checksum_free (preamble);
+
+    slog (L_DEBUG, "%d inputs for %s, %s\n", g->order->len, g->rootfile,
+          g->hash);
+    return g->hash;
+}
+
+const gchar* depgraph_preamble_hash (GuDepGraph* g) {
+    return g->preamble_hash;
+}
+
+void depgraph_write_overlay (GuDepGraph* g, const gchar* dir) {
+    guint i;
+
+    /* links are cheap, rather than tracking what moved drop them all */
+    for (i = 0; i < g->links->len; ++i)
+        g_remove (g_ptr_array_index (g->links, i));
+    g_ptr_array_set_size (g->links, 0);
+    g_mkdir_with_parents (dir, DIR_PERMS);
+
+    for (i = 0; i < g->order->len; ++i) {
+        GuDepNode* node = g_ptr_array_index (g->order, i);
+        if (!node->tex || !node->relpath || !node->source ||
+            STR_EQU (node->source, node->path))
+            continue;
+
+        gchar* link = g_build_filename (dir, node->relpath, NULL);
+        gchar* parent = g_path_get_dirname (link);
+        gboolean ok = FALSE;
+
+        g_mkdir_with_parents (parent, DIR_PERMS);
+        g_remove (link);
+#ifdef WIN32
+        ok = utils_copy_file (node->source, link, NULL);
+#else
+        ok = (symlink (node->source, link) == 0);
+#endif
+        if (ok) {
+            g_ptr_array_add (g->links, link);
+        } else {
+            slog (L_WARNING, "unable to add %s to the build overlay\n",
+                  node->relpath);
+            g_free (link);
+        }
+        g_free (parent);
+    }
+}
+
+void depgraph_prepare_outdir (GuDepGraph* g, const gchar* outdir) {
+    guint i;
+
+    for (i = 0; i < g->order->len; ++i) {
+        GuDepNode* node = g_ptr_array_index (g->order, i);
+        if (!node->include || !strchr (node->include, '/')) continue;
+
+        gchar* dir = g_path_get_dirname (node->include);
+        gchar* path = g_build_filename (outdir, dir, NULL);
+        g_mkdir_with_parents (path, DIR_PERMS);
+        g_free (path);
+        g_free (dir);
+    }
+}
+
+const gchar* depgraph_included_as (GuDepGraph* g, const gchar* path) {
+    gchar* canonical = NULL;
+    const gchar* name = NULL;
+    guint i;
+
+    if (!path) return NULL;
+    canonical = depgraph_canonical_path (NULL, path);
+    for (i = 0; i < g->order->len && !name; ++i) {
+        GuDepNode* node = g_ptr_array_index (g->order, i);
+        if (node->include && STR_EQU (node->path, canonical))
+            name = node->include;
+    }
+    g_free (canonical);
+    return name;
+}
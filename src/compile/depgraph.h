@@ -0,0 +1,90 @@
+/**
+ * @file   depgraph.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_COMPILE_DEPGRAPH_H__
+#define __GUMMI_COMPILE_DEPGRAPH_H__
+
+#include <glib.h>
+
+/* Everything a document pulls in through \input, \include,
+ * \includegraphics, \bibliography and local packages and classes, with
+ * the state each file had when it was last looked at. Owned by one editor and only used by its compile
+ * job, so it needs no locking of its own. */
+typedef struct _GuDepGraph GuDepGraph;
+
+GuDepGraph* depgraph_new (void);
+
+/* Also removes the overlay entries written by depgraph_write_overlay */
+void depgraph_free (GuDepGraph* g);
+
+/**
+ * depgraph_update:
+ *
+ * Walks the inputs of @rootfile, names are resolved against its directory
+ * like the typesetter does. Only files whose modification time or size
+ * changed are read again. A file that is open in a tab is read from its
+ * workfile instead, as long as that is newer than the file on disk.
+ *
+ * Returns: a hash over the contents of all inputs, owned by @g
+ */
+const gchar* depgraph_update (GuDepGraph* g, const gchar* rootfile);
+
+/**
+ * depgraph_preamble_hash:
+ *
+ * Returns: a hash over the local packages and classes of the last
+ * update and whatever they pull in, owned by @g
+ */
+const gchar* depgraph_preamble_hash (GuDepGraph* g);
+
+/**
+ * depgraph_write_overlay:
+ *
+ * Fills @dir with links to the workfiles of the inputs that are open in a
+ * tab, laid out like the root directory. Put in front of TEXINPUTS, the
+ * typesetter picks up unsaved text of every open file of the project.
+ */
+void depgraph_write_overlay (GuDepGraph* g, const gchar* dir);
+
+/**
+ * depgraph_prepare_outdir:
+ *
+ * Creates the subdirectories of @outdir \include writes its .aux files to.
+ */
+void depgraph_prepare_outdir (GuDepGraph* g, const gchar* outdir);
+
+/**
+ * depgraph_included_as:
+ *
+ * Returns the name @path is pulled in with by \include from the root
+ * document, usable with \includeonly, or NULL. Owned by @g.
+ */
+const gchar* depgraph_included_as (GuDepGraph* g, const gchar* path);
+
+#endif /* __GUMMI_COMPILE_DEPGRAPH_H__ */
@@ -47,7 +47,7 @@ void latexmk_init (void) {
 }
 
 gboolean latexmk_active (void) {
-    if (config_value_as_str_equals ("Compile", "typesetter", C_LATEXMK)) {
+    if (STR_EQU (external_typesetter (), C_LATEXMK)) {
         return TRUE;
     }
     return FALSE;
@@ -57,20 +57,15 @@ gboolean latexmk_detected (void) {
     return lmk_detected;
 }
 
-gchar* latexmk_get_command (const gchar* method, gchar* workfile, gchar* basename) {
-    gchar* outdir = g_strdup("");
-
-    // reroute output files to our temp directory
-    if (!STR_EQU (C_TMPDIR, g_path_get_dirname (workfile))) {
-        gchar* base;
-        base = g_path_get_basename (basename);
-        outdir = g_strdup_printf ("-jobname=\"%s/%s\"", C_TMPDIR, base);
-    }
+gchar* latexmk_get_command (const gchar* method, gchar* workfile, gchar* jobfile) {
+    // reroute output files to the staging directory
+    gchar* outdir = g_strdup_printf ("-jobname=\"%s\"", jobfile);
 
     const gchar* flags = latexmk_get_flags (method);
     gchar* lmkcmd;
 
     lmkcmd = g_strdup_printf("latexmk %s %s \"%s\"", flags, outdir, workfile);
+    g_free (outdir);
     return lmkcmd;
 }
 
@@ -79,7 +74,7 @@ gchar* latexmk_get_flags (const gchar *method) {
     gchar* lmkwithoutput;
     gchar* lmkflags;
 
-    if (config_get_boolean ("Compile", "synctex")) {
+    if (config_hot.synctex) {
         if (STR_EQU (method, "texpdf")) {
             lmkflags = g_strdup_printf("-e \"\\$pdflatex = 'pdflatex -synctex=1'\" -silent");
         }
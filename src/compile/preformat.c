@@ -0,0 +1,300 @@
+/**
+ * @file   preformat.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "preformat.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "configfile.h"
+#include "constants.h"
+#include "motion.h"
+#include "utils.h"
+
+#include "compile/depgraph.h"
+#include "compile/texlive.h"
+
+/* "Warm engine" building: the document preamble is dumped once into a
+ * custom format with mylatexformat, after which every compile only has to
+ * typeset the body. A new format is dumped only after the preamble has
+ * been left untouched for one compile run, while it is being edited the
+ * regular texlive path is used. */
+
+typedef struct {
+    gchar* seen_hash;     /* preamble hash of the previous run */
+    gchar* format_hash;   /* preamble hash the dumped format belongs to */
+    gboolean dumping;     /* a dump runs without preformat_mutex held */
+} PreformatState;
+
+static GMutex preformat_mutex;
+static GHashTable* preformat_states = NULL;
+static gsize mlf_detected = 0;   /* 1 + found, once looked up */
+
+static void preformat_state_free (gpointer data) {
+    PreformatState* state = data;
+    g_free (state->seen_hash);
+    g_free (state->format_hash);
+    g_free (state);
+}
+
+void preformat_init (void) {
+    preformat_states = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, preformat_state_free);
+}
+
+static gboolean preformat_detected (void) {
+    /* The lookup spawns kpsewhich, so only do it once somebody actually
+     * enabled the feature and from a compile worker; the others wait */
+    if (g_once_init_enter (&mlf_detected)) {
+        gchar* path = NULL;
+        gchar* stdout_buf = NULL;
+        gchar* argv[] = { "kpsewhich", "mylatexformat.ltx", NULL };
+        gboolean found = FALSE;
+
+        if ((path = g_find_program_in_path ("kpsewhich")) &&
+            g_spawn_sync (NULL, argv, NULL,
+                          G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                          NULL, NULL, &stdout_buf, NULL, NULL, NULL)) {
+            found = (stdout_buf && strlen (g_strstrip (stdout_buf)));
+        }
+        slog (L_INFO, "mylatexformat %s\n", found? "was found installed":
+                                            "not found, warm builds disabled");
+        g_free (stdout_buf);
+        g_free (path);
+        g_once_init_leave (&mlf_detected, 1 + found);
+    }
+    return mlf_detected == 2;
+}
+
+gboolean preformat_active (void) {
+    if (!config_hot.preformat) return FALSE;
+
+    /* mylatexformat supports neither lualatex nor the dvi routes */
+    return (pdflatex_active () || xelatex_active ()) &&
+           STR_EQU (config_hot.steps, "texpdf");
+}
+
+/**
+ * @brief Hash everything that ends up in the dumped format
+ * @return checksum string or NULL if the document can't be preformatted
+ */
+static gchar* preformat_preamble_hash (const gchar* workfile,
+                                       const gchar* typesetter,
+                                       const gchar* flags,
+                                       const gchar* inputs) {
+    gchar* text = NULL;
+    gchar* end = NULL;
+    gchar* hash = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents (workfile, &text, &length, NULL))
+        return NULL;
+
+    /* Local packages and classes come with inputs, see
+     * depgraph_preamble_hash. Other files pulled in by the preamble are not
+     * tracked, so don't risk a stale format for those documents */
+    if ((end = strstr (text, "\\begin{document}")) &&
+        !g_strstr_len (text, end - text, "\\input") &&
+        !g_strstr_len (text, end - text, "\\include")) {
+        GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA1);
+        g_checksum_update (checksum, (const guchar*)typesetter, -1);
+        g_checksum_update (checksum, (const guchar*)flags, -1);
+        g_checksum_update (checksum, (const guchar*)(inputs? inputs: ""), -1);
+        g_checksum_update (checksum, (const guchar*)text, end - text);
+        hash = g_strdup (g_checksum_get_string (checksum));
+        g_checksum_free (checksum);
+    }
+    g_free (text);
+    return hash;
+}
+
+static gchar* preformat_get_path (const gchar* hash) {
+    gchar* name = g_strdup_printf ("preamble-%.16s", hash);
+    gchar* path = g_build_filename (C_TMPDIR, name, NULL);
+    g_free (name);
+    return path;
+}
+
+/* Dumps into the staging directory of ec and publishes the format from
+ * there, documents with the same preamble share it */
+static gboolean preformat_dump (const gchar* typesetter, const gchar* flags,
+                                GuEditor* ec, const gchar* hash) {
+    gchar* fmtpath = preformat_get_path (hash);
+    gchar* jobname = g_path_get_basename (fmtpath);
+    gchar* dirname = g_path_get_dirname (ec->workfile);
+    gchar* staged = g_strdup_printf ("%s%c%s.fmt", ec->builddir,
+                                     G_DIR_SEPARATOR, jobname);
+    gchar* fmtfile = g_strconcat (fmtpath, ".fmt", NULL);
+    gchar* command = g_strdup_printf ("%s %s -ini %s "
+                                      "-jobname=\"%s\" "
+                                      "-output-directory=\"%s\" "
+                                      "\"&%s\" mylatexformat.ltx \"%s\"",
+                                      C_TEXSEC, typesetter, flags, jobname,
+                                      ec->builddir, typesetter, ec->workfile);
+    Tuple2 res = utils_popen_r_lines (command, dirname, NULL, ec,
+                                      motion_set_job_pid, 0);
+    gboolean success = ((glong)res.first == 0) &&
+                       utils_publish_file (staged, fmtfile, NULL);
+
+    slog (L_DEBUG, "Dumping preamble format %s: %s\n", jobname,
+                   success? "done": "failed");
+
+    g_remove (staged);
+    g_free (res.second);
+    g_free (command);
+    g_free (fmtfile);
+    g_free (staged);
+    g_free (dirname);
+    g_free (jobname);
+    g_free (fmtpath);
+    return success;
+}
+
+/* Called with preformat_mutex held */
+static void preformat_remove_format (const gchar* hash) {
+    GHashTableIter iter;
+    gpointer value;
+
+    /* still in use by another document with the same preamble */
+    g_hash_table_iter_init (&iter, preformat_states);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        if (STR_EQU (((PreformatState*)value)->format_hash, hash))
+            return;
+    }
+
+    gchar* fmtpath = preformat_get_path (hash);
+    gchar* fmtfile = g_strconcat (fmtpath, ".fmt", NULL);
+    g_remove (fmtfile);
+    g_free (fmtfile);
+    g_free (fmtpath);
+}
+
+void preformat_forget (GuEditor* ec, gboolean remove_format) {
+    PreformatState* state = NULL;
+    gchar* hash = NULL;
+
+    if (!preformat_states) return;
+
+    g_mutex_lock (&preformat_mutex);
+    if ((state = g_hash_table_lookup (preformat_states, ec->workfile))) {
+        hash = g_strdup (state->format_hash);
+        g_hash_table_remove (preformat_states, ec->workfile);
+        if (hash && remove_format) preformat_remove_format (hash);
+    }
+    g_mutex_unlock (&preformat_mutex);
+    g_free (hash);
+}
+
+gchar* preformat_get_command (const gchar* method, GuEditor* ec) {
+    PreformatState* state = NULL;
+    const gchar* typesetter = NULL;
+    gchar* workfile = ec->workfile;
+    /* filled in by latex_update_pdffile before */
+    const gchar* inputs = ec->deps? depgraph_preamble_hash (ec->deps): NULL;
+    gchar* flags = NULL;
+    gchar* hash = NULL;
+    gchar* texcmd = NULL;
+    gboolean usable = FALSE;
+    gboolean dump = FALSE;
+
+    /* mylatexformat reads the file name as a TeX token */
+    if (!STR_EQU (method, "texpdf") || strchr (workfile, ' ') ||
+        !preformat_detected ())
+        return NULL;
+
+    typesetter = pdflatex_active ()? C_PDFLATEX: C_XELATEX;
+    flags = texlive_get_flags ("texpdf");
+
+    if (!(hash = preformat_preamble_hash (workfile, typesetter, flags,
+                                          inputs))) {
+        g_free (flags);
+        return NULL;
+    }
+
+    g_mutex_lock (&preformat_mutex);
+    if (!(state = g_hash_table_lookup (preformat_states, workfile))) {
+        state = g_new0 (PreformatState, 1);
+        g_hash_table_insert (preformat_states, g_strdup (workfile), state);
+    }
+
+    if (STR_EQU (hash, state->format_hash)) {
+        gchar* fmtpath = preformat_get_path (hash);
+        gchar* fmtfile = g_strconcat (fmtpath, ".fmt", NULL);
+        usable = g_file_test (fmtfile, G_FILE_TEST_EXISTS);
+        g_free (fmtfile);
+        g_free (fmtpath);
+    }
+
+    /* Only dump once the preamble is stable, i.e. unchanged since the
+     * previous run, every dump costs about as much as a full compile */
+    dump = !usable && !state->dumping && STR_EQU (hash, state->seen_hash);
+    state->dumping |= dump;
+    g_free (state->seen_hash);
+    state->seen_hash = g_strdup (hash);
+    g_mutex_unlock (&preformat_mutex);
+
+    /* the other workers must not wait for the dump */
+    if (dump) {
+        usable = preformat_dump (typesetter, flags, ec, hash);
+
+        g_mutex_lock (&preformat_mutex);
+        /* the document may have been closed meanwhile */
+        if ((state = g_hash_table_lookup (preformat_states, workfile))) {
+            gchar* previous = state->format_hash;
+
+            state->dumping = FALSE;
+            if (usable) {
+                state->format_hash = g_strdup (hash);
+                if (previous && !STR_EQU (hash, previous))
+                    preformat_remove_format (previous);
+                g_free (previous);
+            }
+        }
+        g_mutex_unlock (&preformat_mutex);
+    }
+
+    if (usable) {
+        gchar* fmtpath = preformat_get_path (hash);
+        texcmd = g_strdup_printf ("%s %s -fmt=\"%s\" "
+                                  "-output-directory=\"%s\" \"%s\"",
+                                  typesetter, flags, fmtpath,
+                                  ec->builddir, workfile);
+        g_free (fmtpath);
+    }
+    else {
+        slog (L_DEBUG, "Preamble of %s changed, using regular build\n",
+                       ec->jobfile);
+    }
+
+    g_free (hash);
+    g_free (flags);
+    return texcmd;
+}
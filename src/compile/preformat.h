@@ -0,0 +1,59 @@
+/**
+ * @file   preformat.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_COMPILE_PREFORMAT_H__
+#define __GUMMI_COMPILE_PREFORMAT_H__
+
+#include <glib.h>
+
+#include "editor.h"
+
+void preformat_init (void);
+gboolean preformat_active (void);
+
+/**
+ * preformat_forget:
+ *
+ * Drops what is known about the format of ec. The format file is removed
+ * as well if remove_format is set and no other document of this process
+ * uses it. Batch builds keep it, an editor may be using it.
+ */
+void preformat_forget (GuEditor* ec, gboolean remove_format);
+
+/**
+ * preformat_get_command:
+ *
+ * Returns a command that compiles the document body against a dumped
+ * preamble format, or NULL when the regular texlive command has to be
+ * used instead. Dumping a format is part of the compile job of ec and is
+ * cancelled along with it.
+ */
+gchar* preformat_get_command (const gchar* method, GuEditor* ec);
+
+#endif /* __GUMMI_COMPILE_PREFORMAT_H__ */
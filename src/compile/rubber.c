@@ -47,7 +47,7 @@ void rubber_init (void) {
 }
 
 gboolean rubber_active (void) {
-    if (config_value_as_str_equals ("Compile", "typesetter", C_RUBBER)) {
+    if (STR_EQU (external_typesetter (), C_RUBBER)) {
         return TRUE;
     }
     return FALSE;
@@ -57,13 +57,16 @@ gboolean rubber_detected (void) {
     return rub_detected;
 }
 
-gchar* rubber_get_command (const gchar* method, gchar* workfile) {
+gchar* rubber_get_command (const gchar* method, gchar* workfile, gchar* jobfile) {
 
-    const gchar* outdir = g_strdup_printf ("--into=\"%s\"", C_TMPDIR);
+    gchar* builddir = g_path_get_dirname (jobfile);
+    gchar* outdir = g_strdup_printf ("--into=\"%s\"", builddir);
     const gchar* flags = rubber_get_flags (method);
     gchar* rubcmd;
 
     rubcmd = g_strdup_printf("rubber %s %s \"%s\"", flags, outdir, workfile);
+    g_free (outdir);
+    g_free (builddir);
 
     return rubcmd;
 }
@@ -77,7 +80,7 @@ gchar* rubber_get_flags (const gchar *method) {
         rubflags = g_strdup_printf("-p -d -q");
     }
 
-    if (config_get_boolean ("Compile", "synctex")) {
+    if (config_hot.synctex) {
         rubflags = g_strconcat ("--synctex ", rubflags, NULL);
     }
 
@@ -36,7 +36,7 @@ void rubber_init (void);
 gboolean rubber_active (void);
 gboolean rubber_detected (void);
 
-gchar* rubber_get_command (const gchar* method, gchar* workfile);
+gchar* rubber_get_command (const gchar* method, gchar* workfile, gchar* jobfile);
 gchar* rubber_get_flags (const gchar *method);
 
 #endif /* __GUMMI_COMPILE_RUBBER_H */
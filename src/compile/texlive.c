@@ -79,21 +79,21 @@ gboolean texlive_active (void) {
 }
 
 gboolean pdflatex_active (void) {
-    if (config_value_as_str_equals ("Compile", "typesetter", "pdflatex")) {
+    if (STR_EQU (external_typesetter (), "pdflatex")) {
         return TRUE;
     }
     return FALSE;
 }
 
 gboolean xelatex_active (void) {
-    if (config_value_as_str_equals ("Compile", "typesetter", "xelatex")) {
+    if (STR_EQU (external_typesetter (), "xelatex")) {
         return TRUE;
     }
     return FALSE;
 }
 
 gboolean lualatex_active (void) {
-    if (config_value_as_str_equals ("Compile", "typesetter", "lualatex")) {
+    if (STR_EQU (external_typesetter (), "lualatex")) {
         return TRUE;
     }
     return FALSE;
@@ -111,9 +111,10 @@ gboolean lualatex_detected (void) {
     return lua_detected;
 }
 
-gchar* texlive_get_command (const gchar* method, gchar* workfile, gchar* basename) {
+gchar* texlive_get_command (const gchar* method, gchar* workfile, gchar* jobfile) {
 
-    const gchar* outdir = g_strdup_printf("-output-directory=\"%s\"", C_TMPDIR);
+    gchar* builddir = g_path_get_dirname (jobfile);
+    gchar* outdir = g_strdup_printf("-output-directory=\"%s\"", builddir);
 
 
     gchar *typesetter = NULL;
@@ -125,8 +126,8 @@ gchar* texlive_get_command (const gchar* method, gchar* workfile, gchar* basenam
 
     gchar *flags = texlive_get_flags("texpdf");
 
-    gchar *dviname = g_strdup_printf("%s.dvi", g_path_get_basename (basename));
-    gchar *psname = g_strdup_printf("%s.ps", g_path_get_basename (basename));
+    gchar *dviname = g_strdup_printf("%s.dvi", g_path_get_basename (jobfile));
+    gchar *psname = g_strdup_printf("%s.ps", g_path_get_basename (jobfile));
 
     #ifdef WIN32
     gchar *script = g_build_filename (GUMMI_LIBS, "latex_dvi.cmd", NULL);
@@ -143,20 +144,43 @@ gchar* texlive_get_command (const gchar* method, gchar* workfile, gchar* basenam
     } else if (STR_EQU (method, "texdvipdf")) {
         texcmd = g_strdup_printf("%s pdf "
                 "\"%s\" \"%s\" \"%s\" \"%s\" \"%s\"", script,
-                flags, outdir, workfile, C_TMPDIR, dviname);
+                flags, outdir, workfile, builddir, dviname);
     } else {
         texcmd = g_strdup_printf("%s ps "
                 "\"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \"%s\"", script,
-                flags, outdir, workfile, C_TMPDIR, dviname, psname);
+                flags, outdir, workfile, builddir, dviname, psname);
     }
 
     g_free(script);
+    g_free(outdir);
+    g_free(builddir);
     g_free(dviname);
     g_free(psname);
 
     return texcmd;
 }
 
+gchar* texlive_get_job_command (const gchar* input, const gchar* jobfile) {
+    gchar *typesetter = NULL;
+    gchar *jobname = g_path_get_basename (jobfile);
+    gchar *builddir = g_path_get_dirname (jobfile);
+
+    if (pdflatex_active()) typesetter = C_PDFLATEX;
+    else if (lualatex_active()) typesetter = C_LUALATEX;
+    else typesetter = C_XELATEX;
+
+    gchar *flags = texlive_get_flags("texpdf");
+    gchar *texcmd = g_strdup_printf("%s %s -jobname=\"%s\" "
+                                    "-output-directory=\"%s\" \"%s\"",
+                                    typesetter, flags, jobname, builddir,
+                                    input);
+    g_free(flags);
+    g_free(jobname);
+    g_free(builddir);
+
+    return texcmd;
+}
+
 gchar* texlive_get_flags (const gchar* method) {
     gchar* flags = g_strdup_printf("-interaction=nonstopmode "
                                       "-file-line-error "
@@ -173,8 +197,10 @@ gchar* texlive_get_flags (const gchar* method) {
         flags = tmp;
     }
 
-    if (config_get_boolean ("Compile", "synctex")) {
-        gchar* tmp = g_strconcat(flags, " -synctex=1", NULL);
+    // output goes to our own cache directory, so skip gzipping the
+    // synctex file only to have it unpacked again for every lookup
+    if (config_hot.synctex) {
+        gchar* tmp = g_strconcat(flags, " -synctex=-1", NULL);
         g_free(flags);
         flags = tmp;
     }
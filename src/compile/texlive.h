@@ -43,7 +43,12 @@ gboolean pdflatex_detected (void);
 gboolean xelatex_detected (void);
 gboolean lualatex_detected (void);
 
-gchar* texlive_get_command (const gchar* method, gchar* workfile, gchar* basename);
+/* output files go to the directory of @jobfile */
+gchar* texlive_get_command (const gchar* method, gchar* workfile, gchar* jobfile);
 gchar* texlive_get_flags (const gchar *method);
 
+/* pdf route only, @input is handed to the typesetter as is and the output
+ * named after @jobfile */
+gchar* texlive_get_job_command (const gchar* input, const gchar* jobfile);
+
 #endif /* __GUMMI_COMPILE_TEXLIVE_H__ */
@@ -71,6 +71,9 @@ const gchar default_config[] =
 "autosync = false\n"
 "animated_scroll = always\n"
 "cache_size = 150\n"
+"render_threads = 2\n"
+"prefetch = 1\n"
+"parked_documents = 4\n"
 "\n"
 "[File]\n"
 "autosaving = false\n"
@@ -83,8 +86,15 @@ const gchar default_config[] =
 "pause = false\n"
 "scheme = on_idle\n"
 "timer = 1\n"
+"adaptive_timer = true\n"
+"throttle_load = true\n"
 "shellescape = true\n"
 "synctex = false\n"
+"preformat = false\n"
+"background = true\n"
+"background_nice = 10\n"
+"includeonly = false\n"
+"staging_dir =\n"
 "\n"
 "[Misc]\n"
 "recent1 = __NULL__\n"
@@ -96,8 +106,164 @@ const gchar default_config[] =
 GKeyFile *key_file = NULL;
 gchar *conf_filepath = 0;
 
+GuConfigHot config_hot;
+
+/* Parsed configuration, group -> key -> ConfigValue. Group and key names as
+ * well as string values are interned, so readers on other threads can hold on
+ * to a returned string after the lock is dropped. The GKeyFile is only read
+ * when loading and only written when saving. */
+typedef struct {
+    const gchar* str;
+    gboolean boolean;
+    gboolean is_boolean;
+    gint integer;
+    gboolean is_integer;
+} ConfigValue;
+
+typedef struct {
+    const gchar* group;
+    const gchar* key;
+    GuConfigNotify func;
+    gpointer user;
+} ConfigListener;
+
+/* config_hot is read without a lock, so it and the listeners are only
+ * updated from the thread that ran config_init */
+static GThread* config_thread = NULL;
+
+static GMutex store_mutex;
+static GHashTable* config_store = NULL;
+static GHashTable* default_store = NULL;
+static GSList* listeners = NULL;
+
+/* config_hot strings replaced by the last refresh, freed by the next one so
+ * that a worker that read one during a refresh is done with it */
+static GPtrArray* hot_retired = NULL;
+
+static GHashTable* store_new (void) {
+    return g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                  (GDestroyNotify) g_hash_table_destroy);
+}
+
+static ConfigValue* store_lookup (GHashTable* store, const gchar* group,
+                                  const gchar* key) {
+    GHashTable* keys = g_hash_table_lookup (store, group);
+    return keys? g_hash_table_lookup (keys, key): NULL;
+}
+
+/* Returns TRUE when the stored value changed */
+static gboolean store_insert (GHashTable* store, const gchar* group,
+                              const gchar* key, const gchar* str) {
+    GHashTable* keys = g_hash_table_lookup (store, group);
+    if (!keys) {
+        keys = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+        g_hash_table_insert (store, (gpointer) g_intern_string (group), keys);
+    }
+    ConfigValue* value = g_hash_table_lookup (keys, key);
+    const gchar* interned = g_intern_string (str);
+
+    if (value && value->str == interned) return FALSE;
+    if (!value) {
+        value = g_new0 (ConfigValue, 1);
+        g_hash_table_insert (keys, (gpointer) g_intern_string (key), value);
+    }
+    gchar* end = NULL;
+    gint64 integer = g_ascii_strtoll (interned, &end, 10);
+
+    value->str = interned;
+    value->is_boolean = STR_EQU (interned, "true") || STR_EQU (interned, "1") ||
+                        STR_EQU (interned, "false") || STR_EQU (interned, "0");
+    value->boolean = STR_EQU (interned, "true") || STR_EQU (interned, "1");
+    value->is_integer = end != interned && *end == '\0' &&
+                        integer >= G_MININT && integer <= G_MAXINT;
+    value->integer = value->is_integer? (gint) integer: 0;
+    return TRUE;
+}
+
+static void store_load (GHashTable* store, GKeyFile* keys) {
+    gchar** groups = g_key_file_get_groups (keys, NULL);
+    gchar** group;
+    gchar** key;
+
+    for (group = groups; *group; ++group) {
+        gchar** names = g_key_file_get_keys (keys, *group, NULL, NULL);
+        for (key = names; key && *key; ++key) {
+            gchar* str = g_key_file_get_string (keys, *group, *key, NULL);
+            if (str) store_insert (store, *group, *key, str);
+            g_free (str);
+        }
+        g_strfreev (names);
+    }
+    g_strfreev (groups);
+}
+
+static const gchar* config_hot_string (const gchar* old, const gchar* group,
+                                      const gchar* key) {
+    const gchar* value = config_get_string (group, key);
+
+    if (old && value && STR_EQU (old, value)) return old;
+    if (old) g_ptr_array_add (hot_retired, (gpointer) old);
+    return g_strdup (value);
+}
+
+static void config_hot_refresh (void) {
+    if (!hot_retired) hot_retired = g_ptr_array_new_with_free_func (g_free);
+    g_ptr_array_set_size (hot_retired, 0);
+
+    config_hot.snippets = config_get_boolean ("Interface", "snippets");
+    config_hot.typesetter = config_hot_string (config_hot.typesetter,
+                                               "Compile", "typesetter");
+    config_hot.steps = config_hot_string (config_hot.steps,
+                                          "Compile", "steps");
+    config_hot.scheme = config_hot_string (config_hot.scheme,
+                                           "Compile", "scheme");
+    config_hot.real_time = STR_EQU (config_hot.scheme, "real_time");
+    config_hot.timer = config_get_integer ("Compile", "timer");
+    config_hot.adaptive_timer = config_get_boolean ("Compile",
+                                                    "adaptive_timer");
+    config_hot.throttle_load = config_get_boolean ("Compile", "throttle_load");
+    config_hot.pause = config_get_boolean ("Compile", "pause");
+    config_hot.shellescape = config_get_boolean ("Compile", "shellescape");
+    config_hot.synctex = config_get_boolean ("Compile", "synctex");
+    config_hot.preformat = config_get_boolean ("Compile", "preformat");
+    config_hot.background = config_get_boolean ("Compile", "background");
+    config_hot.background_nice = config_get_integer ("Compile",
+                                                     "background_nice");
+    config_hot.includeonly = config_get_boolean ("Compile", "includeonly");
+    config_hot.autosync = config_get_boolean ("Preview", "autosync");
+    config_hot.animated_scroll = config_hot_string (config_hot.animated_scroll,
+                                                    "Preview",
+                                                    "animated_scroll");
+    config_hot.cache_size = config_get_integer ("Preview", "cache_size");
+}
+
+static void config_notify (const gchar* group, const gchar* key) {
+    GSList* item;
+
+    for (item = listeners; item; item = item->next) {
+        ConfigListener* l = item->data;
+        if (!STR_EQU (l->group, group)) continue;
+        if (l->key && !STR_EQU (l->key, key)) continue;
+        l->func (group, key, l->user);
+    }
+}
+
+static void config_changed (const gchar* group, const gchar* key) {
+    config_hot_refresh ();
+    config_notify (group, key);
+}
+
+static void config_store_reload (void) {
+    g_mutex_lock (&store_mutex);
+    if (config_store) g_hash_table_destroy (config_store);
+    config_store = store_new ();
+    store_load (config_store, key_file);
+    g_mutex_unlock (&store_mutex);
+}
+
 
 void config_init () {
+    config_thread = g_thread_self ();
     conf_filepath = g_build_filename (C_GUMMI_CONFDIR, "gummi.ini", NULL);
 
     // create config & template dirs if not exists:
@@ -106,6 +272,13 @@ void config_init () {
         g_mkdir_with_parents (C_GUMMI_TEMPLATEDIR, DIR_PERMS);
     }
 
+    // parse the defaults once, missing keys are filled in from here:
+    g_autoptr(GKeyFile) default_keys = g_key_file_new ();
+    g_key_file_load_from_data (default_keys, default_config,
+                               strlen (default_config), G_KEY_FILE_NONE, NULL);
+    default_store = store_new ();
+    store_load (default_store, default_keys);
+
     // load config file:
     g_autoptr(GError) error = NULL;
     key_file = g_key_file_new ();
@@ -119,6 +292,10 @@ void config_init () {
         }
         config_load_defaults (key_file);
     }
+    else {
+        config_store_reload ();
+        config_hot_refresh ();
+    }
 
     // replace old welcome texts if still active:
     gchar* text;
@@ -136,91 +313,89 @@ void config_init () {
     slog (L_INFO, "Configuration file: %s\n", conf_filepath);
 }
 
+void config_notify_add (const gchar* group, const gchar* key,
+                        GuConfigNotify func, gpointer user) {
+    ConfigListener* l = g_new0 (ConfigListener, 1);
+
+    l->group = g_intern_string (group);
+    l->key = key? g_intern_string (key): NULL;
+    l->func = func;
+    l->user = user;
+    listeners = g_slist_append (listeners, l);
+}
+
 const gchar* config_get_string (const gchar* group, const gchar* key) {
-    g_autoptr(GError) error = NULL;
-    gchar* value;
-    
-    value = g_key_file_get_string (key_file, group, key, &error);
+    const gchar* value = NULL;
 
-    if (error) {
+    g_mutex_lock (&store_mutex);
+    ConfigValue* v = store_lookup (config_store, group, key);
+    if (v) value = v->str;
+    g_mutex_unlock (&store_mutex);
+
+    if (!value) {
         return config_get_default_string (group, key);
     }
     return value;
 }
 
 const gboolean config_get_boolean (const gchar* group, const gchar* key) {
-    g_autoptr(GError) error = NULL;
+    gboolean found = FALSE;
     gboolean value = FALSE;
 
-    value = g_key_file_get_boolean (key_file, group, key, &error);
+    g_mutex_lock (&store_mutex);
+    ConfigValue* v = store_lookup (config_store, group, key);
+    if (v && v->is_boolean) {
+        found = TRUE;
+        value = v->boolean;
+    }
+    g_mutex_unlock (&store_mutex);
 
-    if (error) {
+    if (!found) {
         return config_get_default_boolean (group, key);
     }
     return value;
 }
 
 const gint config_get_integer (const gchar* group, const gchar* key) {
-    g_autoptr(GError) error = NULL;
-    gint value = FALSE;
-
-    value = g_key_file_get_integer (key_file, group, key, &error);
+    gboolean found = FALSE;
+    gint value = 0;
+
+    g_mutex_lock (&store_mutex);
+    ConfigValue* v = store_lookup (config_store, group, key);
+    if (v && v->is_integer) {
+        found = TRUE;
+        value = v->integer;
+    }
+    g_mutex_unlock (&store_mutex);
 
-    if (error) {
+    if (!found) {
         return config_get_default_integer (group, key);
     }
     return value;
 }
 
 const gchar* config_get_default_string (const gchar* group, const gchar* key) {
-    g_autoptr(GKeyFile) default_keys = g_key_file_new ();
-    gchar *default_value;
+    ConfigValue* v = store_lookup (default_store, group, key);
 
-    g_key_file_load_from_data (default_keys, 
-                               default_config, 
-                               strlen (default_config), 
-                               G_KEY_FILE_NONE, NULL);
+    slog (L_DEBUG, "Config get default value for '%s.%s'\n", group, key);
 
-    slog (L_WARNING, "Config get default value for '%s.%s'\n", group, key);
-
-    default_value = g_key_file_get_string (default_keys, group, key, NULL);
-    config_set_string (group, key, default_value);
-
-    return default_value;
+    return v? v->str: NULL;
 }
 
 const gboolean config_get_default_boolean (const gchar* group, const gchar* key) {
-    g_autoptr(GKeyFile) default_keys = g_key_file_new ();
-    gboolean default_value;
-    
-    g_key_file_load_from_data (default_keys, 
-                               default_config, 
-                               strlen (default_config), 
-                               G_KEY_FILE_NONE, NULL);
-
-    slog (L_WARNING, "Config get default value for '%s.%s'\n", group, key);
-    
-    default_value = g_key_file_get_boolean (default_keys, group, key, NULL);
-    config_set_boolean (group, key, default_value);
-    
-    return default_value;
-}
+    ConfigValue* v = store_lookup (default_store, group, key);
 
-const gint config_get_default_integer (const gchar* group, const gchar* key) {
-    g_autoptr(GKeyFile) default_keys = g_key_file_new ();
-    gint default_value;
+    slog (L_DEBUG, "Config get default value for '%s.%s'\n", group, key);
 
-    g_key_file_load_from_data (default_keys,
-                               default_config,
-                               strlen (default_config),
-                               G_KEY_FILE_NONE, NULL);
+    return v? v->boolean: FALSE;
+}
 
-    slog (L_WARNING, "Config get default value for '%s.%s'\n", group, key);
+const gint config_get_default_integer (const gchar* group, const gchar* key) {
+    ConfigValue* v = store_lookup (default_store, group, key);
 
-    default_value = g_key_file_get_integer (default_keys, group, key, NULL);
-    config_set_integer (group, key, default_value);
+    slog (L_DEBUG, "Config get default value for '%s.%s'\n", group, key);
 
-    return default_value;
+    return v? v->integer: 0;
 }
 
 gboolean config_value_as_str_equals (const gchar* group, const gchar* key, gchar* input) {
@@ -234,31 +409,74 @@ gboolean config_value_as_str_equals (const gchar* group, const gchar* key, gchar
 }
 
 void config_set_string (const gchar *group, const gchar *key, gchar* value) {
-    g_key_file_set_string (key_file, group, key, value);
+    g_return_if_fail (g_thread_self () == config_thread);
+    if (!value) return;
+
+    g_mutex_lock (&store_mutex);
+    gboolean changed = store_insert (config_store, group, key, value);
+    g_mutex_unlock (&store_mutex);
+
+    if (changed) config_changed (group, key);
 }
 
 void config_set_boolean (const gchar *group, const gchar *key, gboolean value) {
-    g_key_file_set_boolean (key_file, group, key, value);
+    config_set_string (group, key, value? "true": "false");
 }
 
 void config_set_integer (const gchar *group, const gchar *key, gint value) {
-    g_key_file_set_integer (key_file, group, key, value);
+    gchar* str = g_strdup_printf ("%d", value);
+    config_set_string (group, key, str);
+    g_free (str);
 }
 
 void config_load_defaults () {
     g_autoptr(GError) error = NULL;
+    GSList* item;
 
+    g_return_if_fail (g_thread_self () == config_thread);
     g_key_file_load_from_data (key_file, default_config, strlen(default_config),
                                G_KEY_FILE_NONE, &error);
 
     if (error) {
         slog (L_ERROR, "Error loading default config: %s\n", error->message);
     }
+    config_store_reload ();
+    config_hot_refresh ();
+
+    for (item = listeners; item; item = item->next) {
+        ConfigListener* l = item->data;
+        l->func (l->group, l->key, l->user);
+    }
     config_save ();
 }
 
 void config_save () {
     g_autoptr(GError) error = NULL;
+    GHashTableIter groups, keys;
+    gpointer group, key, keytable, value;
+
+    // keys missing from the file are written with their default:
+    g_hash_table_iter_init (&groups, default_store);
+    while (g_hash_table_iter_next (&groups, &group, &keytable)) {
+        g_hash_table_iter_init (&keys, keytable);
+        while (g_hash_table_iter_next (&keys, &key, &value)) {
+            if (!g_key_file_has_key (key_file, group, key, NULL))
+                g_key_file_set_string (key_file, group, key,
+                                       ((ConfigValue*) value)->str);
+        }
+    }
+
+    // write the in-memory values back before serializing:
+    g_mutex_lock (&store_mutex);
+    g_hash_table_iter_init (&groups, config_store);
+    while (g_hash_table_iter_next (&groups, &group, &keytable)) {
+        g_hash_table_iter_init (&keys, keytable);
+        while (g_hash_table_iter_next (&keys, &key, &value)) {
+            g_key_file_set_string (key_file, group, key,
+                                   ((ConfigValue*) value)->str);
+        }
+    }
+    g_mutex_unlock (&store_mutex);
 
     if (!g_key_file_save_to_file (key_file, conf_filepath, &error)) {
         if (error) {
@@ -266,3 +484,25 @@ void config_save () {
         }
     }
 }
+
+void config_clean_up () {
+    g_return_if_fail (g_thread_self () == config_thread);
+
+    g_free ((gchar*) config_hot.typesetter);
+    g_free ((gchar*) config_hot.steps);
+    g_free ((gchar*) config_hot.scheme);
+    g_free ((gchar*) config_hot.animated_scroll);
+    memset (&config_hot, 0, sizeof (config_hot));
+    if (hot_retired) g_ptr_array_free (hot_retired, TRUE);
+    hot_retired = NULL;
+
+    g_slist_free_full (listeners, g_free);
+    listeners = NULL;
+    if (config_store) g_hash_table_destroy (config_store);
+    if (default_store) g_hash_table_destroy (default_store);
+    config_store = default_store = NULL;
+    g_key_file_free (key_file);
+    key_file = NULL;
+    g_free (conf_filepath);
+    conf_filepath = NULL;
+}
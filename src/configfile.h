@@ -32,10 +32,47 @@
 
 #include <glib.h>
 
+/* Pre-parsed copy of the settings read on every keystroke, every compile tick
+ * or from the compile workers. Kept current by config_init, config_set_* and
+ * config_load_defaults; a string that is replaced stays valid until the next
+ * change and the rest until config_clean_up. Read only. */
+typedef struct _GuConfigHot {
+    gboolean snippets;              /* Interface */
+    const gchar* typesetter;        /* Compile */
+    const gchar* steps;
+    const gchar* scheme;
+    gboolean real_time;
+    gint timer;
+    gboolean adaptive_timer;
+    gboolean throttle_load;
+    gboolean pause;
+    gboolean shellescape;
+    gboolean synctex;
+    gboolean preformat;
+    gboolean background;
+    gint background_nice;
+    gboolean includeonly;
+    gboolean autosync;              /* Preview */
+    const gchar* animated_scroll;
+    gint cache_size;
+} GuConfigHot;
+
+extern GuConfigHot config_hot;
+
+/* Called on the main thread, the only one that may change the values. key is
+ * NULL when the whole configuration was reset and the listener was added for
+ * a whole group. */
+typedef void (*GuConfigNotify) (const gchar* group, const gchar* key,
+                                gpointer user);
 
 void config_init ();
 void config_load_defaults ();
 void config_save ();
+void config_clean_up ();
+
+// change notification, key may be NULL to watch a whole group:
+void config_notify_add (const gchar* group, const gchar* key,
+                        GuConfigNotify func, gpointer user);
 
 // config get functions:
 const gchar*   config_get_string  (const gchar* group, const gchar* key);
@@ -47,7 +84,7 @@ const gchar*   config_get_default_string  (const gchar* group, const gchar* key)
 const gboolean config_get_default_boolean (const gchar* group, const gchar* key);
 const gint     config_get_default_integer (const gchar* group, const gchar* key);
 
-// config set functions:
+// config set functions, main thread only:
 void config_set_string  (const gchar *group, const gchar *key, gchar* value);
 void config_set_boolean (const gchar *group, const gchar *key, gboolean value);
 void config_set_integer (const gchar *group, const gchar *key, gint value);
@@ -140,7 +140,7 @@
 #else
     #define C_TMPDIR g_build_path(G_DIR_SEPARATOR_S, g_get_user_cache_dir(), "gummi", NULL)
     #define C_CMDSEP ";"
-    #define C_TEXSEC "env openout_any=a"
+    #define C_TEXSEC "env openout_any=a max_print_line=10000"
 #endif
 
 #endif /* __GUMMI_CONSTANTS_H__ */
@@ -0,0 +1,102 @@
+/**
+ * @file   debounce.c
+ * @brief  Idle delay before a compile
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "debounce.h"
+
+#include <glib.h>
+
+#include "configfile.h"
+#include "utils.h"
+
+/* Pauses longer than this are breaks, they say nothing about typing speed */
+#define DEBOUNCE_TYPING_GAP_MS 1500
+/* Typing pause assumed until there are keystrokes to go by */
+#define DEBOUNCE_INITIAL_GAP_MS 150
+/* How often the load average is read, microseconds */
+#define DEBOUNCE_LOAD_INTERVAL (5 * G_USEC_PER_SEC)
+
+GuDebounce* debounce_new (void) {
+    GuDebounce* d = g_new0 (GuDebounce, 1);
+    d->gap_ms = DEBOUNCE_INITIAL_GAP_MS;
+    return d;
+}
+
+void debounce_keystroke (GuDebounce* d) {
+    gint64 now = g_get_monotonic_time ();
+    gdouble gap = (now - d->last_key) / 1000.0;
+
+    d->last_key = now;
+    if (gap <= DEBOUNCE_TYPING_GAP_MS)
+        d->gap_ms = (3 * d->gap_ms + gap) / 4;
+}
+
+/* Stretch factor for when more is runnable than there are processors, the
+ * compile would only compete with it. There is no load average to go by
+ * outside of Linux, nothing is stretched there */
+static gdouble debounce_load_factor (GuDebounce* d) {
+    gint64 now = g_get_monotonic_time ();
+    gchar* contents = NULL;
+
+    if (d->load_time == 0 || now - d->load_time > DEBOUNCE_LOAD_INTERVAL) {
+        d->load_time = now;
+        d->load = 0;
+        if (g_file_get_contents ("/proc/loadavg", &contents, NULL, NULL)) {
+            d->load = g_ascii_strtod (contents, NULL) /
+                      g_get_num_processors ();
+            g_free (contents);
+        }
+    }
+    return CLAMP (d->load, 1.0, 4.0);
+}
+
+/**
+ * @brief Milliseconds of idle time after which the text is compiled
+ * @param compile_ms average compile time of the document, 0 if unknown
+ */
+guint debounce_delay (GuDebounce* d, gint compile_ms) {
+    gdouble delay = 0;
+    guint previous = d->delay_ms;
+
+    if (!config_hot.adaptive_timer)
+        return config_hot.timer * 1000;
+
+    delay = 2 * d->gap_ms;
+    if (compile_ms > delay)
+        delay = (delay + compile_ms) / 2;
+    if (config_hot.throttle_load)
+        delay *= debounce_load_factor (d);
+
+    d->delay_ms = CLAMP ((guint)delay, DEBOUNCE_MIN_MS, DEBOUNCE_MAX_MS);
+    if (d->delay_ms > previous * 5 / 4 || d->delay_ms < previous * 3 / 4) {
+        slog (L_DEBUG, "Compile delay %u ms (typing pauses %.0f ms, "
+                       "compile %d ms, load %.2f)\n", d->delay_ms,
+                       d->gap_ms, compile_ms, d->load);
+    }
+    return d->delay_ms;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file   debounce.h
+ * @brief  Idle delay before a compile
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_DEBOUNCE_H__
+#define __GUMMI_DEBOUNCE_H__
+
+#include <glib.h>
+
+/* Bounds of the adaptive delay, milliseconds */
+#define DEBOUNCE_MIN_MS 100
+#define DEBOUNCE_MAX_MS 10000
+
+typedef struct _GuDebounce GuDebounce;
+
+/* Picks how long the editor has to be idle before the text is compiled.
+ * A pause is taken to be over when it is clearly longer than the ones
+ * between keystrokes; documents that take longer to compile than such a
+ * pause wait for a longer one, as the next keystroke would abort their
+ * compile anyway. Main thread only. */
+struct _GuDebounce {
+    gint64 last_key;        /* monotonic time of the last keystroke */
+    gdouble gap_ms;         /* running average of the typing pauses */
+    gint64 load_time;       /* when load was read */
+    gdouble load;           /* load average per processor */
+    guint delay_ms;         /* last delay handed out */
+};
+
+GuDebounce* debounce_new (void);
+void debounce_keystroke (GuDebounce* d);
+guint debounce_delay (GuDebounce* d, gint compile_ms);
+
+#endif /* __GUMMI_DEBOUNCE_H__ */
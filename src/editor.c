@@ -45,6 +45,9 @@
 #include "environment.h"
 #include "utils.h"
 
+#include "compile/auxcache.h"
+#include "compile/preformat.h"
+
 static void on_inserted_text(GtkTextBuffer *textbuffer,GtkTextIter *location,
                              gchar *text,gint len, gpointer user_data);
 static void on_delete_range(GtkTextBuffer *textbuffer,GtkTextIter *start,
@@ -72,6 +75,14 @@ GuEditor* editor_new (GuMotion* mc) {
     ec->bibfile = NULL;
     ec->projfile = NULL;
 
+    g_mutex_init (&ec->snapshot_mutex);
+    ec->snapshot = NULL;
+
+    g_mutex_init (&ec->compile_mutex);
+    ec->log = logparser_new ();
+    ec->compilelog = NULL;
+    ec->modified_since_compile = FALSE;
+
     GtkSourceLanguageManager* manager = gtk_source_language_manager_new ();
     GtkSourceLanguage* lang = gtk_source_language_manager_get_language (manager,
             "latex");
@@ -136,6 +147,13 @@ void editor_destroy (GuEditor* ec) {
     }
 
     editor_fileinfo_cleanup (ec);
+    snapshot_unref (ec->snapshot);
+    g_mutex_clear (&ec->snapshot_mutex);
+    logparser_free (ec->log);
+    g_free (ec->compilelog);
+    g_free (ec->compiled_hash);
+    depgraph_free (ec->deps);
+    g_mutex_clear (&ec->compile_mutex);
     g_free(ec);
 }
 
@@ -146,6 +164,14 @@ static void on_inserted_text(GtkTextBuffer *textbuffer,GtkTextIter *location,
         return;
     }
     GuEditor* e = GU_EDITOR(user_data);
+    gint line = gtk_text_iter_get_line (location);
+    gint i;
+
+    /* location is behind the inserted text by now */
+    for (i = 0; i < len && text[i]; ++i) {
+        if (text[i] == '\n') --line;
+    }
+    e->snapshot_clean_lines = MIN (e->snapshot_clean_lines, line);
 
     e->last_edit = *location;
     e->sync_to_last_edit = TRUE;
@@ -159,6 +185,9 @@ static void on_delete_range(GtkTextBuffer *textbuffer,GtkTextIter *start,
     }
     GuEditor* e = GU_EDITOR(user_data);
 
+    e->snapshot_clean_lines = MIN (e->snapshot_clean_lines,
+                                   gtk_text_iter_get_line (start));
+
     e->last_edit = *start;
     e->sync_to_last_edit = TRUE;
 }
@@ -185,7 +214,38 @@ static void on_delete_range(GtkTextBuffer *textbuffer,GtkTextIter *start,
  * filename = /absolute/path/FILE.tex
  * workfile = /absolute/path/.FILE.tex.swp
  * pdffile = ~/cache/gummi/.FILE.tex.pdf
+ *
+ * The typesetter does not write pdffile itself. Its output goes to a
+ * staging directory of the document, builddir, below ~/.cache/gummi/staging
+ * or the staging_dir configured (a tmpfs saves the disk writes), and is
+ * named after jobfile:
+ *
+ * builddir = ~/.cache/gummi/staging/HASH
+ * jobfile = ~/.cache/gummi/staging/HASH/.FILE.tex
+ *
+ * Only finished pdfs are published to pdffile, see latex_update_pdffile.
  */
+static gchar* editor_staging_dir (GuEditor* ec) {
+    const gchar* key = ec->filename? ec->filename: ec->fdname;
+    gchar* hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+    gchar* root = editor_staging_root ();
+    gchar* dir = NULL;
+
+    hash[16] = 0;
+    dir = g_build_filename (root, hash, NULL);
+    g_free (root);
+    g_free (hash);
+    return dir;
+}
+
+gchar* editor_staging_root (void) {
+    const gchar* root = config_get_string ("Compile", "staging_dir");
+
+    if (root && *root)
+        return g_strdup (root);
+    return g_build_filename (C_TMPDIR, "staging", NULL);
+}
+
 void editor_fileinfo_update (GuEditor* ec, const gchar* filename) {
 
     // directory should exist, but if not create ~/.cache/gummi:
@@ -236,6 +296,19 @@ void editor_fileinfo_update (GuEditor* ec, const gchar* filename) {
         ec->basename = g_strdup (ec->fdname);
         ec->pdffile =  g_strdup_printf ("%s.pdf", ec->fdname);
     }
+
+    gchar* jobname = g_path_get_basename (ec->pdffile);
+    jobname[strlen (jobname) - strlen (".pdf")] = 0;
+    ec->builddir = editor_staging_dir (ec);
+    ec->jobfile = g_build_filename (ec->builddir, jobname, NULL);
+    if (g_mkdir_with_parents (ec->builddir, DIR_PERMS) != 0) {
+        slog (L_ERROR, "unable to create staging directory %s\n",
+                       ec->builddir);
+    }
+    g_free (jobname);
+
+    if (ec->filename)
+        auxcache_restore (ec);
 }
 
 gboolean editor_fileinfo_update_biblio (GuEditor* ec,  const gchar* filename) {
@@ -251,58 +324,47 @@ gboolean editor_fileinfo_update_biblio (GuEditor* ec,  const gchar* filename) {
 }
 
 void editor_fileinfo_cleanup (GuEditor* ec) {
-    gchar* auxfile = NULL;
-    gchar* logfile = NULL;
-    gchar* syncfile = NULL;
-
-    if (ec->filename) {
-        gchar* dirname = g_path_get_dirname (ec->filename);
-        gchar* basename = g_path_get_basename (ec->filename);
-        auxfile = g_strdup_printf ("%s%c.%s.aux", C_TMPDIR,
-                G_DIR_SEPARATOR, basename);
-        logfile = g_strdup_printf ("%s%c.%s.log", C_TMPDIR,
-                G_DIR_SEPARATOR, basename);
-        syncfile = g_strdup_printf ("%s%c.%s.synctex.gz", C_TMPDIR,
-                G_DIR_SEPARATOR, basename);
-        g_free (basename);
-        g_free (dirname);
-    } else {
-        gchar* dirname = g_path_get_dirname (ec->workfile);
-        gchar* basename = g_path_get_basename (ec->workfile);
-        auxfile = g_strdup_printf ("%s.aux", ec->fdname);
-        logfile = g_strdup_printf ("%s.log", ec->fdname);
-        syncfile = g_strdup_printf ("%s.synctex.gz", ec->fdname);
-        g_free (basename);
-        g_free (dirname);
-    }
+    // build files go with builddir, the published pdf and SyncTeX data
+    // are next to pdffile; only texlive writes uncompressed synctex files
+    gint len = strlen (ec->pdffile) - strlen (".pdf");
+    gchar* syncfile = g_strdup_printf ("%.*s.synctex", len, ec->pdffile);
+    gchar* syncgzfile = g_strconcat (syncfile, ".gz", NULL);
 
     // TODO: make a loop or maybe make register of created files? proc?
 
+    auxcache_store (ec);
+    preformat_forget (ec, TRUE);
+
     close (ec->workfd);
     ec->workfd = -1;
 
-    g_remove (auxfile);
-    g_remove (logfile);
     g_remove (syncfile);
+    g_remove (syncgzfile);
+    utils_remove_tree (ec->builddir);
     g_remove (ec->fdname);
     g_remove (ec->workfile);
     g_remove (ec->pdffile);
     g_remove (ec->basename);
 
-    g_free (auxfile);
-    g_free (logfile);
     g_free (syncfile);
+    g_free (syncgzfile);
     g_free (ec->fdname);
     g_free (ec->filename);
     g_free (ec->workfile);
     g_free (ec->pdffile);
     g_free (ec->basename);
+    g_free (ec->builddir);
+    g_free (ec->jobfile);
+    g_free (ec->workfile_hash);
 
     ec->fdname = NULL;
     ec->filename = NULL;
     ec->workfile = NULL;
     ec->pdffile = NULL;
     ec->basename = NULL;
+    ec->builddir = NULL;
+    ec->jobfile = NULL;
+    ec->workfile_hash = NULL;
 }
 
 void editor_sourceview_config (GuEditor* ec) {
@@ -377,6 +439,74 @@ gchar* editor_grab_buffer (GuEditor* ec) {
     return pstr;
 }
 
+/**
+ * @brief Publish the buffer text for the compile thread
+ *
+ * Must be called on the main thread. The text is split into chunks of
+ * SNAPSHOT_CHUNK_LINES lines; chunks in front of the first line edited
+ * since the previous snapshot are taken over from it instead of being
+ * copied again.
+ * @return a new reference to the published snapshot
+ */
+GuSnapshot* editor_publish_snapshot (GuEditor* ec, guint64 revision) {
+    GuSnapshot* old = ec->snapshot;
+    GuSnapshot* snap = NULL;
+    GtkTextIter start, end;
+    gint reuse = 0, lines, line, i;
+
+    if (old && ec->snapshot_clean_lines == G_MAXINT) {
+        if (old->revision == revision)
+            return snapshot_ref (old);
+        snap = snapshot_retag (old, revision);
+    } else {
+        GPtrArray* chunks = g_ptr_array_new_with_free_func (
+                                (GDestroyNotify)g_bytes_unref);
+
+        if (old) {
+            reuse = MIN (ec->snapshot_clean_lines / SNAPSHOT_CHUNK_LINES,
+                         (gint)old->chunks->len);
+        }
+        for (i = 0; i < reuse; ++i) {
+            g_ptr_array_add (chunks, g_bytes_ref (old->chunks->pdata[i]));
+        }
+        lines = gtk_text_buffer_get_line_count (ec_buffer);
+        line = reuse * SNAPSHOT_CHUNK_LINES;
+        do {
+            gchar* text;
+            gtk_text_buffer_get_iter_at_line (ec_buffer, &start, line);
+            gtk_text_buffer_get_iter_at_line (ec_buffer, &end,
+                                              line + SNAPSHOT_CHUNK_LINES);
+            text = gtk_text_iter_get_text (&start, &end);
+            g_ptr_array_add (chunks, g_bytes_new_take (text, strlen (text)));
+            line += SNAPSHOT_CHUNK_LINES;
+        } while (line < lines);
+
+        snap = snapshot_new (revision, chunks);
+    }
+    ec->snapshot_clean_lines = G_MAXINT;
+
+    g_mutex_lock (&ec->snapshot_mutex);
+    ec->snapshot = snap;
+    g_mutex_unlock (&ec->snapshot_mutex);
+    snapshot_unref (old);
+
+    return snapshot_ref (snap);
+}
+
+/**
+ * @brief The last published snapshot, safe to call from any thread
+ * @return a new reference or NULL if nothing was published yet
+ */
+GuSnapshot* editor_get_snapshot (GuEditor* ec) {
+    GuSnapshot* snap = NULL;
+
+    g_mutex_lock (&ec->snapshot_mutex);
+    if (ec->snapshot)
+        snap = snapshot_ref (ec->snapshot);
+    g_mutex_unlock (&ec->snapshot_mutex);
+    return snap;
+}
+
 gboolean editor_buffer_changed (GuEditor* ec) {
     if (gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (ec->buffer))) {
         return TRUE;
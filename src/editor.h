@@ -31,12 +31,16 @@
 #ifndef __GUMMI_EDITOR_H__
 #define __GUMMI_EDITOR_H__
 
+#include "logparser.h"
 #include "motion.h"
+#include "snapshot.h"
 
 #include <glib.h>
 #include <gtk/gtk.h>
 #include <gtksourceview/gtksource.h>
 
+#include "compile/depgraph.h"
+
 #define ec_buffer GTK_TEXT_BUFFER(ec->buffer)
 #define ec_view GTK_TEXT_VIEW(ec->view)
 
@@ -49,11 +53,14 @@ struct _GuEditor {
     gchar* fdname;
     gchar* filename;
     gchar* basename;
-    gchar* pdffile;
+    gchar* pdffile;     /* published output, what the preview shows */
     gchar* workfile;
+    gchar* builddir;    /* staging directory the typesetter writes to */
+    gchar* jobfile;     /* output files in builddir, without extension */
     gchar* bibfile;
     gchar* projfile;
     time_t last_modtime;
+    gchar* workfile_hash;   /* checksum of the text last written to workfile */
 
     /* GUI related members */
     GtkSourceView* view;
@@ -72,12 +79,38 @@ struct _GuEditor {
 
     GtkTextIter last_edit;
     gboolean sync_to_last_edit;
+
+    /* Last published text, handed to the compile thread. snapshot_mutex
+     * protects the pointer, the rest is only used on the main thread */
+    GMutex snapshot_mutex;
+    GuSnapshot* snapshot;
+    gint snapshot_clean_lines;  /* leading lines untouched since then */
+
+    /* Outcome of the last compile of this editor, see latex_update_pdffile.
+     * compile_mutex is held while the typesetter runs, readers of pdffile
+     * don't need it: every finished pdf is renamed into place and counted
+     * in generation */
+    GMutex compile_mutex;
+    gint generation;
+    GuCompileJob job;
+    GuLogParser* log;
+    gchar* compilelog;
+    gboolean errors;            /* the last compile failed with output */
+    glong cstatus;              /* exit status of the last compile */
+    gint compile_ms;            /* average time successful compiles take */
+    gint modified_since_compile;    /* g_atomic_int, set on the main thread
+                                     * and cleared by compile workers */
+    gboolean force_compile;     /* run even if the input is unchanged */
+    gboolean settle_refs;       /* run again when cross references moved */
+    gchar* compiled_hash;       /* input of the last successful compile */
+    GuDepGraph* deps;           /* files the document pulls in */
 };
 
 GuEditor* editor_new (GuMotion* mc);
 void editor_fileinfo_update (GuEditor* ec, const gchar* filename);
 void editor_fileinfo_cleanup (GuEditor* ec);
 gboolean editor_fileinfo_update_biblio (GuEditor* ec,  const gchar* filename);
+gchar* editor_staging_root (void);
 void editor_destroy (GuEditor* ec);
 void editor_sourceview_config (GuEditor* ec);
 void editor_activate_spellchecking (GuEditor* ec, gboolean status);
@@ -85,6 +118,8 @@ void editor_fill_buffer (GuEditor* ec, const gchar* text);
 
 /* editor_grab_buffer will return a newly allocated string */
 gchar* editor_grab_buffer (GuEditor* ec);
+GuSnapshot* editor_publish_snapshot (GuEditor* ec, guint64 revision);
+GuSnapshot* editor_get_snapshot (GuEditor* ec);
 void editor_insert_package (GuEditor* ec, const gchar* package, const gchar* options);
 void editor_insert_bib (GuEditor* ec, const gchar* package);
 void editor_set_selection_textstyle (GuEditor* ec, const gchar* type);
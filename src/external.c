@@ -29,9 +29,35 @@
 
 #include "external.h"
 
+#include <gdk/gdk.h>
+#include <glib/gstdio.h>
+
+#include "configfile.h"
 #include "constants.h"
 #include "utils.h"
 
+/* Probing a program means looking it up on PATH and running
+ * "<program> --version", both take a while on network file systems. The
+ * outputs are cached in probes.ini in the config directory, keyed by the
+ * path the program was found at on PATH and the mtime and size of the
+ * binary. */
+typedef struct {
+    gchar* program;
+    gchar* path;        /* NULL when it is not installed, valid once located */
+    gchar* output;      /* of --version, valid once done */
+    gboolean located;
+    gboolean done;
+} ExternalProbe;
+
+static GMutex probe_mutex;
+static GCond probe_cond;
+static GHashTable* probes = NULL;
+static GKeyFile* probe_cache = NULL;
+static guint probes_running = 0;
+static guint probes_cached = 0;
+static GuProbeFunc probe_ready = NULL;
+static gpointer probe_user = NULL;
+
 /* local functions */
 static gchar* get_version_output (const gchar* command, int linenr);
 static gchar* version_latexmk (gchar* output);
@@ -42,25 +68,257 @@ static gdouble get_texlive_version (void);
 
 
 gboolean external_exists (const gchar* program) {
+    ExternalProbe* probe = NULL;
+    gboolean result = FALSE;
+
+    g_mutex_lock (&probe_mutex);
+    if (probes && (probe = g_hash_table_lookup (probes, program))) {
+        while (!probe->located)
+            g_cond_wait (&probe_cond, &probe_mutex);
+        result = (probe->path != NULL);
+    }
+    g_mutex_unlock (&probe_mutex);
+    if (probe) return result;
+
     gchar *fullpath = g_find_program_in_path (program);
     if (fullpath == NULL) return FALSE;
 
-    gboolean result = g_file_test (fullpath, G_FILE_TEST_EXISTS);
+    result = g_file_test (fullpath, G_FILE_TEST_EXISTS);
     g_free(fullpath);
     return result;
 }
 
+/**
+ * @brief The typesetter compiles go through
+ *
+ * The configured one, or pdflatex as long as that is not installed. The
+ * configuration itself is corrected on the main thread, see
+ * latex_update_pdffile.
+ */
+const gchar* external_typesetter (void) {
+    const gchar* typesetter = config_hot.typesetter;
+
+    if (!external_exists (typesetter)) return "pdflatex";
+    return typesetter;
+}
+
+static void probe_free (gpointer data) {
+    ExternalProbe* probe = data;
+
+    g_free (probe->program);
+    g_free (probe->path);
+    g_free (probe->output);
+    g_free (probe);
+}
+
+static gchar* probe_cache_file (void) {
+    gchar* confdir = C_GUMMI_CONFDIR;
+    gchar* filename = g_build_filename (confdir, "probes.ini", NULL);
+
+    g_free (confdir);
+    return filename;
+}
+
+static gboolean probe_stat (const gchar* path, gint64* mtime, gint64* size) {
+    GStatBuf st;
+
+    if (g_stat (path, &st) != 0) return FALSE;
+    *mtime = st.st_mtime;
+    *size = st.st_size;
+    return TRUE;
+}
+
+static gboolean probe_from_cache (GKeyFile* cache, ExternalProbe* probe) {
+    const gchar* group = probe->program;
+    gchar* path = g_key_file_get_string (cache, group, "path", NULL);
+    gint64 mtime = 0, size = 0;
+    gboolean valid = FALSE;
+
+    if (STR_EQU (path, probe->path) &&
+        probe_stat (probe->path, &mtime, &size) &&
+        mtime == g_key_file_get_int64 (cache, group, "mtime", NULL) &&
+        size == g_key_file_get_int64 (cache, group, "size", NULL)) {
+        probe->output = g_key_file_get_string (cache, group, "output", NULL);
+        valid = (probe->output != NULL);
+    }
+    g_free (path);
+    return valid;
+}
+
+/* Called with probe_mutex held */
+static void probe_save_cache (void) {
+    GKeyFile* cache = g_key_file_new ();
+    gchar* cachefile = probe_cache_file ();
+    GError* error = NULL;
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, probes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        ExternalProbe* probe = value;
+        gint64 mtime = 0, size = 0;
+
+        if (!probe->path || !probe->output ||
+            !probe_stat (probe->path, &mtime, &size))
+            continue;
+        g_key_file_set_string (cache, probe->program, "path", probe->path);
+        g_key_file_set_int64 (cache, probe->program, "mtime", mtime);
+        g_key_file_set_int64 (cache, probe->program, "size", size);
+        g_key_file_set_string (cache, probe->program, "output",
+                               probe->output);
+    }
+    if (!g_key_file_save_to_file (cache, cachefile, &error)) {
+        slog (L_WARNING, "Could not save %s: %s\n", cachefile,
+                         error->message);
+        g_error_free (error);
+    }
+    g_free (cachefile);
+    g_key_file_free (cache);
+}
+
+static gboolean probe_publish (gpointer user) {
+    GuProbeFunc ready = NULL;
+
+    g_mutex_lock (&probe_mutex);
+    ready = probe_ready;
+    probe_ready = NULL;
+    g_mutex_unlock (&probe_mutex);
+
+    if (ready) ready (probe_user);
+    return FALSE;
+}
+
+/* Runs on the probe thread pool */
+static void probe_run (gpointer data, gpointer user) {
+    ExternalProbe* probe = data;
+    gchar* path = g_find_program_in_path (probe->program);
+    gchar* output = NULL;
+    gboolean cached = FALSE;
+
+    g_mutex_lock (&probe_mutex);
+    probe->path = path;
+    probe->located = TRUE;
+    cached = probe->done = !path || probe_from_cache (probe_cache, probe);
+    if (cached) probes_cached++;
+    g_cond_broadcast (&probe_cond);
+    g_mutex_unlock (&probe_mutex);
+
+    if (!cached) {
+        gchar* quoted = g_shell_quote (path);
+        gchar* command = g_strdup_printf ("%s --version", quoted);
+        Tuple2 res = utils_popen_r (command, NULL);
+
+        output = (gchar*)res.second;
+        g_free (command);
+        g_free (quoted);
+    }
+
+    g_mutex_lock (&probe_mutex);
+    if (!cached) {
+        probe->output = output? output: g_strdup ("");
+        probe->done = TRUE;
+    }
+    if (--probes_running == 0) {
+        slog (L_DEBUG, "%u of %u program probes cached\n", probes_cached,
+                       g_hash_table_size (probes));
+        probe_save_cache ();
+        g_key_file_free (probe_cache);
+        probe_cache = NULL;
+        g_cond_broadcast (&probe_cond);
+        gdk_threads_add_idle (probe_publish, NULL);
+    }
+    g_mutex_unlock (&probe_mutex);
+}
+
+/**
+ * @brief Detect programs without holding up the startup
+ *
+ * Each program is looked up on PATH and, unless the cache knows it, probed
+ * in parallel on a thread pool. external_exists waits for the lookup of a
+ * program that is still being probed. ready is called on the main thread
+ * once all of them are known.
+ */
+void external_probe_start (const gchar* const* programs, GuProbeFunc ready,
+                           gpointer user) {
+    gchar* cachefile = probe_cache_file ();
+    GPtrArray* pending = g_ptr_array_new ();
+    GThreadPool* pool = NULL;
+    guint i;
+
+    g_mutex_lock (&probe_mutex);
+    probe_cache = g_key_file_new ();
+    g_key_file_load_from_file (probe_cache, cachefile, G_KEY_FILE_NONE, NULL);
+    probes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                    probe_free);
+    probe_ready = ready;
+    probe_user = user;
+
+    for (i = 0; programs[i]; ++i) {
+        ExternalProbe* probe = g_new0 (ExternalProbe, 1);
+
+        probe->program = g_strdup (programs[i]);
+        g_ptr_array_add (pending, probe);
+        g_hash_table_insert (probes, probe->program, probe);
+    }
+    probes_running = pending->len;
+    g_mutex_unlock (&probe_mutex);
+
+    if (pending->len > 0) {
+        pool = g_thread_pool_new (probe_run, NULL, pending->len, FALSE, NULL);
+        for (i = 0; i < pending->len; ++i)
+            g_thread_pool_push (pool, pending->pdata[i], NULL);
+        /* the pool goes away once the probes are done */
+        g_thread_pool_free (pool, FALSE, FALSE);
+    } else {
+        g_key_file_free (probe_cache);
+        probe_cache = NULL;
+        probe_publish (NULL);
+    }
+
+    g_ptr_array_free (pending, TRUE);
+    g_free (cachefile);
+}
+
+/**
+ * @brief Block until all probes are done, for callers without a main loop
+ */
+void external_probe_wait (void) {
+    g_mutex_lock (&probe_mutex);
+    while (probes_running > 0)
+        g_cond_wait (&probe_cond, &probe_mutex);
+    g_mutex_unlock (&probe_mutex);
+    probe_publish (NULL);
+}
+
+/* The --version output of program, from the probes if possible */
+static gchar* external_version_output (const gchar* program) {
+    ExternalProbe* probe = NULL;
+    gchar* output = NULL;
+    gboolean cached = FALSE;
+
+    g_mutex_lock (&probe_mutex);
+    if (probes && (probe = g_hash_table_lookup (probes, program)) &&
+        probe->done) {
+        output = g_strdup (probe->output);
+        cached = TRUE;
+    }
+    g_mutex_unlock (&probe_mutex);
+    if (cached) return output;
+
+    const gchar* getversion = g_strdup_printf("%s --version", program);
+    Tuple2 cmdgetv = utils_popen_r (getversion, NULL);
+    return (gchar*)cmdgetv.second;
+}
+
 gboolean external_hasflag (const gchar* program, const gchar* flag) {
     return TRUE;
 }
 
 static gchar* get_version_output (const gchar* command, int linenr) {
-    const gchar* getversion = g_strdup_printf("%s --version", command);
-    Tuple2 cmdgetv = utils_popen_r (getversion, NULL);
-    gchar* output = (gchar*)cmdgetv.second;
+    gchar* output = external_version_output (command);
     gchar* result = g_strdup ("Unknown");
 
-    if (output == NULL) {
+    if (output == NULL || STR_EQU (output, "")) {
         slog (L_ERROR, "Error detecting version for %s. "
                        "Please report a bug\n", command);
         return result;
@@ -83,9 +341,7 @@ gchar* external_version (const gchar* program) {
     gchar* version_output;
     gchar* result;
 
-    const gchar* version_cmd = g_strdup_printf("%s --version", program);
-    Tuple2 cmdgetv = utils_popen_r (version_cmd, NULL);
-    version_output = (gchar*)cmdgetv.second;
+    version_output = external_version_output (program);
 
     if (version_output == NULL || g_str_equal (version_output, "")) {
         return g_strdup_printf("Unknown, please report a bug");
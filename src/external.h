@@ -48,7 +48,14 @@ typedef enum _ExternalProg {
 } ExternalProg;
 
 
+typedef void (*GuProbeFunc) (gpointer user);
+
+void external_probe_start (const gchar* const* programs, GuProbeFunc ready,
+                           gpointer user);
+void external_probe_wait (void);
+
 gboolean external_exists (const gchar* program);
+const gchar* external_typesetter (void);
 gboolean external_hasflag (const gchar* program, const gchar* flag);
 
 gchar* external_version (const gchar* program);
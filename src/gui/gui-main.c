@@ -282,8 +282,7 @@ void on_menu_autosync_toggled (GtkCheckMenuItem *menu_autosync, void* user) {
 G_MODULE_EXPORT
 void on_tab_notebook_switch_page (GtkNotebook *notebook, GtkWidget *nbpage, int pagenr, void *data) {
     slog (L_DEBUG, "Switched to environment at page %d\n", pagenr);
-    /* Kill typesetter command */
-    motion_kill_typesetter(gummi->motion);
+    /* A compile of the previous tab goes on in the background */
 
     /* set the active tab/editor pointers */
     tabmanager_set_active_tab (pagenr);
@@ -294,7 +293,7 @@ void on_tab_notebook_switch_page (GtkNotebook *notebook, GtkWidget *nbpage, int
     /* clear the build log output window */
     gui_buildlog_set_text ("");
 
-    previewgui_reset (gui->previewgui);
+    tabmanager_show_preview ();
 }
 
 G_MODULE_EXPORT
@@ -607,38 +606,18 @@ void on_button_biblio_compile_clicked (GtkWidget* widget, void* user) {
 
 G_MODULE_EXPORT
 void on_button_biblio_detect_clicked (GtkWidget* widget, void* user) {
-    gchar* text = 0;
-    gchar* str = 0;
-    gchar* basename = 0;
-    GError* err = NULL;
-    gint number = 0;
-
     gummi->biblio->progressval = 0.0;
     g_timeout_add (2, on_bibprogressbar_update, widget);
     gtk_list_store_clear (gummi->biblio->list_biblios);
 
     if (biblio_detect_bibliography (g_active_editor)) {
         editor_insert_bib (g_active_editor, g_active_editor->bibfile);
-        if (!g_file_get_contents(g_active_editor->bibfile, &text, NULL, &err)) {
-            slog (L_G_ERROR, "g_file_get_contents (): %s\n", err->message);
-            g_error_free (err);
-            return;
-        }
-
-        gtk_widget_set_sensitive
-                    (GTK_WIDGET(gummi->biblio->list_filter), TRUE);
-
-        number = biblio_parse_entries (gummi->biblio, text);
-        basename = g_path_get_basename (g_active_editor->bibfile);
-        gtk_label_set_text (gummi->biblio->filenm_label, basename);
-        str = g_strdup_printf ("%d", number);
-        gtk_label_set_text (gummi->biblio->refnr_label, str);
-        g_free (str);
-        // NOTE gtk3s bar doesn't place text inside the widget anymore :/
-        //gtk_progress_bar_set_text (gummi->biblio->progressbar, str);
-        g_free (basename);
+        gtk_label_set_text (gummi->biblio->refnr_label, "...");
+        biblio_load_entries (gummi->biblio, g_active_editor->bibfile);
     }
     else {
+        /* a load that is still running must not bring the list back */
+        ++gummi->biblio->generation;
         gtk_widget_set_sensitive
                     (GTK_WIDGET(gummi->biblio->list_filter), FALSE);
         statusbar_set_message
@@ -667,39 +646,9 @@ void on_bibreference_clicked (GtkTreeView* view, GtkTreePath* Path,
     g_free (out);
 }
 
-static gboolean visible_func (GtkTreeModel *model, GtkTreeIter  *iter, gpointer data) {
-    gboolean row_visible = FALSE;
-    gchar* title;
-    gchar* author;
-    gchar* year;
-
-    /* make all entries visible again when filter buffer is empty */
-    if (strlen(data) == 0) return TRUE;
-
-    gtk_tree_model_get (model, iter, 1, &title, 2, &author, 3, &year, -1);
-    if (utils_subinstr (data, title , TRUE)) row_visible = TRUE;
-    if (utils_subinstr (data, author , TRUE)) row_visible = TRUE;
-    if (utils_subinstr (data, year , TRUE)) row_visible = TRUE;
-
-    g_free(title);
-    g_free(author);
-    g_free(year);
-
-    return row_visible;
-}
-
 G_MODULE_EXPORT
 void on_biblio_filter_changed (GtkWidget* widget, void* user) {
-    GtkTreeModel *filter;
-
-    const gchar *entry = gtk_entry_get_text(GTK_ENTRY(widget));
-    filter = gtk_tree_model_filter_new (
-            GTK_TREE_MODEL(gummi->biblio->list_biblios),NULL);
-    gtk_tree_model_filter_set_visible_func(
-            GTK_TREE_MODEL_FILTER(filter), visible_func, (gpointer)entry, NULL);
-    gtk_tree_view_set_model (
-            GTK_TREE_VIEW( gummi->biblio->biblio_treeview ),filter);
-    g_object_unref (G_OBJECT(filter));
+    biblio_set_filter (gummi->biblio, gtk_entry_get_text (GTK_ENTRY (widget)));
 }
 
 void typesetter_setup (void) {
@@ -998,7 +947,8 @@ void check_preview_timer (void) {
     g_return_if_fail (g_active_tab != NULL);
 
     gtk_text_buffer_set_modified (g_e_buffer, TRUE);
-    gummi->latex->modified_since_compile = TRUE;
+    g_atomic_int_set (&g_active_editor->modified_since_compile, TRUE);
+    motion_new_revision (gummi->motion);
 
     gui_set_filename_display (g_active_tab, TRUE, TRUE);
 
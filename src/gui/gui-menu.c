@@ -160,9 +160,6 @@ void on_menu_close_activate (GtkWidget *widget, void* user) {
     else if (GTK_RESPONSE_CANCEL == ret || GTK_RESPONSE_DELETE_EVENT == ret)
         return;
 
-    // kill typesetter thread
-    motion_kill_typesetter(gummi->motion);
-
     // remove tab:
     gint remaining_tabs = tabmanager_remove_tab (tab);
     if (remaining_tabs == 0) {
@@ -368,8 +365,7 @@ void on_menu_findprev_activate (GtkWidget *widget, void *user) {
 
 G_MODULE_EXPORT
 void on_menu_pdfcompile_activate (GtkWidget *widget, void* user) {
-    gummi->latex->modified_since_compile = TRUE;
-    motion_do_compile (gummi->motion);
+    motion_force_compile (gummi->motion);
 }
 
 G_MODULE_EXPORT
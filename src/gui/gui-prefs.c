@@ -202,6 +202,14 @@ void prefsgui_main (GuPrefsGui* prefs, int page) {
     gtk_widget_show_all (GTK_WIDGET (prefs->prefwindow));
 }
 
+/**
+ * @brief Typesetter detection finished, update the dialog if it is open
+ */
+void prefsgui_update_typesetters (GuPrefsGui* prefs) {
+    if (gtk_widget_get_visible (GTK_WIDGET (prefs->prefwindow)))
+        set_tab_compilation_settings (prefs);
+}
+
 static void set_all_tab_settings (GuPrefsGui* prefs) {
     set_tab_view_settings (prefs);
     set_tab_editor_settings (prefs);
@@ -657,8 +665,6 @@ G_MODULE_EXPORT
 void on_cache_size_value_changed (GtkWidget* widget, void* user) {
     gint newval = gtk_spin_button_get_value (GTK_SPIN_BUTTON (widget));
     config_set_integer ("Preview", "cache_size", newval);
-
-    g_idle_add((GSourceFunc) run_garbage_collector, gui->previewgui);
 }
 
 G_MODULE_EXPORT
@@ -33,37 +33,28 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <fcntl.h>
+
 #include <cairo.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gdk/gdk.h>
 #include <gtk/gtk.h>
 #include <math.h>
 #include <poppler.h>
 
-#ifdef WIN32
-  #include "syncTeX/synctex_parser.h"
-#else
-  #include <synctex_parser.h>
-#endif
-
 #include "configfile.h"
 #include "constants.h"
 #include "environment.h"
 #include "motion.h"
+#include "pagediff.h"
+#include "syncindex.h"
 #include "gui/gui-main.h"
 
 #ifdef HAVE_CONFIG_H
 #   include "config.h"
 #endif
 
-// compatibility fixes for libsynctex (>=1.16 && <=2.00):
-#ifdef USE_SYNCTEX1
-  typedef synctex_scanner_t synctex_scanner_p;
-  typedef synctex_node_t synctex_node_p;
-  #define synctex_display_query(scanner, file, line, column, page) synctex_display_query(scanner, file, line, column)
-  #define synctex_scanner_next_result(scanner) synctex_next_result(scanner)
-#endif
-
 #define page_inner(pc,i) (((pc)->pages + (i))->inner)
 #define page_outer(pc,i) (((pc)->pages + (i))->outer)
 
@@ -85,6 +76,9 @@ enum {
 static gfloat list_sizes[] = {-1, -1, 0.50, 0.70, 0.85, 1.0, 1.25, 1.5, 2.0,
                               3.0, 4.0};
 
+// Renderings are keyed by revision, every changed page gets a new one
+static guint document_revision = 0;
+
 extern Gummi* gummi;
 extern GummiGui* gui;
 
@@ -136,11 +130,19 @@ static gboolean on_button_pressed (GtkWidget* w, GdkEventButton* e, void* user);
 static gint page_offset_x (GuPreviewGui* pc, gint page, gdouble x);
 static gint page_offset_y (GuPreviewGui* pc, gint page, gdouble y);
 static void paint_page (cairo_t *cr, GuPreviewGui* pc, gint page, gint x, gint y);
-static cairo_surface_t* get_page_rendering (GuPreviewGui* pc, int page);
-static gboolean remove_page_rendering (GuPreviewGui* pc, gint page);
+static void paint_page_tiles (cairo_t *cr, GuPreviewGui* pc, gint page, gint x, gint y);
+static void prefetch_page_tiles (GuPreviewGui* pc, gint page, gboolean from_top);
+static void on_tile_rendered (GuRenderJob* job, gpointer user);
+static GuRenderKey tile_key (GuPreviewGui* pc, gint page, gint tx, gint ty);
 
 // Functions for syncronizing editor and preview via SyncTeX
+static gboolean synctex_sync_to (GuPreviewGui* pc, GtkTextIter *sync_to, gchar* tex_file);
 static gboolean synctex_run_parser (GuPreviewGui* pc, GtkTextIter *sync_to, gchar* tex_file);
+static void synctex_reverse_sync (GuPreviewGui* pc, gint page, gdouble x, gdouble y);
+static void synctex_open_source (const gchar* file, gint line);
+static void on_syncindex_ready (GuSyncIndex* si, gpointer user);
+static void on_cache_size_changed (const gchar* group, const gchar* key,
+                                   gpointer user);
 static void synctex_filter_results (GuPreviewGui* pc, GtkTextIter *sync_to);
 static void synctex_scroll_to_node (GuPreviewGui* pc, SyncNode* node);
 static SyncNode* synctex_one_node_found (GuPreviewGui* pc);
@@ -191,6 +193,16 @@ GuPreviewGui* previewgui_init (GtkBuilder * builder) {
     p->doc = NULL;
     p->preview_on_idle = FALSE;
     p->errormode = FALSE;
+
+    p->rendercache = rendercache_new (
+                (gsize)config_hot.cache_size * 1024 * 1024);
+    p->prefetch_depth = MAX (config_get_integer ("Preview", "prefetch"), 0);
+    p->max_parked = MAX (config_get_integer ("Preview", "parked_documents"), 0);
+    p->renderpool = renderpool_new (
+                            config_get_integer ("Preview", "render_threads"),
+                            on_tile_rendered, p);
+    p->sync = syncindex_new (on_syncindex_ready, p);
+    config_notify_add ("Preview", "cache_size", on_cache_size_changed, p);
     
     p->hadj = gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (p->scrollw));
     p->vadj = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (p->scrollw));
@@ -534,17 +546,46 @@ void previewgui_stop_errormode (GuPreviewGui *pc) {
     pc->errormode = FALSE;
 }
 
+/* Errors are tagged in every tab that shows the file they occurred in, that
+ * is the tab that was compiled and the tabs of files it includes. Tabs that
+ * are compiled on their own keep the errors of their own compile. */
+static void apply_errortags (gpointer data, gpointer user) {
+    GuEditor* editor = GU_EDITOR(data);
+    GuEditor* compiled = GU_EDITOR(user);
+    GuLogParser* log = compiled->log;
+
+    if (editor != compiled && editor->compilelog) return;
+
+    gint* lines = logparser_get_lines (log, editor->workfile, LOG_ERROR);
+
+    if (lines[0] == 0 && editor->filename) {
+        g_free (lines);
+        lines = logparser_get_lines (log, editor->filename, LOG_ERROR);
+    }
+    editor_apply_errortags (editor, lines);
+    g_free (lines);
+}
+
+gboolean on_document_error_found (gpointer data) {
+    // The tab may have been closed in the meantime
+    if (tabmanager_has_editor (GU_EDITOR (data)))
+        tabmanager_foreach_editor (apply_errortags, data);
+    return FALSE;
+}
+
 gboolean on_document_compiled (gpointer data) {
     GuPreviewGui* pc = gui->previewgui;
     GuEditor* editor = GU_EDITOR(data);
-    GuLatex* latex = gummi_get_latex();
 
-    // Make sure the editor still exists after compile
+    if (!tabmanager_has_editor (editor)) return FALSE;
+
+    tabmanager_foreach_editor (apply_errortags, editor);
+
+    // Background tabs only keep their pdf ready for when they are shown
     if (editor == gummi_get_active_editor()) {
-        editor_apply_errortags (editor, latex->errorlines);
-        gui_buildlog_set_text (latex->compilelog);
+        gui_buildlog_set_text (editor->compilelog);
 
-        if (latex->errorlines[0]) {
+        if (editor->errors) {
             previewgui_start_errormode (pc, "compile_error");
         } else {
             if (!pc->uri) {
@@ -563,6 +604,7 @@ gboolean on_document_compiled (gpointer data) {
             }
             if (pc->errormode) previewgui_stop_errormode (pc);
         }
+        motion_queue_background (gummi->motion);
     }
     return FALSE;
 }
@@ -727,33 +769,57 @@ inline static gdouble get_page_width(GuPreviewGui* pc, int page) {
     return (pc->pages + page)->width;
 }
 
-static void previewgui_invalidate_renderings(GuPreviewGui* pc) {
-    //L_F_DEBUG;
+static gboolean render_key_outdated (const GuRenderKey* key, gpointer user) {
+    return !g_hash_table_contains ((GHashTable*)user,
+                                   GUINT_TO_POINTER (key->revision));
+}
 
-    int i;
-    for (i = 0; i < pc->n_pages; i++) {
-        remove_page_rendering(pc, i);
+static void add_live_revisions (GHashTable* live, GuPreviewPage* pages,
+                                gint n_pages) {
+    gint i;
+    for (i = 0; i < n_pages; i++) {
+        g_hash_table_add (live, GUINT_TO_POINTER (pages[i].revision));
     }
+}
+
+/* Revisions are unique across documents, so the renderings of the parked
+ * sessions are told apart from those of changed or closed pages by them */
+static guint drop_outdated_renderings (GuPreviewGui* pc) {
+    GHashTable* live = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GList* link = NULL;
+    guint n = 0;
 
-    if (pc->cache_size != 0) {
-        slog(L_ERROR, "Cleared all page renderings, but cache not empty. "
-                "Cache size is %iB.\n", pc->cache_size);
+    add_live_revisions (live, pc->pages, pc->n_pages);
+    for (link = pc->sessions; link; link = link->next) {
+        GuPreviewSession* s = GU_PREVIEW_SESSION (link->data);
+        add_live_revisions (live, s->pages, s->n_pages);
     }
 
+    n = rendercache_remove_matching (pc->rendercache, render_key_outdated,
+                                     live);
+    g_hash_table_destroy (live);
+    return n;
 }
 
-static gboolean remove_page_rendering(GuPreviewGui* pc, gint page) {
-    if ((pc->pages + page)->rendering == NULL) {
-        return FALSE;
-    }
+static void previewgui_invalidate_renderings(GuPreviewGui* pc) {
     //L_F_DEBUG;
 
-    cairo_surface_destroy((pc->pages + page)->rendering);
-    (pc->pages + page)->rendering = NULL;
-    pc->cache_size -= page_inner(pc, page).width *
-            page_inner(pc, page).height * BYTES_PER_PIXEL;
+    guint n = drop_outdated_renderings (pc);
+    renderpool_invalidate (pc->renderpool);
 
-    return TRUE;
+    slog(L_DEBUG, "Dropped %u renderings of changed pages.\n", n);
+    rendercache_log_stats (pc->rendercache);
+}
+
+static GuRenderKey tile_key (GuPreviewGui* pc, gint page, gint tx, gint ty) {
+    GuRenderKey key;
+
+    key.page = page;
+    key.tile_x = tx;
+    key.tile_y = ty;
+    key.scale = (tx < 0) ? PLACEHOLDER_SCALE : pc->scale;
+    key.revision = pc->pages[page].revision;
+    return key;
 }
 
 static void update_drawarea_size(GuPreviewGui *pc) {
@@ -870,9 +936,10 @@ static void previewgui_set_scale(GuPreviewGui* pc, gdouble scale, gdouble x,
     gdouble old_y = (gtk_adjustment_get_value(pc->vadj) + y) /
             (pc->height_scaled + 2*get_document_margin(pc));
 
-    // We have to do this before changing the scale, as otherwise the cache
-    // size would be calcualted wrong!
-    previewgui_invalidate_renderings(pc);
+    // Renderings of the previous scales are kept in the cache, only the
+    // queued jobs for the old scale are useless now
+    renderpool_invalidate (pc->renderpool);
+    rendercache_use_scale (pc->rendercache, scale);
 
     pc->scale = scale;
 
@@ -903,55 +970,167 @@ static void previewgui_set_scale(GuPreviewGui* pc, gdouble scale, gdouble x,
     gtk_widget_queue_draw (pc->drawarea);
 }
 
+typedef struct {
+    GuPreviewGui* pc;
+    guint serial;
+    gint fd;
+    gchar* filename;
+    gint n_pages;
+    guint64* signatures;
+    gboolean ok;
+} PageScan;
+
+/* Gives a page of the loaded document a new revision, its renderings and
+ * words are of an earlier version */
+static void renew_page (GuPreviewGui* pc, gint i) {
+    GuPreviewPage *page = pc->pages + i;
+    PopplerPage *poppler = poppler_document_get_page (pc->doc, i);
+
+    page->revision = ++document_revision;
+    poppler_page_get_size (poppler, &(page->width), &(page->height));
+    g_object_unref (poppler);
+
+    if (page->words) {
+        g_hash_table_destroy (page->words);
+        page->words = NULL;
+    }
+}
+
+/* Pages whose content did not change keep their size and renderings, the
+ * others among the unscanned ones are renewed. signatures is NULL when the
+ * pages could not be compared */
+static void apply_page_signatures (GuPreviewGui* pc,
+                                   const guint64* signatures) {
+    gint kept = pc->pages_unscanned;
+    gint changed = 0;
+    gint i;
+
+    for (i = 0; i < pc->n_pages; i++) {
+        GuPreviewPage *page = pc->pages + i;
+
+        if (i < kept && (!signatures || page->signature != signatures[i])) {
+            renew_page (pc, i);
+            changed++;
+        }
+        page->signature = signatures? signatures[i]: 0;
+    }
+    pc->pages_signed = (signatures != NULL);
+    pc->pages_unscanned = 0;
+    ++pc->scan_serial;
+
+    slog (L_DEBUG, "%d of %d pages unchanged since the last load\n",
+                   kept - changed, pc->n_pages);
+
+    if (changed) {
+        previewgui_invalidate_renderings (pc);
+        update_page_sizes (pc);
+        update_page_positions (pc);
+        gtk_widget_queue_draw (pc->drawarea);
+    }
+}
+
+static gboolean on_pages_scanned (gpointer data) {
+    PageScan* scan = data;
+    GuPreviewGui* pc = scan->pc;
+
+    // The pages were replaced or parked in the meantime
+    if (scan->serial == pc->scan_serial && scan->n_pages == pc->n_pages)
+        apply_page_signatures (pc, scan->ok? scan->signatures: NULL);
+
+    g_free (scan->filename);
+    g_free (scan->signatures);
+    g_free (scan);
+    return FALSE;
+}
+
+static gpointer page_scan_thread (gpointer data) {
+    PageScan* scan = data;
+
+    scan->ok = pagediff_scan (scan->fd, scan->filename, scan->n_pages,
+                              scan->signatures);
+    g_close (scan->fd, NULL);
+
+    gdk_threads_add_idle (on_pages_scanned, scan);
+    return NULL;
+}
+
+/* Reading and hashing the whole file takes too long for the main thread.
+ * It is opened here so that the scan sees the file poppler has loaded even
+ * if a compile publishes the next one meanwhile */
+static void scan_pages (GuPreviewGui* pc) {
+    PageScan* scan = NULL;
+    gchar* filename = g_filename_from_uri (pc->uri, NULL, NULL);
+    gint fd = filename? g_open (filename, O_RDONLY, 0): -1;
+
+    if (fd < 0) {
+        g_free (filename);
+        apply_page_signatures (pc, NULL);
+        return;
+    }
+
+    scan = g_new0 (PageScan, 1);
+    scan->pc = pc;
+    scan->serial = pc->scan_serial;
+    scan->fd = fd;
+    scan->filename = filename;
+    scan->n_pages = pc->n_pages;
+    scan->signatures = g_new0 (guint64, pc->n_pages);
+
+    g_thread_unref (g_thread_new ("pagediff", page_scan_thread, scan));
+}
+
 static void load_document(GuPreviewGui* pc, gboolean update) {
     //L_F_DEBUG;
 
-    previewgui_invalidate_renderings(pc);
-    g_free(pc->pages);
+    GuPreviewPage *old_pages = pc->pages;
+    gint old_n_pages = pc->n_pages;
+    gint kept = 0;
 
     pc->n_pages = poppler_document_get_n_pages (pc->doc);
     gtk_label_set_text (GTK_LABEL (pc->page_label),
             g_strdup_printf (_("of %d"), pc->n_pages));
 
     pc->pages = g_new0(GuPreviewPage, pc->n_pages);
+    renderpool_set_document (pc->renderpool, pc->uri);
+
+    // Until the scan tells which of them changed, pages that were signed
+    // before are shown with their old size and renderings
+    if (pc->pages_signed) kept = MIN (old_n_pages, pc->n_pages);
 
     int i;
     for (i=0; i < pc->n_pages; i++) {
-        PopplerPage *poppler = poppler_document_get_page(pc->doc, i);
-
         GuPreviewPage *page = pc->pages + i;
-        poppler_page_get_size(poppler, &(page->width), &(page->height));
-        g_object_unref(poppler);
-        poppler = NULL;
-    }
 
-    update_page_sizes(pc);
-    update_prev_next_page(pc);
-}
-
-void previewgui_set_pdffile (GuPreviewGui* pc, const gchar *uri) {
-    //L_F_DEBUG;
-    GError *error = NULL;
-
-    previewgui_cleanup_fds (pc);
-
-    pc->uri = g_strdup(uri);
-    pc->doc = poppler_document_new_from_file (pc->uri, NULL, &error);
+        if (i < kept) {
+            page->width = old_pages[i].width;
+            page->height = old_pages[i].height;
+            page->revision = old_pages[i].revision;
+            page->signature = old_pages[i].signature;
+            page->words = old_pages[i].words;
+            old_pages[i].words = NULL;
+            continue;
+        }
+        renew_page (pc, i);
+    }
 
-    if (pc->doc == NULL) {
-        statusbar_set_message(error->message);
-        return;
+    for (i=0; i < old_n_pages; i++) {
+        if (old_pages[i].words) g_hash_table_destroy (old_pages[i].words);
     }
+    g_free (old_pages);
 
-    load_document(pc, FALSE);
+    pc->pages_signed = FALSE;
+    pc->pages_unscanned = kept;
+    ++pc->scan_serial;
+    scan_pages (pc);
 
-    // This is mainly for debugging - to make sure the boxes in the preview disappear.
-    synctex_clear_sync_nodes(pc);
+    previewgui_invalidate_renderings(pc);
 
-    // Restore scrollbar positions:
-    previewgui_restore_position (pc);
+    update_page_sizes(pc);
+    update_prev_next_page(pc);
+}
 
-    // Restore scale and fit mode
+/* Brings back the scale and fit mode of the active tab */
+static void restore_zoom (GuPreviewGui* pc) {
     if (!g_active_tab->fit_mode) {
 
         const gchar* conf_zoom = config_get_string ("Preview", "zoom_mode");
@@ -1016,6 +1195,42 @@ void previewgui_set_pdffile (GuPreviewGui* pc, const gchar *uri) {
     }
 
     g_signal_handler_unblock(pc->combo_sizes, pc->combo_sizes_changed_handler);
+}
+
+void previewgui_set_pdffile (GuPreviewGui* pc, const gchar *uri) {
+    //L_F_DEBUG;
+    GuEditor* editor = gummi_get_active_editor ();
+    GError *error = NULL;
+
+    previewgui_cleanup_fds (pc);
+
+    // Read before opening, a publish in between only costs a reload
+    pc->generation = editor? g_atomic_int_get (&editor->generation): 0;
+    pc->uri = g_strdup(uri);
+    pc->doc = poppler_document_new_from_file (pc->uri, NULL, &error);
+
+    if (pc->doc == NULL) {
+        statusbar_set_message(error->message);
+        return;
+    }
+
+    load_document(pc, FALSE);
+
+    // This is mainly for debugging - to make sure the boxes in the preview disappear.
+    synctex_clear_sync_nodes(pc);
+
+    // Get the SyncTeX index parsing while the user is still looking around
+    if (config_hot.synctex) {
+        gchar* pdffile = g_filename_from_uri (pc->uri, NULL, NULL);
+        syncindex_update (pc->sync, pdffile);
+        g_free (pdffile);
+    }
+
+    // Restore scrollbar positions:
+    previewgui_restore_position (pc);
+
+    // Restore scale and fit mode
+    restore_zoom (pc);
 
     gtk_widget_queue_draw (pc->drawarea);
 
@@ -1024,32 +1239,71 @@ void previewgui_set_pdffile (GuPreviewGui* pc, const gchar *uri) {
 
 void previewgui_refresh (GuPreviewGui* pc, GtkTextIter *sync_to, gchar* tex_file) {
     //L_F_DEBUG;
-    // We lock the mutex to prevent previewing incomplete PDF file, i.e
-    // compiling. Also prevent PDF from changing (compiling) when previewing */
-    if (!g_mutex_trylock (&gummi->motion->compile_mutex)) return;
+    GuEditor* editor = gummi_get_active_editor ();
+    gint generation = 0;
+
+    // Compiles publish the pdf by renaming it over pc->uri when it is
+    // complete, no need to wait for them. Whatever is there can be loaded
+    if (!editor) return;
 
     // This line is very important, if no pdf exist, preview will fail */
-    if (!pc->uri || !utils_uri_path_exists (pc->uri)) goto unlock;
+    if (!pc->uri || !utils_uri_path_exists (pc->uri)) return;
 
     // If no document had been loaded successfully before, force call of set_pdffile
     if (pc->doc == NULL) {
         previewgui_set_pdffile (pc, pc->uri);
-        goto unlock;
+        return;
     }
 
-    previewgui_cleanup_fds (pc);
+    // Compiles with unchanged input publish nothing, keep what is loaded
+    generation = g_atomic_int_get (&editor->generation);
+    if (generation != pc->generation) {
+        previewgui_cleanup_fds (pc);
 
-    pc->doc = poppler_document_new_from_file (pc->uri, NULL, NULL);
+        pc->generation = generation;
+        pc->doc = poppler_document_new_from_file (pc->uri, NULL, NULL);
 
-    /* release mutex and return when poppler doc is damaged or missing */
-    if (pc->doc == NULL) goto unlock;
+        /* return when poppler doc is damaged or missing */
+        if (pc->doc == NULL) return;
 
-    load_document(pc, TRUE);
-    update_page_positions(pc);
+        load_document(pc, TRUE);
+        update_page_positions(pc);
+    }
+
+    // The index is parsed in the background after every compile, syncing
+    // waits for it in that case
+    gboolean synced = FALSE;
+    if (config_hot.synctex) {
+        gchar* pdffile = g_filename_from_uri (pc->uri, NULL, NULL);
+        gboolean current = syncindex_update (pc->sync, pdffile);
+        g_free (pdffile);
+
+        if (config_hot.autosync) {
+            if (current) {
+                synced = synctex_sync_to (pc, sync_to, tex_file);
+            } else {
+                pc->sync_pending = (sync_to != NULL && tex_file != NULL);
+            }
+        }
+    }
+
+    if (!synced) {
+
+        // This is mainly for debugging - to make sure the boxes in the preview disappear.
+        synctex_clear_sync_nodes(pc);
+
+        if (pc->current_page >= pc->n_pages) {
+            previewgui_goto_page (pc, pc->n_pages-1);
+        }
+
+    }
+
+    gtk_widget_queue_draw (pc->drawarea);
+}
 
-    if (config_get_boolean ("Compile", "synctex") &&
-        config_get_boolean ("Preview", "autosync") &&
-        synctex_run_parser(pc, sync_to, tex_file)) {
+static gboolean synctex_sync_to (GuPreviewGui* pc, GtkTextIter *sync_to, gchar* tex_file) {
+
+    if (synctex_run_parser(pc, sync_to, tex_file)) {
 
         SyncNode *node;
         if (synctex_one_node_found(pc) == NULL) {
@@ -1070,22 +1324,85 @@ void previewgui_refresh (GuPreviewGui* pc, GtkTextIter *sync_to, gchar* tex_file
         if ((node = synctex_one_node_found(pc)) != NULL) {
             synctex_scroll_to_node(pc, node);
         }
+        return TRUE;
+    }
+    return FALSE;
+}
 
-    } else {
+static void on_syncindex_ready (GuSyncIndex* si, gpointer user) {
+    GuPreviewGui* pc = GU_PREVIEW_GUI (user);
+    GuEditor* editor = gummi_get_active_editor ();
 
-        // This is mainly for debugging - to make sure the boxes in the preview disappear.
-        synctex_clear_sync_nodes(pc);
+    // The index of a parked session, kept for when its tab comes back
+    if (si != pc->sync) return;
 
-        if (pc->current_page >= pc->n_pages) {
-            previewgui_goto_page (pc, pc->n_pages-1);
-        }
+    if (pc->reverse_pending) {
+        pc->reverse_pending = FALSE;
+        synctex_reverse_sync (pc, pc->reverse_page,
+                              pc->reverse_x, pc->reverse_y);
+    }
+
+    if (!pc->sync_pending) return;
+    pc->sync_pending = FALSE;
 
+    if (pc->doc && editor && editor->sync_to_last_edit &&
+        synctex_sync_to (pc, &editor->last_edit, editor->workfile)) {
+        gtk_widget_queue_draw (pc->drawarea);
     }
+}
 
-    gtk_widget_queue_draw (pc->drawarea);
+static void synctex_reverse_sync (GuPreviewGui* pc, gint page, gdouble x, gdouble y) {
+    gint64 start = g_get_monotonic_time ();
+    gchar* pdffile = NULL;
+    gchar* file = NULL;
+    gint line = 0;
 
-unlock:
-    g_mutex_unlock (&gummi->motion->compile_mutex);
+    if (!pc->uri) return;
+
+    pdffile = g_filename_from_uri (pc->uri, NULL, NULL);
+    if (!syncindex_update (pc->sync, pdffile)) {
+        // The click refers to the pdf on screen, finish it as soon as the
+        // index caught up with that pdf
+        pc->reverse_pending = (pc->sync->pending_mtime != 0);
+        pc->reverse_page = page;
+        pc->reverse_x = x;
+        pc->reverse_y = y;
+        g_free (pdffile);
+        return;
+    }
+    g_free (pdffile);
+
+    if (syncindex_reverse (pc->sync, page, x, y, &file, &line)) {
+        synctex_open_source (file, line);
+        slog(L_DEBUG, "Reverse sync to \"%s\", line %i took %.2f ms\n", file,
+             line, (g_get_monotonic_time () - start) / 1000.0);
+        g_free (file);
+    }
+}
+
+static void synctex_open_source (const gchar* file, gint line) {
+    GuEditor* active = gummi_get_active_editor ();
+    GuEditor* editor = NULL;
+    gchar* path = NULL;
+
+    // SyncTeX keeps file names the way the typesetter opened them, relative
+    // names start at the directory of the workfile it was run in
+    if (g_path_is_absolute (file) || active == NULL) {
+        path = g_strdup (file);
+    } else {
+        gchar* dirname = g_path_get_dirname (active->workfile);
+        path = g_build_filename (dirname,
+                    g_str_has_prefix (file, "./")? file + 2: file, NULL);
+        g_free (dirname);
+    }
+
+    if ((editor = tabmanager_activate_file (path)) != NULL) {
+        editor_scroll_to_line (editor, line-1);
+    } else {
+        slog(L_WARNING, "Source file %s of the clicked position not found\n",
+             path);
+    }
+    g_free (path);
 }
 
 static gboolean synctex_run_parser(GuPreviewGui* pc, GtkTextIter *sync_to, gchar* tex_file) {
@@ -1099,33 +1416,103 @@ static gboolean synctex_run_parser(GuPreviewGui* pc, GtkTextIter *sync_to, gchar
     gint column = gtk_text_iter_get_line_offset(sync_to);
     slog(L_DEBUG, "Syncing to %s, line %i, column %i\n", tex_file, line, column);
 
-    synctex_scanner_p sync_scanner = synctex_scanner_new_with_output_file(pc->uri, C_TMPDIR, 1);
+    GArray* boxes = syncindex_forward (pc->sync, tex_file, line, column);
+    guint i = 0;
 
     synctex_clear_sync_nodes(pc);
 
-    if (synctex_display_query (sync_scanner, tex_file, line, column, -1) > 0) {
-        synctex_node_p node;
+    if (boxes == NULL) {
+        return FALSE;
+    }
 
-        // SyncTeX can return several nodes. It seems best to use the last one
-        // as this one rarely is below (usually slightly above) the edited line
-        while ((node = synctex_scanner_next_result(sync_scanner))) {
+    for (i = 0; i < boxes->len; ++i) {
+        GuSyncBox* box = &g_array_index (boxes, GuSyncBox, i);
+        SyncNode *sn = g_new0(SyncNode, 1);
 
-            SyncNode *sn = g_new0(SyncNode, 1);
+        sn->page = box->page;
+        sn->x = box->x;
+        sn->y = box->y;
+        sn->width = box->width;
+        sn->height = box->height;
 
-            sn->page = synctex_node_page(node) - 1; // syncTeX counts from 1, but poppler from 0
-            sn->x = synctex_node_box_visible_h(node);
-            sn->y = synctex_node_box_visible_v(node);
-            sn->width = synctex_node_box_visible_width(node);
-            sn->height = synctex_node_box_visible_height(node);
-            sn->y -= sn->height;    // We want y to be the upper value
+        pc->sync_nodes = g_slist_append(pc->sync_nodes, sn);
+    }
 
-            pc->sync_nodes = g_slist_append(pc->sync_nodes, sn);
+    g_array_free (boxes, TRUE);
+    return TRUE;
+}
 
+// Words of a page mapped to the boxes they occupy. Built on first use
+// from the text layout, and kept for as long as the page keeps its revision
+static GHashTable* page_get_words (GuPreviewGui* pc, gint page) {
+    GuPreviewPage *p = pc->pages + page;
+    PopplerRectangle *rects = NULL;
+    guint n_rects = 0;
+
+    if (p->words) return p->words;
+
+    p->words = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify)g_array_unref);
+
+    PopplerPage *ppage = poppler_document_get_page (pc->doc, page);
+    gchar *text = poppler_page_get_text (ppage);
+
+    // The layout holds one rectangle per character of the page text
+    if (text && poppler_page_get_text_layout (ppage, &rects, &n_rects)) {
+        const gchar *c = text;
+        const gchar *start = NULL;
+        PopplerRectangle box = { 0, 0, 0, 0 };
+        guint i = 0;
+
+        for (i = 0; ; c = g_utf8_next_char (c), i++) {
+            gboolean alnum = *c && i < n_rects &&
+                             g_unichar_isalnum (g_utf8_get_char (c));
+            if (alnum && start == NULL) {
+                start = c;
+                box = rects[i];
+            } else if (alnum) {
+                box.x1 = MIN (box.x1, rects[i].x1);
+                box.y1 = MIN (box.y1, rects[i].y1);
+                box.x2 = MAX (box.x2, rects[i].x2);
+                box.y2 = MAX (box.y2, rects[i].y2);
+            } else if (start != NULL) {
+                gchar *word = g_strndup (start, c - start);
+                GArray *boxes = g_hash_table_lookup (p->words, word);
+                if (boxes == NULL) {
+                    boxes = g_array_new (FALSE, FALSE, sizeof (PopplerRectangle));
+                    g_hash_table_insert (p->words, word, boxes);
+                } else {
+                    g_free (word);
+                }
+                g_array_append_val (boxes, box);
+                start = NULL;
+            }
+            if (!*c) break;
         }
     }
 
-    synctex_scanner_free(sync_scanner);
-    return TRUE;
+    g_free (rects);
+    g_free (text);
+    g_object_unref (ppage);
+    return p->words;
+}
+
+static gboolean sync_node_contains_word (GuPreviewGui* pc, SyncNode* sn,
+                                         const gchar* word) {
+    GArray *boxes = NULL;
+    guint i = 0;
+
+    if (sn->page < 0 || sn->page >= pc->n_pages) return FALSE;
+
+    boxes = g_hash_table_lookup (page_get_words (pc, sn->page), word);
+    for (i = 0; boxes && i < boxes->len; i++) {
+        PopplerRectangle *box = &g_array_index (boxes, PopplerRectangle, i);
+        if (box->x1 <= sn->x + sn->width && box->x2 >= sn->x &&
+            box->y1 <= sn->y + sn->height && box->y2 >= sn->y) {
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
 
 static void synctex_filter_results(GuPreviewGui* pc, GtkTextIter *sync_to) {
@@ -1149,9 +1536,7 @@ static void synctex_filter_results(GuPreviewGui* pc, GtkTextIter *sync_to) {
             break;
         }
 
-        gchar *word = g_strconcat("\\b", gtk_text_iter_get_text(&wordStart, &wordEnd), "\\b", NULL);
-
-        //gchar *pattern g_strconcat
+        gchar *word = gtk_text_iter_get_text(&wordStart, &wordEnd);
 
         slog(L_DEBUG, "Searching for word \"%s\"\n", word);
 
@@ -1161,25 +1546,10 @@ static void synctex_filter_results(GuPreviewGui* pc, GtkTextIter *sync_to) {
 
             SyncNode *sn =  nl->data;
 
-            PopplerRectangle selection;
-            selection.x1 = sn->x;               // lower left corner
-            selection.y1 = sn->y + sn->height;  // lower left corner
-            selection.x2 = sn->x + sn->width;   // upper right corner
-            selection.y2 = sn->y;               // upper right corner
-
-            PopplerPage* ppage = poppler_document_get_page(pc->doc, sn->page);
-            gchar *node_text = poppler_page_get_selected_text(ppage,
-                        POPPLER_SELECTION_WORD, &selection);
-
-            //slog(L_DEBUG, "Node contains text\"%s\"\n", node_text);
-
-            if (g_regex_match_simple(word, node_text, 0, 0)) {
+            if (sync_node_contains_word (pc, sn, word)) {
                 sn->score += 1;
             }
 
-            g_free(node_text);
-            g_object_unref(ppage);
-
             nl = nl->next;
         }
 
@@ -1358,8 +1728,8 @@ static void synctex_scroll_to_node (GuPreviewGui* pc, SyncNode* node) {
         previewgui_goto_xy(pc, to_x, to_y);
 
     } else {
-        if (config_value_as_str_equals ("Preview", "animated_scroll", "always") ||
-            config_value_as_str_equals ("Preview", "animated_scroll", "autosync")) {
+        if (STR_EQU (config_hot.animated_scroll, "always") ||
+            STR_EQU (config_hot.animated_scroll, "autosync")) {
             previewgui_scroll_to_xy(pc, to_x, to_y);
         } else {
             previewgui_goto_xy(pc, to_x, to_y);
@@ -1492,57 +1862,214 @@ void previewgui_restore_position (GuPreviewGui* pc) {
     unblock_handlers_current_page(pc);
 }
 
-static cairo_surface_t* do_render (PopplerPage* ppage, gdouble scale,
-                                   gint width, gint height) {
+static void on_tile_rendered (GuRenderJob* job, gpointer user) {
+    GuPreviewGui* pc = GU_PREVIEW_GUI (user);
 
-    cairo_surface_t* r = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                                width*scale,
-                                                height*scale);
-    cairo_t *c = cairo_create(r);
+    if (job->key.page >= pc->n_pages ||
+        job->key.revision != pc->pages[job->key.page].revision) {
+        return;
+    }
+
+    rendercache_insert (pc->rendercache, &job->key, job->surface);
+    gtk_widget_queue_draw (pc->drawarea);
+}
 
-    cairo_scale (c, scale, scale);
-    poppler_page_render(ppage, c);
+void previewgui_reset (GuPreviewGui* pc) {
+    //L_F_DEBUG;
+    /* reset uri */
+    g_free (pc->uri);
+    pc->uri = NULL;
+    syncindex_clear (pc->sync);
+    pc->sync_pending = FALSE;
+    pc->reverse_pending = FALSE;
+
+    // Not forced, a tab that was compiled in the background keeps its pdf
+    if (gummi_get_active_editor ())
+        g_atomic_int_set (&gummi_get_active_editor ()->modified_since_compile,
+                          TRUE);
+    previewgui_stop_preview (pc);
+    motion_do_compile (gummi->motion);
 
-    // TODO for what is this used?
-    cairo_set_operator (c, CAIRO_OPERATOR_DEST_OVER);
-    cairo_set_source_rgb (c, 1, 1, 1);
-    cairo_paint (c);
-    cairo_destroy (c);
+    if (!config_hot.pause) {
+        previewgui_start_preview (pc);
+    }
+}
 
-    return r;
+static void free_pages (GuPreviewPage* pages, gint n_pages) {
+    gint i;
+    for (i = 0; i < n_pages; i++) {
+        if (pages[i].words) g_hash_table_destroy (pages[i].words);
+    }
+    g_free (pages);
 }
 
-static cairo_surface_t* get_page_rendering (GuPreviewGui* pc, int page) {
+static void previewsession_free (GuPreviewSession* s) {
+    if (s->doc) g_object_unref (s->doc);
+    g_free (s->uri);
+    free_pages (s->pages, s->n_pages);
+    syncindex_free (s->sync);
+    g_free (s);
+}
 
-    GuPreviewPage *p = pc->pages + page;
+/* Sessions beyond max_parked, least recently parked first, give up their
+ * document and only keep the position to scroll back to */
+static void limit_parked_sessions (GuPreviewGui* pc) {
+    GList* link = NULL;
+    gint loaded = 0;
+    guint n = 0;
 
-    if (p->rendering == NULL) {
-        PopplerPage* ppage = poppler_document_get_page(pc->doc, page);
-        p->rendering = do_render(ppage, pc->scale, p->width, p->height);
-        g_object_unref(ppage);
-        pc->cache_size += page_inner(pc, page).width *
-                page_inner(pc, page).height * BYTES_PER_PIXEL;
+    for (link = pc->sessions; link; link = link->next) {
+        GuPreviewSession* s = GU_PREVIEW_SESSION (link->data);
+        if (s->doc == NULL || ++loaded <= pc->max_parked) continue;
 
-        // Trigger the garbage collector to be run - it will exit if nothing is TBD.
-        g_idle_add( (GSourceFunc) run_garbage_collector, pc);
+        slog (L_DEBUG, "Unloaded parked preview of %s\n", s->uri);
+        g_object_unref (s->doc);
+        s->doc = NULL;
+        free_pages (s->pages, s->n_pages);
+        s->pages = NULL;
+        s->n_pages = 0;
+        syncindex_free (s->sync);
+        s->sync = NULL;
+        ++n;
     }
-
-    return cairo_surface_reference(p->rendering);
+    if (n) drop_outdated_renderings (pc);
 }
 
-void previewgui_reset (GuPreviewGui* pc) {
-    //L_F_DEBUG;
-    /* reset uri */
-    g_free (pc->uri);
+/**
+ * @brief Detaches the loaded document from the preview so it can be shown
+ * again without reloading it when its tab is switched back to
+ */
+GuPreviewSession* previewgui_park_session (GuPreviewGui* pc) {
+    GuPreviewSession* s = NULL;
+
+    if (pc->doc == NULL || pc->uri == NULL) return NULL;
+
+    // Parked pages stay as they are, those still waiting for their scan
+    // can not be told apart from changed ones
+    if (pc->pages_unscanned) apply_page_signatures (pc, NULL);
+    ++pc->scan_serial;
+
+    s = g_new0 (GuPreviewSession, 1);
+    s->doc = pc->doc;
+    s->uri = pc->uri;
+    s->generation = pc->generation;
+    s->n_pages = pc->n_pages;
+    s->pages = pc->pages;
+    s->pages_signed = pc->pages_signed;
+    s->sync = pc->sync;
+    s->current_page = pc->current_page;
+    s->scale = pc->scale;
+    s->scroll_x = gtk_adjustment_get_value (pc->hadj);
+    s->scroll_y = gtk_adjustment_get_value (pc->vadj);
+
+    pc->doc = NULL;
     pc->uri = NULL;
+    pc->pages = NULL;
+    pc->n_pages = 0;
+    pc->pages_signed = FALSE;
+    pc->sync = syncindex_new (on_syncindex_ready, pc);
+    pc->sync_pending = FALSE;
+    pc->reverse_pending = FALSE;
+    pc->sessions = g_list_prepend (pc->sessions, s);
+    limit_parked_sessions (pc);
 
-    gummi->latex->modified_since_compile = TRUE;
-    previewgui_stop_preview (pc);
-    motion_do_compile (gummi->motion);
+    synctex_clear_sync_nodes (pc);
+    renderpool_invalidate (pc->renderpool);
 
-    if (config_get_boolean ("Compile", "pause") == FALSE) {
-        previewgui_start_preview (pc);
+    slog (L_DEBUG, "Parked preview of %s (%d pages)\n", s->uri, s->n_pages);
+    return s;
+}
+
+/**
+ * @brief Shows a parked session again, the session is consumed. Returns
+ * FALSE when there was nothing to show and the preview has to be reset
+ */
+gboolean previewgui_resume_session (GuPreviewGui* pc, GuPreviewSession* s) {
+    GuEditor* editor = gummi_get_active_editor ();
+    gboolean outdated = FALSE;
+    gchar* label = NULL;
+
+    if (s == NULL) return FALSE;
+
+    pc->sessions = g_list_remove (pc->sessions, s);
+
+    // Unloaded to stay within max_parked, it is loaded again from scratch
+    if (s->doc == NULL && g_active_tab) {
+        g_active_tab->scroll_x = s->scroll_x;
+        g_active_tab->scroll_y = s->scroll_y;
     }
+    if (!editor || !s->doc || !utils_uri_path_exists (s->uri)) {
+        previewsession_free (s);
+        drop_outdated_renderings (pc);
+        return FALSE;
+    }
+    // A background compile published a new pdf since it was loaded
+    outdated = (g_atomic_int_get (&editor->generation) != s->generation);
+
+    // Whatever is still loaded belongs to a tab that has been closed
+    previewgui_cleanup_fds (pc);
+    g_free (pc->uri);
+    free_pages (pc->pages, pc->n_pages);
+
+    pc->doc = s->doc;
+    pc->uri = s->uri;
+    pc->generation = s->generation;
+    pc->n_pages = s->n_pages;
+    pc->pages = s->pages;
+    pc->pages_signed = s->pages_signed;
+    syncindex_free (pc->sync);
+    pc->sync = s->sync;
+    pc->current_page = s->current_page;
+    pc->scale = s->scale;
+    g_active_tab->scroll_x = s->scroll_x;
+    g_active_tab->scroll_y = s->scroll_y;
+    g_free (s);
+
+    slog (L_DEBUG, "Resumed preview of %s (%d pages)\n", pc->uri, pc->n_pages);
+
+    label = g_strdup_printf (_("of %d"), pc->n_pages);
+    gtk_label_set_text (GTK_LABEL (pc->page_label), label);
+    g_free (label);
+
+    renderpool_set_document (pc->renderpool, pc->uri);
+    rendercache_use_scale (pc->rendercache, pc->scale);
+    drop_outdated_renderings (pc);
+    rendercache_log_stats (pc->rendercache);
+
+    // Parsed already unless a compile rewrote the SyncTeX data meanwhile
+    pc->sync_pending = FALSE;
+    pc->reverse_pending = FALSE;
+    if (config_hot.synctex) {
+        gchar* pdffile = g_filename_from_uri (pc->uri, NULL, NULL);
+        syncindex_update (pc->sync, pdffile);
+        g_free (pdffile);
+    }
+
+    update_page_sizes (pc);
+    update_prev_next_page (pc);
+    restore_zoom (pc);
+    previewgui_set_current_page (pc, pc->current_page);
+
+    if (pc->errormode) {
+        previewgui_stop_errormode (pc);
+    } else {
+        previewgui_restore_position (pc);
+    }
+    gtk_widget_queue_draw (pc->drawarea);
+
+    if (outdated) previewgui_refresh (pc, NULL, NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Forgets the parked session of a tab that is closed
+ */
+void previewgui_drop_session (GuPreviewGui* pc, GuPreviewSession* s) {
+    if (s == NULL) return;
+
+    pc->sessions = g_list_remove (pc->sessions, s);
+    previewsession_free (s);
+    drop_outdated_renderings (pc);
 }
 
 
@@ -1553,14 +2080,17 @@ void previewgui_cleanup_fds (GuPreviewGui* pc) {
         g_object_unref (pc->doc);
         pc->doc = NULL;
     }
+    // A running page scan is of the document that is gone
+    pc->pages_unscanned = 0;
+    ++pc->scan_serial;
 }
 
 void previewgui_start_preview (GuPreviewGui* pc) {
-    if (config_value_as_str_equals ("Compile", "scheme", "on_idle")) {
+    if (STR_EQU (config_hot.scheme, "on_idle")) {
         pc->preview_on_idle = TRUE;
     } else {
         pc->update_timer = g_timeout_add_seconds (
-                                config_get_integer ("Compile", "timer"),
+                                config_hot.timer,
                                 motion_do_compile, gummi->motion);
     }
 }
@@ -1581,7 +2111,7 @@ void on_page_input_changed (GtkEntry* entry, void* user) {
     newpage = MAX(newpage, 0);
     newpage = MIN(newpage, gui->previewgui->n_pages);
 
-    if (config_value_as_str_equals ("Preview", "animated_scroll", "always")) {
+    if (STR_EQU (config_hot.animated_scroll, "always")) {
         previewgui_scroll_to_page (gui->previewgui, newpage);
     } else {
         previewgui_goto_page (gui->previewgui, newpage);
@@ -1594,7 +2124,7 @@ void on_next_page_clicked (GtkWidget* widget, void* user) {
     //L_F_DEBUG;
     GuPreviewGui *pc = gui->previewgui;
 
-    if (config_value_as_str_equals ("Preview", "animated_scroll", "always")) {
+    if (STR_EQU (config_hot.animated_scroll, "always")) {
         previewgui_scroll_to_page (pc, pc->next_page);
     } else {
         previewgui_goto_page (pc, pc->next_page);
@@ -1606,7 +2136,7 @@ void on_prev_page_clicked (GtkWidget* widget, void* user) {
     //L_F_DEBUG;
     GuPreviewGui *pc = gui->previewgui;
 
-    if (config_value_as_str_equals ("Preview", "animated_scroll", "always")) {
+    if (STR_EQU (config_hot.animated_scroll, "always")) {
         previewgui_scroll_to_page (pc, pc->prev_page);
     } 
     else {
@@ -1679,11 +2209,7 @@ static void paint_page (cairo_t *cr, GuPreviewGui* pc, gint page, gint x, gint y
     cairo_rectangle (cr, x - 1, y - 1, page_width + 1, page_height + 1);
     cairo_stroke (cr);
 
-    cairo_surface_t* rendering = get_page_rendering(pc, page);
-
-    // Paint rendering
-    cairo_set_source_surface (cr, rendering, x, y);
-    cairo_paint (cr);
+    paint_page_tiles(cr, pc, page, x, y);
 
 
     GSList *nl = pc->sync_nodes;
@@ -1711,8 +2237,120 @@ static void paint_page (cairo_t *cr, GuPreviewGui* pc, gint page, gint x, gint y
 
         nl = nl->next;
     }
+}
+
+static void paint_placeholder (cairo_t *cr, GuPreviewGui* pc, gint page,
+                               gint x, gint y, gint tile_x, gint tile_y,
+                               gint width, gint height) {
+    GuRenderKey key = tile_key (pc, page, -1, -1);
+    cairo_surface_t* placeholder = rendercache_lookup (pc->rendercache, &key);
+
+    cairo_save (cr);
+    cairo_rectangle (cr, tile_x, tile_y, width, height);
+    cairo_clip (cr);
+
+    if (placeholder) {
+        // Upscale the low resolution rendering of the whole page
+        gdouble factor = pc->scale / key.scale;
+        cairo_translate (cr, x, y);
+        cairo_scale (cr, factor, factor);
+        cairo_set_source_surface (cr, placeholder, 0, 0);
+    } else {
+        cairo_set_source_rgb (cr, 1, 1, 1);
+    }
+    cairo_paint (cr);
+    cairo_restore (cr);
+}
+
+/**
+ *  Blits the finished tiles of a page that intersect with the area that is
+ *  redrawn and requests the missing ones from the render pool. Tiles within
+ *  prefetch_depth of the visible ones are requested with a lower priority.
+ */
+static void paint_page_tiles (cairo_t *cr, GuPreviewGui* pc, gint page,
+                              gint x, gint y) {
+    GuPreviewPage *p = pc->pages + page;
+    gint width = p->width * pc->scale;
+    gint height = p->height * pc->scale;
+    gint cols = (width + TILE_SIZE - 1) / TILE_SIZE;
+    gint rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    gint depth = pc->prefetch_depth;
+    gdouble cx1, cy1, cx2, cy2;
+    gint tx1, ty1, tx2, ty2, tx, ty;
+    GuRenderKey key;
+
+    if (cols <= 0 || rows <= 0) {
+        return;
+    }
+
+    key = tile_key (pc, page, -1, -1);
+    if (!rendercache_contains (pc->rendercache, &key)) {
+        renderpool_request (pc->renderpool, &key, 0);
+    }
+
+    cairo_clip_extents (cr, &cx1, &cy1, &cx2, &cy2);
+    tx1 = CLAMP (floor ((cx1 - x) / TILE_SIZE), 0, cols - 1);
+    ty1 = CLAMP (floor ((cy1 - y) / TILE_SIZE), 0, rows - 1);
+    tx2 = CLAMP (floor ((cx2 - x) / TILE_SIZE), 0, cols - 1);
+    ty2 = CLAMP (floor ((cy2 - y) / TILE_SIZE), 0, rows - 1);
+
+    for (ty = MAX (ty1 - depth, 0); ty <= MIN (ty2 + depth, rows - 1); ty++) {
+        for (tx = MAX (tx1 - depth, 0); tx <= MIN (tx2 + depth, cols - 1); tx++) {
+            gint ring = MAX (MAX (tx1 - tx, tx - tx2), MAX (ty1 - ty, ty - ty2));
+            gint tile_x = x + tx * TILE_SIZE;
+            gint tile_y = y + ty * TILE_SIZE;
+            cairo_surface_t* tile = NULL;
+
+            key = tile_key (pc, page, tx, ty);
+
+            if (ring > 0) {
+                if (!rendercache_contains (pc->rendercache, &key)) {
+                    renderpool_request (pc->renderpool, &key, 1 + ring);
+                }
+            } else if ((tile = rendercache_lookup (pc->rendercache, &key))) {
+                cairo_set_source_surface (cr, tile, tile_x, tile_y);
+                cairo_rectangle (cr, tile_x, tile_y,
+                                 cairo_image_surface_get_width (tile),
+                                 cairo_image_surface_get_height (tile));
+                cairo_fill (cr);
+            } else {
+                paint_placeholder (cr, pc, page, x, y, tile_x, tile_y,
+                                   MIN (TILE_SIZE, width - tx * TILE_SIZE),
+                                   MIN (TILE_SIZE, height - ty * TILE_SIZE));
+                renderpool_request (pc->renderpool, &key, 1);
+            }
+        }
+    }
+}
 
-    cairo_surface_destroy(rendering);
+/**
+ *  Requests the rows of tiles of a page just outside the view that are
+ *  closest to it, so scrolling into the next page does not show placeholders.
+ */
+static void prefetch_page_tiles (GuPreviewGui* pc, gint page,
+                                 gboolean from_top) {
+    if (page < 0 || page >= pc->n_pages) {
+        return;
+    }
+
+    gint cols = ceil (get_page_width(pc, page) * pc->scale / TILE_SIZE);
+    gint rows = ceil (get_page_height(pc, page) * pc->scale / TILE_SIZE);
+    gint r, tx;
+    GuRenderKey key = tile_key (pc, page, -1, -1);
+
+    if (!rendercache_contains (pc->rendercache, &key)) {
+        renderpool_request (pc->renderpool, &key, 1);
+    }
+
+    for (r = 0; r < MIN (pc->prefetch_depth, rows); r++) {
+        gint ty = from_top ? r : rows - 1 - r;
+        for (tx = 0; tx < cols; tx++) {
+            key = tile_key (pc, page, tx, ty);
+            if (!rendercache_contains (pc->rendercache, &key)) {
+                renderpool_request (pc->renderpool, &key, 2 + r);
+            }
+        }
+    }
 }
 
 static inline LayeredRectangle get_fov(GuPreviewGui* pc) {
@@ -1779,68 +2417,18 @@ static gboolean layered_rectangle_intersect (const LayeredRectangle *src1,
     return FALSE;
 }
 
-gboolean run_garbage_collector (GuPreviewGui* pc) {
-
-    gint max_cache_size = config_get_integer ("Preview", "cache_size") * 1024 * 1024;
-
-    if (pc->cache_size < max_cache_size) {
-        return FALSE;
-    }
-
-    LayeredRectangle fov = get_fov(pc);
-
-    gint first = -1;
-    gint last = -1;
-
-    gint i;
-    for (i=0; i < pc->n_pages; i++) {
-        if (layered_rectangle_intersect(&fov, &(page_inner(pc, i)), NULL)) {
-            if (first == -1) {
-                first = i;
-            }
-            last = i;
-        }
-    }
-
-    if (first == -1) {
-        slog (L_ERROR, "No pages are shown. Clearing whole cache.\n");
-        previewgui_invalidate_renderings(pc);
-    }
+static void on_cache_size_changed (const gchar* group, const gchar* key,
+                                   gpointer user) {
+    g_idle_add ((GSourceFunc) run_garbage_collector, user);
+}
 
-    gint n=0;
-    gint dist = MAX(first, pc->n_pages - 1 - last);
-    for (; dist > 0; dist--) {
-        gint up = first - dist;
-        if (up >= 0 && up < pc->n_pages) {
-            if (!layered_rectangle_intersect(&fov, &(page_inner(pc, up)), NULL)) {
-                if (remove_page_rendering(pc, up)) {
-                    n += 1;
-                }
-            }
-        }
-        if (pc->cache_size < max_cache_size / 2) {
-            break;
-        }
+gboolean run_garbage_collector (GuPreviewGui* pc) {
 
-        gint down = last + dist;
-        if (down < pc->n_pages && down >= 0) {
-            if (!layered_rectangle_intersect(&fov, &(page_inner(pc, down)), NULL)) {
-                if (remove_page_rendering(pc, down)) {
-                    n += 1;
-                }
-            }
-        }
-        if (pc->cache_size < max_cache_size / 2) {
-            break;
-        }
-    }
+    gsize max_cache_size = (gsize)config_hot.cache_size * 1024 * 1024;
 
-    if (n == 0) {
-        slog(L_DEBUG, "Could not delete any pages from cache. All pages are "
-                "currently visible.\n");
-    } else {
-        slog(L_DEBUG, "Deleted %i pages from cache.\n", n);
-    }
+    // Least recently used renderings are evicted until the cache fits
+    rendercache_set_max_size (pc->rendercache, max_cache_size);
+    rendercache_log_stats (pc->rendercache);
 
     return FALSE;   // We only want this to run once - so always return false!
 }
@@ -1853,6 +2441,9 @@ gboolean on_draw (GtkWidget* w, cairo_t* cr, void* user) {
         return FALSE;
     }
 
+    // Renderings used while painting this frame are exempt from eviction
+    rendercache_new_frame (pc->rendercache);
+
     gdouble page_width = gtk_adjustment_get_page_size(pc->hadj);
     gdouble page_height = gtk_adjustment_get_page_size(pc->vadj);
 
@@ -1881,6 +2472,7 @@ gboolean on_draw (GtkWidget* w, cairo_t* cr, void* user) {
         // We added one offset to many...
         offset_y -= get_page_height(pc, i)*pc->scale + get_page_margin(pc);
 
+        gint first = i;
         for (; i < pc->n_pages; i++) {
 
             paint_page(cr, pc, i,
@@ -1894,6 +2486,9 @@ gboolean on_draw (GtkWidget* w, cairo_t* cr, void* user) {
             }
         }
 
+        prefetch_page_tiles(pc, first - 1, FALSE);
+        prefetch_page_tiles(pc, i + 1, TRUE);
+
     } else {    // "Page" Layout...
 
         gdouble height = get_page_height(pc, pc->current_page) * pc->scale;
@@ -1968,30 +2563,7 @@ gboolean on_button_pressed (GtkWidget* w, GdkEventButton* e, void* user) {
 
         slog(L_DEBUG, "Ctrl-click to %i, %i\n", x, y);
 
-        synctex_scanner_p sync_scanner = synctex_scanner_new_with_output_file(pc->uri, C_TMPDIR, 1);
-
-        if(synctex_edit_query(sync_scanner, page+1, x/pc->scale, y/pc->scale)>0) {
-            synctex_node_p node;
-            /*
-             * SyncTeX can return several nodes. It seems best to use the last one, as
-             * this one rarely is below (usually slightly above) the edited line.
-             */
-
-            if ((node = synctex_scanner_next_result(sync_scanner))) {
-
-                const gchar *file = synctex_scanner_get_name(sync_scanner, synctex_node_tag(node));
-                gint line = synctex_node_line(node);
-
-                slog(L_DEBUG, "File \"%s\", Line %i\n", file, line);
-
-                // FIXME: Go to the editor containing the file "file"!
-                editor_scroll_to_line(gummi_get_active_editor(), line-1);
-
-            }
-        }
-
-        synctex_scanner_free(sync_scanner);
-
+        synctex_reverse_sync (pc, page, x/pc->scale, y/pc->scale);
     }
 
     pc->prev_x = e->x;
@@ -33,6 +33,9 @@
 #include <gtk/gtk.h>
 #include <poppler.h>
 
+#include "syncindex.h"
+#include "gui/gui-render.h"
+
 #define PAGE_MARGIN 14
 #define DOCUMENT_MARGIN (PAGE_MARGIN/2)
 #define PAGE_SHADOW_WIDTH 4
@@ -45,6 +48,7 @@
 
 
 #define BYTES_PER_PIXEL 4
+#define PLACEHOLDER_SCALE 0.5
 
 /**
  *  These "Layered" Rectangles are just like normal GdkRectangles, except the
@@ -77,14 +81,36 @@ enum GuPreviewFitModes {
 typedef struct _GuPreviewPage GuPreviewPage;
 
 struct _GuPreviewPage {
-    cairo_surface_t* rendering;
-
     double height;
     double width;
 
     LayeredRectangle inner; // Position of the page itself
     LayeredRectangle outer; // Position of the page + border & shadow
 
+    guint revision;         // Cached renderings of the page are tagged with it
+    guint64 signature;      // Content signature, see pagediff_scan
+    GHashTable* words;      // Word -> GArray of PopplerRectangle, or NULL
+};
+
+#define GU_PREVIEW_SESSION(x) ((GuPreviewSession*)(x))
+typedef struct _GuPreviewSession GuPreviewSession;
+
+/* The loaded document of a tab that is not shown. Renderings of its pages
+ * stay in the render cache, which all tabs share, until they are evicted */
+struct _GuPreviewSession {
+    PopplerDocument* doc;
+    gchar* uri;
+    gint generation;        // of the pdf when it was loaded
+
+    gint n_pages;
+    GuPreviewPage* pages;
+    gboolean pages_signed;
+    GuSyncIndex* sync;      // parsed SyncTeX data that goes with doc
+
+    gint current_page;
+    gdouble scale;
+    gdouble scroll_x;
+    gdouble scroll_y;
 };
 
 #define GU_PREVIEW_GUI(x) ((GuPreviewGui*)x)
@@ -122,6 +148,7 @@ struct _GuPreviewGui {
     GtkRadioMenuItem *page_layout_one_column;
 
     gchar *uri;
+    gint generation;        // editor generation of the loaded pdf
     guint update_timer;
     gboolean preview_on_idle;
     gboolean errormode;
@@ -143,7 +170,15 @@ struct _GuPreviewGui {
     gdouble scale;
     PopplerPageLayout pageLayout;
     GuPreviewPage *pages;
-    gint cache_size;
+    gboolean pages_signed;
+    gint pages_unscanned;   // leading pages shown as of the last load
+    guint scan_serial;      // drops scans of pages that were replaced
+
+    GuRenderPool* renderpool;
+    GuRenderCache* rendercache;
+    gint prefetch_depth;
+    GList* sessions;        // parked GuPreviewSession of the other tabs
+    gint max_parked;        // sessions that keep their document loaded
 
     gint document_width_scaling;
     gint document_height_scaling;
@@ -160,6 +195,12 @@ struct _GuPreviewGui {
     gint ascroll_dist_y;
 
     GSList *sync_nodes;
+    GuSyncIndex* sync;
+    gboolean sync_pending;  /* sync once the index has been rebuilt */
+    gboolean reverse_pending;
+    gint reverse_page;
+    gdouble reverse_x;
+    gdouble reverse_y;
 };
 
 GuPreviewGui* previewgui_init (GtkBuilder * builder);
@@ -173,6 +214,9 @@ void previewgui_scroll_to_xy (GuPreviewGui* pc, gdouble x, gdouble y);
 void previewgui_save_position (GuPreviewGui* pc);
 void previewgui_restore_position (GuPreviewGui* pc);
 void previewgui_reset (GuPreviewGui* pc);
+GuPreviewSession* previewgui_park_session (GuPreviewGui* pc);
+gboolean previewgui_resume_session (GuPreviewGui* pc, GuPreviewSession* s);
+void previewgui_drop_session (GuPreviewGui* pc, GuPreviewSession* s);
 void previewgui_cleanup_fds (GuPreviewGui* pc);
 void previewgui_start_preview (GuPreviewGui* pc);
 void previewgui_drawarea_resize (GuPreviewGui* pc);
@@ -195,6 +239,7 @@ void previewgui_set_page_layout(GuPreviewGui* pc, PopplerPageLayout pageLayout);
 void previewgui_start_errormode (GuPreviewGui *pc, const gchar *msg);
 void previewgui_stop_errormode (GuPreviewGui *pc);
 gboolean on_document_compiled (gpointer data);
+gboolean on_document_error_found (gpointer data);
 gboolean on_document_error (gpointer data);
 
 gboolean run_garbage_collector(GuPreviewGui* pc);
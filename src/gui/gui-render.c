@@ -0,0 +1,417 @@
+/**
+ * @file    gui-render.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gui/gui-render.h"
+
+#include <string.h>
+
+#include <cairo.h>
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <poppler.h>
+
+#include "utils.h"
+
+/* Background rasterizer for the preview. Jobs are rendered by a pool of
+ * worker threads, every worker keeps its own PopplerDocument since poppler
+ * documents can't be shared between threads. Finished jobs are handed back
+ * to the main loop, so the pending set and the render cache are only ever
+ * touched from the GTK thread. */
+
+typedef struct {
+    GuRenderKey key;
+    cairo_surface_t* surface;
+    gsize size;
+    guint frame;
+    GList link;
+} RenderCacheEntry;
+
+typedef struct {
+    guint generation;
+    PopplerDocument* doc;
+} RenderWorkerDoc;
+
+static void render_worker_doc_free (gpointer data);
+static GPrivate render_worker_doc = G_PRIVATE_INIT (render_worker_doc_free);
+
+static void render_worker_doc_free (gpointer data) {
+    RenderWorkerDoc* wd = data;
+    if (wd->doc) g_object_unref (wd->doc);
+    g_free (wd);
+}
+
+static void render_job_free (GuRenderJob* job) {
+    if (job->surface) cairo_surface_destroy (job->surface);
+    g_free (job->uri);
+    g_free (job);
+}
+
+static gint render_job_compare (gconstpointer a, gconstpointer b,
+                                gpointer user) {
+    return ((GuRenderJob*)a)->priority - ((GuRenderJob*)b)->priority;
+}
+
+guint render_key_hash (gconstpointer key) {
+    const GuRenderKey* k = key;
+    guint64 bits;
+    guint hash;
+
+    memcpy (&bits, &k->scale, sizeof (bits));
+    hash = (guint)k->page * 31 + (guint)k->tile_x;
+    hash = hash * 31 + (guint)k->tile_y;
+    hash = hash * 31 + k->revision;
+    return hash ^ (guint)(bits ^ (bits >> 32));
+}
+
+gboolean render_key_equal (gconstpointer a, gconstpointer b) {
+    const GuRenderKey* ka = a;
+    const GuRenderKey* kb = b;
+
+    return ka->page == kb->page && ka->tile_x == kb->tile_x &&
+           ka->tile_y == kb->tile_y && ka->revision == kb->revision &&
+           ka->scale == kb->scale;
+}
+
+static gboolean render_job_finished (gpointer data) {
+    GuRenderJob* job = data;
+    GuRenderPool* rp = job->pool;
+
+    /* Jobs of an earlier epoch were already dropped from the pending set */
+    if (job->epoch == g_atomic_int_get (&rp->epoch)) {
+        g_hash_table_remove (rp->pending, &job->key);
+        if (job->surface) rp->done (job, rp->user);
+    }
+    render_job_free (job);
+    return FALSE;
+}
+
+static void render_worker (gpointer data, gpointer user) {
+    GuRenderJob* job = data;
+    GuRenderPool* rp = user;
+    RenderWorkerDoc* wd = g_private_get (&render_worker_doc);
+    PopplerPage* ppage = NULL;
+
+    if (job->epoch != g_atomic_int_get (&rp->epoch))
+        goto done;
+
+    if (wd == NULL) {
+        wd = g_new0 (RenderWorkerDoc, 1);
+        g_private_set (&render_worker_doc, wd);
+    }
+    if (wd->doc == NULL || wd->generation != job->generation) {
+        if (wd->doc) g_object_unref (wd->doc);
+        wd->doc = poppler_document_new_from_file (job->uri, NULL, NULL);
+        wd->generation = job->generation;
+    }
+    if (wd->doc == NULL ||
+        job->key.page >= poppler_document_get_n_pages (wd->doc))
+        goto done;
+
+    if ((ppage = poppler_document_get_page (wd->doc, job->key.page))) {
+        gint x, y, width, height;
+        render_tile_rect (ppage, job->key.scale, job->key.tile_x,
+                          job->key.tile_y, &x, &y, &width, &height);
+        if (width > 0 && height > 0)
+            job->surface = render_tile (ppage, job->key.scale,
+                                        x, y, width, height);
+        g_object_unref (ppage);
+    }
+
+done:
+    gdk_threads_add_idle (render_job_finished, job);
+}
+
+GuRenderPool* renderpool_new (gint n_workers, GuRenderFunc done,
+                              gpointer user) {
+    GuRenderPool* rp = g_new0 (GuRenderPool, 1);
+    GError* err = NULL;
+
+    rp->done = done;
+    rp->user = user;
+    rp->pending = g_hash_table_new_full (render_key_hash, render_key_equal,
+                                         g_free, NULL);
+    rp->threads = g_thread_pool_new (render_worker, rp, MAX (n_workers, 1),
+                                     FALSE, &err);
+    if (err) {
+        slog (L_G_FATAL, "Could not create render threads: %s\n",
+                         err->message);
+    }
+    g_thread_pool_set_sort_function (rp->threads, render_job_compare, NULL);
+
+    slog (L_DEBUG, "Preview render pool started with %d threads\n",
+                   MAX (n_workers, 1));
+    return rp;
+}
+
+void renderpool_set_document (GuRenderPool* rp, const gchar* uri) {
+    g_free (rp->uri);
+    rp->uri = g_strdup (uri);
+    rp->generation++;
+    renderpool_invalidate (rp);
+}
+
+void renderpool_invalidate (GuRenderPool* rp) {
+    /* Queued jobs notice the new epoch and return without rendering */
+    g_atomic_int_inc (&rp->epoch);
+    g_hash_table_remove_all (rp->pending);
+}
+
+gboolean renderpool_request (GuRenderPool* rp, const GuRenderKey* key,
+                             gint priority) {
+    GuRenderKey* pending = NULL;
+    GuRenderJob* job = NULL;
+
+    if (rp->uri == NULL || g_hash_table_contains (rp->pending, key))
+        return FALSE;
+    pending = g_new (GuRenderKey, 1);
+    *pending = *key;
+    g_hash_table_add (rp->pending, pending);
+
+    job = g_new0 (GuRenderJob, 1);
+    job->pool = rp;
+    job->uri = g_strdup (rp->uri);
+    job->generation = rp->generation;
+    job->epoch = g_atomic_int_get (&rp->epoch);
+    job->key = *key;
+    job->priority = priority;
+
+    g_thread_pool_push (rp->threads, job, NULL);
+    return TRUE;
+}
+
+/* LRU cache of rendered tiles. The budget is checked against the real
+ * memory use of the surfaces, entries that were used for the frame that is
+ * currently being painted are never evicted to avoid render loops when the
+ * budget is smaller than the view. */
+
+static void rendercache_entry_free (gpointer data) {
+    RenderCacheEntry* entry = data;
+    cairo_surface_destroy (entry->surface);
+    g_free (entry);
+}
+
+GuRenderCache* rendercache_new (gsize max_size) {
+    GuRenderCache* rc = g_new0 (GuRenderCache, 1);
+
+    rc->entries = g_hash_table_new_full (render_key_hash, render_key_equal,
+                                         NULL, rendercache_entry_free);
+    g_queue_init (&rc->lru);
+    g_queue_init (&rc->scales);
+    rc->max_size = max_size;
+    return rc;
+}
+
+static void rendercache_remove_entry (GuRenderCache* rc,
+                                      RenderCacheEntry* entry) {
+    g_queue_unlink (&rc->lru, &entry->link);
+    rc->size -= entry->size;
+    g_hash_table_remove (rc->entries, &entry->key);
+}
+
+static void rendercache_trim (GuRenderCache* rc) {
+    GList* last = NULL;
+
+    while (rc->size > rc->max_size && (last = g_queue_peek_tail_link (&rc->lru))) {
+        RenderCacheEntry* entry = last->data;
+
+        if (entry->frame == rc->frame) break;
+        rendercache_remove_entry (rc, entry);
+        rc->evictions++;
+    }
+}
+
+cairo_surface_t* rendercache_lookup (GuRenderCache* rc, const GuRenderKey* key) {
+    RenderCacheEntry* entry = g_hash_table_lookup (rc->entries, key);
+
+    if (entry == NULL) {
+        rc->misses++;
+        return NULL;
+    }
+
+    rc->hits++;
+    entry->frame = rc->frame;
+    g_queue_unlink (&rc->lru, &entry->link);
+    g_queue_push_head_link (&rc->lru, &entry->link);
+    return entry->surface;
+}
+
+gboolean rendercache_contains (GuRenderCache* rc, const GuRenderKey* key) {
+    return g_hash_table_contains (rc->entries, key);
+}
+
+void rendercache_insert (GuRenderCache* rc, const GuRenderKey* key,
+                         cairo_surface_t* surface) {
+    RenderCacheEntry* entry = g_hash_table_lookup (rc->entries, key);
+
+    if (entry) rendercache_remove_entry (rc, entry);
+
+    entry = g_new0 (RenderCacheEntry, 1);
+    entry->key = *key;
+    entry->surface = cairo_surface_reference (surface);
+    entry->size = cairo_image_surface_get_stride (surface) *
+                  cairo_image_surface_get_height (surface);
+    entry->frame = rc->frame;
+    entry->link.data = entry;
+
+    g_hash_table_insert (rc->entries, &entry->key, entry);
+    g_queue_push_head_link (&rc->lru, &entry->link);
+    rc->size += entry->size;
+
+    rendercache_trim (rc);
+}
+
+static gboolean rendercache_scale_unused (const GuRenderKey* key,
+                                          gpointer user) {
+    /* Whole page renderings are placeholders valid for every scale */
+    return key->tile_x >= 0 && key->scale == *(gdouble*)user;
+}
+
+/**
+ * @brief Mark a scale as the one currently displayed, renderings of scales
+ * that dropped out of the RENDER_CACHE_SCALES most recent ones are removed
+ */
+void rendercache_use_scale (GuRenderCache* rc, gdouble scale) {
+    GList* link = NULL;
+
+    for (link = rc->scales.head; link; link = link->next) {
+        if (*(gdouble*)link->data == scale) break;
+    }
+    if (link) {
+        g_queue_unlink (&rc->scales, link);
+        g_queue_push_head_link (&rc->scales, link);
+        return;
+    }
+
+    g_queue_push_head (&rc->scales, g_new (gdouble, 1));
+    *(gdouble*)g_queue_peek_head (&rc->scales) = scale;
+    while (g_queue_get_length (&rc->scales) > RENDER_CACHE_SCALES) {
+        gdouble* old = g_queue_pop_tail (&rc->scales);
+        rc->evictions += rendercache_remove_matching (rc,
+                                         rendercache_scale_unused, old);
+        g_free (old);
+    }
+}
+
+void rendercache_new_frame (GuRenderCache* rc) {
+    rc->frame++;
+}
+
+void rendercache_set_max_size (GuRenderCache* rc, gsize max_size) {
+    rc->max_size = max_size;
+    rendercache_trim (rc);
+}
+
+guint rendercache_remove_matching (GuRenderCache* rc, GuRenderKeyFunc func,
+                                   gpointer user) {
+    GList* link = rc->lru.head;
+    guint n = 0;
+
+    while (link) {
+        RenderCacheEntry* entry = link->data;
+        link = link->next;
+
+        if (func (&entry->key, user)) {
+            rendercache_remove_entry (rc, entry);
+            n++;
+        }
+    }
+    return n;
+}
+
+void rendercache_clear (GuRenderCache* rc) {
+    g_queue_init (&rc->lru);
+    g_hash_table_remove_all (rc->entries);
+    rc->size = 0;
+}
+
+void rendercache_free (GuRenderCache* rc) {
+    rendercache_clear (rc);
+    g_hash_table_destroy (rc->entries);
+    g_queue_foreach (&rc->scales, (GFunc)g_free, NULL);
+    g_queue_clear (&rc->scales);
+    g_free (rc);
+}
+
+void rendercache_log_stats (GuRenderCache* rc) {
+    guint64 total = rc->hits + rc->misses;
+
+    slog (L_DEBUG, "Render cache: %u entries, %.1f/%.1f MiB, %" G_GUINT64_FORMAT
+                   " hits, %" G_GUINT64_FORMAT " misses (%.1f%%), %"
+                   G_GUINT64_FORMAT " evictions\n",
+                   g_hash_table_size (rc->entries),
+                   rc->size / 1048576.0, rc->max_size / 1048576.0,
+                   rc->hits, rc->misses,
+                   total ? 100.0 * rc->hits / total : 0.0, rc->evictions);
+}
+
+/**
+ * @brief Pixel rectangle covered by a tile at the given scale, a tile
+ * position of -1 covers the whole page
+ */
+void render_tile_rect (PopplerPage* ppage, gdouble scale, gint tile_x,
+                       gint tile_y, gint* x, gint* y, gint* width,
+                       gint* height) {
+    gdouble page_width, page_height;
+    gint full_width, full_height;
+
+    poppler_page_get_size (ppage, &page_width, &page_height);
+    full_width = page_width * scale;
+    full_height = page_height * scale;
+
+    if (tile_x < 0 || tile_y < 0) {
+        *x = *y = 0;
+        *width = full_width;
+        *height = full_height;
+    } else {
+        *x = tile_x * TILE_SIZE;
+        *y = tile_y * TILE_SIZE;
+        *width = MIN (TILE_SIZE, full_width - *x);
+        *height = MIN (TILE_SIZE, full_height - *y);
+    }
+}
+
+cairo_surface_t* render_tile (PopplerPage* ppage, gdouble scale,
+                              gint x, gint y, gint width, gint height) {
+
+    cairo_surface_t* r = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                     width, height);
+    cairo_t *c = cairo_create (r);
+
+    cairo_translate (c, -x, -y);
+    cairo_scale (c, scale, scale);
+    poppler_page_render (ppage, c);
+
+    // Fill the transparent background of the page with white
+    cairo_set_operator (c, CAIRO_OPERATOR_DEST_OVER);
+    cairo_set_source_rgb (c, 1, 1, 1);
+    cairo_paint (c);
+    cairo_destroy (c);
+
+    return r;
+}
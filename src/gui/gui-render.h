@@ -0,0 +1,128 @@
+/**
+ * @file   gui-render.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_GUI_RENDER_H__
+#define __GUMMI_GUI_RENDER_H__
+
+#include <glib.h>
+#include <cairo.h>
+#include <poppler.h>
+
+#define TILE_SIZE 256
+
+/* Number of zoom levels the render cache holds on to at the same time */
+#define RENDER_CACHE_SCALES 3
+
+#define GU_RENDER_POOL(x) ((GuRenderPool*)(x))
+#define GU_RENDER_CACHE(x) ((GuRenderCache*)(x))
+typedef struct _GuRenderKey GuRenderKey;
+typedef struct _GuRenderPool GuRenderPool;
+typedef struct _GuRenderJob GuRenderJob;
+typedef struct _GuRenderCache GuRenderCache;
+
+typedef void (*GuRenderFunc) (GuRenderJob* job, gpointer user);
+typedef gboolean (*GuRenderKeyFunc) (const GuRenderKey* key, gpointer user);
+
+/* A tile position of -1 stands for a rendering of the complete page */
+struct _GuRenderKey {
+    gint page;
+    gint tile_x;
+    gint tile_y;
+    gdouble scale;
+    guint revision;
+};
+
+struct _GuRenderJob {
+    GuRenderPool* pool;
+    gchar* uri;
+    guint generation;
+    gint epoch;
+
+    GuRenderKey key;
+    gint priority;
+
+    cairo_surface_t* surface;
+};
+
+struct _GuRenderPool {
+    GThreadPool* threads;
+    GHashTable* pending;
+
+    gchar* uri;
+    guint generation;
+    gint epoch;
+
+    GuRenderFunc done;
+    gpointer user;
+};
+
+struct _GuRenderCache {
+    GHashTable* entries;
+    GQueue lru;
+    GQueue scales;
+
+    gsize size;
+    gsize max_size;
+    guint frame;
+
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+};
+
+guint render_key_hash (gconstpointer key);
+gboolean render_key_equal (gconstpointer a, gconstpointer b);
+
+GuRenderPool* renderpool_new (gint n_workers, GuRenderFunc done, gpointer user);
+void renderpool_set_document (GuRenderPool* rp, const gchar* uri);
+void renderpool_invalidate (GuRenderPool* rp);
+gboolean renderpool_request (GuRenderPool* rp, const GuRenderKey* key,
+                             gint priority);
+
+GuRenderCache* rendercache_new (gsize max_size);
+cairo_surface_t* rendercache_lookup (GuRenderCache* rc, const GuRenderKey* key);
+gboolean rendercache_contains (GuRenderCache* rc, const GuRenderKey* key);
+void rendercache_insert (GuRenderCache* rc, const GuRenderKey* key,
+                         cairo_surface_t* surface);
+void rendercache_use_scale (GuRenderCache* rc, gdouble scale);
+void rendercache_new_frame (GuRenderCache* rc);
+void rendercache_set_max_size (GuRenderCache* rc, gsize max_size);
+guint rendercache_remove_matching (GuRenderCache* rc, GuRenderKeyFunc func,
+                                   gpointer user);
+void rendercache_clear (GuRenderCache* rc);
+void rendercache_free (GuRenderCache* rc);
+void rendercache_log_stats (GuRenderCache* rc);
+
+cairo_surface_t* render_tile (PopplerPage* ppage, gdouble scale,
+                              gint x, gint y, gint width, gint height);
+void render_tile_rect (PopplerPage* ppage, gdouble scale, gint tile_x,
+                       gint tile_y, gint* x, gint* y, gint* width,
+                       gint* height);
+
+#endif /* __GUMMI_GUI_RENDER_H__ */
@@ -174,6 +174,7 @@ void snippetsgui_update_snippet (GuSnippets* sc) {
 
     g_free (target->first);
     target->first = g_strdup_printf("%s,%s,%s", new_key, new_accel, configs[2]);
+    snippets_invalidate (sc);
     gtk_list_store_set (s->list_snippets, &iter, 0, configs[2],
                                                  1, new_key,
                                                  2, new_accel, -1);
@@ -287,6 +288,7 @@ void on_button_remove_snippet_clicked (GtkWidget* widget, void* user) {
             config = g_strdup_printf ("%s,%s,%s", key, accel, name);
             target = slist_find (gummi->snippets->head, config, FALSE, FALSE);
             slist_remove (gummi->snippets->head, target);
+            snippets_invalidate (gummi->snippets);
         }
         /* Disconnect accelerator */
         if (key) snippets_accel_disconnect (gummi->snippets, key);
@@ -406,9 +408,12 @@ void on_snippets_tree_view_cursor_changed (GtkTreeView* view, void* user) {
         config = g_strdup_printf ("%s,%s,%s", key, accel, name);
         s->current = slist_find (gummi->snippets->head, config, FALSE, FALSE);
 
+        /* Rows without a tab trigger are not in the lookup table */
         snippet = snippets_get_value (gummi->snippets, key);
+        if (!snippet && s->current) snippet = s->current->second;
 
-        gtk_text_buffer_set_text (GTK_TEXT_BUFFER (s->buffer), snippet, -1);
+        gtk_text_buffer_set_text (GTK_TEXT_BUFFER (s->buffer),
+                                  snippet? snippet: "", -1);
         gtk_entry_set_text (s->tab_trigger_entry, key);
         gtk_entry_set_text (s->accelerator_entry, accel);
 
@@ -462,6 +467,7 @@ gboolean on_snippet_source_buffer_key_release (GtkWidget* widget, void* user) {
     gchar* text = gtk_text_iter_get_text (&start, &end);
     g_free (s->current->second);
     s->current->second = g_strdup (text);
+    snippets_invalidate (gummi->snippets);
     g_free (text);
     return FALSE;
 }
@@ -70,6 +70,8 @@ struct _GuTabContext {
 
     gdouble scroll_x;
     gdouble scroll_y;
+
+    GuPreviewSession* preview;  // parked while another tab is shown
 };
 
 #define GU_TABMANAGER_GUI(x) ((GuTabmanagerGui*)x)
@@ -43,60 +43,190 @@
 #include "editor.h"
 #include "environment.h"
 #include "external.h"
+#include "gui/gui-prefs.h"
 #include "gui/gui-preview.h"
+#include "motion.h"
+#include "snapshot.h"
 #include "utils.h"
 
+#include "compile/auxcache.h"
+#include "compile/depgraph.h"
 #include "compile/rubber.h"
 #include "compile/latexmk.h"
+#include "compile/preformat.h"
 #include "compile/texlive.h"
 
 extern Gummi* gummi;
+extern GummiGui* gui;
 
-GuLatex* latex_init (void) {
-    GuLatex* l = g_new0 (GuLatex, 1);
-    l->compilelog = NULL;
-    l->modified_since_compile = FALSE;
+static const gchar* const latex_programs[] = {
+    C_LATEX, C_PDFLATEX, C_XELATEX, C_LUALATEX, C_RUBBER, C_LATEXMK, NULL
+};
+
+/* The versions of the typesetters are known, runs on the main thread */
+static void latex_programs_probed (gpointer user) {
+    GuLatex* l = GU_LATEX (user);
 
     l->tex_version = texlive_init ();
     rubber_init ();
     latexmk_init ();
+
+    if (gui && gui->prefsgui)
+        prefsgui_update_typesetters (gui->prefsgui);
+    // the menu was set up assuming SyncTeX support
+    if (gui && l->tex_version < 2008)
+        gtk_widget_set_sensitive (GTK_WIDGET (gui->menu_autosync), FALSE);
+}
+
+GuLatex* latex_init (void) {
+    GuLatex* l = g_new0 (GuLatex, 1);
+
+    l->tex_version = -1;
+    external_probe_start (latex_programs, latex_programs_probed, l);
+    preformat_init ();
+    auxcache_init ();
     return l;
 }
 
 
 
 gboolean latex_method_active (gchar* method) {
-    return config_value_as_str_equals ("Compile", "steps", method);
+    return STR_EQU (config_hot.steps, method);
 }
 
-gchar* latex_update_workfile (GuEditor* ec) {
-    gchar *text;
-
-    text = editor_grab_buffer (ec);
+/**
+ * @brief Write a snapshot of ec to its workfile, from any thread
+ */
+gboolean latex_write_workfile (GuEditor* ec, GuSnapshot* snap) {
+    static GMutex workfile_mutex;
+    gboolean ok = TRUE;
 
     // bit of a dirty hack, but only write the buffer content when
     // there is not a recovery in progress, otherwise the workfile
     // will be overwritten with empty text
-    if (!STR_EQU (text, "")) {
-        utils_set_file_contents (ec->workfile, text, -1);
+    if (snap->length == 0) return TRUE;
+
+    g_mutex_lock (&workfile_mutex);
+    // cursor movement, undo back to the written state, ..
+    if (!STR_EQU (snap->checksum, ec->workfile_hash) ||
+        !g_file_test (ec->workfile, G_FILE_TEST_EXISTS)) {
+        if ((ok = snapshot_write (snap, ec->workfile))) {
+            g_free (ec->workfile_hash);
+            ec->workfile_hash = g_strdup (snap->checksum);
+        }
     }
-    return text;
+    g_mutex_unlock (&workfile_mutex);
+    return ok;
+}
+
+gboolean latex_update_workfile (GuEditor* ec) {
+    guint64 revision = gummi->motion? motion_get_revision (gummi->motion): 0;
+    GuSnapshot* snap = editor_publish_snapshot (ec, revision);
+    gboolean ok = latex_write_workfile (ec, snap);
+
+    snapshot_unref (snap);
+    return ok;
+}
+
+/* Identifies everything a compile run depends on that can change between
+ * two runs without the typesetter telling us */
+static gchar* latex_input_hash (GuEditor* ec, const gchar* command,
+                                const gchar* depends) {
+    GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    gchar* hash = NULL;
+
+    g_checksum_update (checksum, (const guchar*)ec->workfile, -1);
+    if (ec->workfile_hash)
+        g_checksum_update (checksum, (const guchar*)ec->workfile_hash, -1);
+    g_checksum_update (checksum, (const guchar*)command, -1);
+    g_checksum_update (checksum, (const guchar*)depends, -1);
+    hash = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+    return hash;
+}
+
+/**
+ * @brief The root document ec is built through, NULL if it is built alone
+ *
+ * Tabs that were opened with a project are typeset through the root file
+ * of the project. This needs the texlive pdf route, the other routes don't
+ * take a jobname, and env to hand over TEXINPUTS.
+ */
+const gchar* latex_project_root (GuEditor* ec) {
+    GuProject* project = gummi? gummi->project: NULL;
+
+#ifdef WIN32
+    return NULL;
+#else
+    if (!ec->projfile || !project || !project->rootfile) return NULL;
+    if (rubber_active () || latexmk_active () ||
+        !STR_EQU (config_hot.steps, "texpdf"))
+        return NULL;
+    if (!g_file_test (project->rootfile, G_FILE_TEST_EXISTS)) return NULL;
+    return project->rootfile;
+#endif
+}
+
+/* Names that can go into \includeonly{..}\input{..} on the command line */
+static gboolean latex_plain_name (const gchar* name) {
+    return !strpbrk (name, " \t{}%#\\\"$`'~&");
+}
+
+/* The root document, with unsaved text of open project files coming from
+ * an overlay in front of TEXINPUTS. Output is named after ec as usual */
+static gchar* latex_project_cmd (GuEditor* ec, const gchar* root) {
+    gchar* rootname = g_path_get_basename (root);
+    gchar* overlay = g_strconcat (ec->jobfile, ".texinputs", NULL);
+    gchar* auxfile = g_strconcat (ec->jobfile, ".aux", NULL);
+    const gchar* chapter = NULL;
+    gchar* input = NULL;
+
+    depgraph_write_overlay (ec->deps, overlay);
+    depgraph_prepare_outdir (ec->deps, ec->builddir);
+
+    /* Only the chapter being edited, page and reference numbers of the
+     * others come from the .aux files of the last full build */
+    if (config_hot.includeonly && g_file_test (auxfile, G_FILE_TEST_EXISTS))
+        chapter = depgraph_included_as (ec->deps, ec->filename);
+    if (chapter && latex_plain_name (chapter) && latex_plain_name (rootname))
+        input = g_strdup_printf ("\\includeonly{%s}\\input{%s}",
+                                 chapter, rootname);
+    else
+        input = g_strdup (rootname);
+
+    gchar* texcmd = texlive_get_job_command (input, ec->jobfile);
+    gchar* combined = g_strdup_printf ("%s TEXINPUTS=\"%s%c\" %s", C_TEXSEC,
+                                       overlay, G_SEARCHPATH_SEPARATOR,
+                                       texcmd);
+    g_free (texcmd);
+    g_free (input);
+    g_free (auxfile);
+    g_free (overlay);
+    g_free (rootname);
+    return combined;
 }
 
 gchar* latex_set_compile_cmd (GuEditor* ec) {
 
-    const gchar* method = config_get_string ("Compile", "steps");
+    const gchar* method = config_hot.steps;
+    const gchar* root = latex_project_root (ec);
     gchar* combined = NULL;
     gchar* texcmd = NULL;
 
+    if (root && ec->deps) {
+        return latex_project_cmd (ec, root);
+    }
+
     if (rubber_active()) {
-        texcmd = rubber_get_command (method, ec->workfile);
+        texcmd = rubber_get_command (method, ec->workfile, ec->jobfile);
     }
     else if (latexmk_active()) {
-        texcmd = latexmk_get_command (method, ec->workfile, ec->basename);
+        texcmd = latexmk_get_command (method, ec->workfile, ec->jobfile);
     }
     else {
-        texcmd = texlive_get_command (method, ec->workfile, ec->basename);
+        /* a preamble format only makes it faster, see
+         * latex_update_pdffile */
+        texcmd = texlive_get_command (method, ec->workfile, ec->jobfile);
     }
 
     combined = g_strdup_printf("%s %s", C_TEXSEC, texcmd);
@@ -105,19 +235,13 @@ gchar* latex_set_compile_cmd (GuEditor* ec) {
     return combined;
 }
 
-gchar* latex_analyse_log (gchar* log, gchar* filename, gchar* basename) {
+gchar* latex_analyse_log (gchar* log, gchar* jobfile) {
     /* Rubber does not post the pdftex compilation output to tty, so we will
      * have to open the log file and retrieve it I guess */
     if (rubber_active()) {
-        gchar* logpath = NULL;
-        if (filename == NULL) {
-            logpath = g_strconcat (basename, ".log", NULL);
-        }
-        else {
-            logpath = g_strconcat (C_TMPDIR, C_DIRSEP,
-                                   g_path_get_basename(basename), ".log", NULL);
-        }
+        gchar* logpath = g_strconcat (jobfile, ".log", NULL);
         g_file_get_contents (logpath, &log, NULL, NULL);
+        g_free (logpath);
     }
     return log;
 }
@@ -125,72 +249,193 @@ gchar* latex_analyse_log (gchar* log, gchar* filename, gchar* basename) {
 
 
 
-void latex_analyse_errors (GuLatex* lc) {
-    gchar* result = NULL;
+/* Runs in the compile thread while the typesetter is still writing */
+static void latex_parse_log_line (const gchar* line, gpointer user) {
+    // Batch builds have no tabs to tag the errors in
+    if (logparser_feed_line (GU_EDITOR (user)->log, line) && gui) {
+        gdk_threads_add_idle (on_document_error_found, user);
+    }
+}
+
+/* Moves the output of a finished compile from the staging directory to
+ * where the preview reads it. Each file is replaced in one rename, a pdf
+ * that is being loaded keeps reading the previous generation. SyncTeX data
+ * goes first, so that it is never older than the pdf next to it */
+static gboolean latex_publish_output (GuEditor* ec) {
+    const gchar* exts[] = { ".synctex.gz", ".synctex", ".pdf", NULL };
+    gint len = strlen (ec->pdffile) - strlen (".pdf");
     GError* err = NULL;
-    GRegex* match_str = NULL;
-    GMatchInfo* match_info;
+    gboolean ok = TRUE;
+    gint i = 0;
+
+    for (i = 0; exts[i] && ok; ++i) {
+        gchar* staged = g_strconcat (ec->jobfile, exts[i], NULL);
+        gchar* dest = g_strdup_printf ("%.*s%s", len, ec->pdffile, exts[i]);
+        /* synctex files of runs before it was switched off linger */
+        gboolean wanted = config_hot.synctex || STR_EQU (exts[i], ".pdf");
+
+        if (wanted && g_file_test (staged, G_FILE_TEST_EXISTS)) {
+            ok = utils_publish_file (staged, dest, &err);
+        } else if (STR_EQU (exts[i], ".pdf")) {
+            g_set_error (&err, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                         "%s is missing", staged);
+            ok = FALSE;
+        } else {
+            g_remove (dest);
+        }
+        g_free (staged);
+        g_free (dest);
+    }
 
-    if (! (match_str = g_regex_new (":(\\d+):", G_REGEX_DOTALL, 0, &err))) {
-        slog (L_ERROR, "g_regex_new (): %s\n", err->message);
+    if (err) {
+        slog (L_ERROR, "unable to publish the output of %s: %s\n",
+                       ec->jobfile, err->message);
         g_error_free (err);
-        return;
     }
+    if (ok) {
+        slog (L_DEBUG, "Published generation %d of %s\n",
+                       g_atomic_int_add (&ec->generation, 1) + 1,
+                       ec->pdffile);
+    }
+    return ok;
+}
 
-    if (lc->compilelog == NULL) printf("null\n");
-
-    if (g_regex_match (match_str, lc->compilelog, 0, &match_info)) {
-        gint count = 0;
-        while (g_match_info_matches (match_info)) {
-            if (count + 1 == BUFSIZ) break;
-            result = g_match_info_fetch (match_info, 1);
-            lc->errorlines[count++] = atoi (result);
-            g_free (result);
-            g_match_info_next (match_info, NULL);
-        }
+static gboolean latex_fallback_typesetter (gpointer user) {
+    if (!external_exists (config_hot.typesetter)) {
+        slog (L_WARNING, "%s is not installed, using pdflatex\n",
+                         config_hot.typesetter);
+        config_set_string ("Compile", "typesetter", "pdflatex");
     }
-    if (!lc->errorlines[0])
-        lc->errorlines[0] = -1;
-    g_match_info_free (match_info);
-    g_regex_unref (match_str);
+    return FALSE;
 }
 
 gboolean latex_update_pdffile (GuLatex* lc, GuEditor* ec) {
-    static glong cerrors = 0;
-    gchar* basename = ec->basename;
     gchar* filename = ec->filename;
+    gint niceness = 0;
 
-    if (!lc->modified_since_compile) return cerrors == 0;
+    if (!g_atomic_int_get (&ec->modified_since_compile))
+        return ec->cstatus == 0;
 
-    const gchar* typesetter = config_get_string ("Compile", "typesetter");
-    if (!external_exists (typesetter)) {
-        // Set to default first detected typesetter
-        config_set_string ("Compile", "typesetter", "pdflatex");
+    /* The backends fall back to pdflatex for this compile already, see
+     * external_typesetter; config_hot only changes on the main thread */
+    if (!external_exists (config_hot.typesetter)) {
+        gdk_threads_add_idle (latex_fallback_typesetter, NULL);
     }
 
+    /* Figures, bibliographies and other project files count as input */
+    const gchar* root = latex_project_root (ec);
+    if (!ec->deps) ec->deps = depgraph_new ();
+    const gchar* depends = depgraph_update (ec->deps, root? root:
+                                   (filename? filename: ec->workfile));
+
     /* create compile command */
-    gchar* curdir = g_path_get_dirname (ec->workfile);
+    gchar* curdir = g_path_get_dirname (root? root: ec->workfile);
     gchar *command = latex_set_compile_cmd (ec);
+    gchar* input = latex_input_hash (ec, command, depends);
+
+    /* The buffer went back to what was compiled last, keep the pdf */
+    if (!ec->force_compile && STR_EQU (input, ec->compiled_hash) &&
+        g_file_test (ec->pdffile, G_FILE_TEST_EXISTS)) {
+        g_atomic_int_set (&ec->modified_since_compile, FALSE);
+        g_atomic_int_inc (&lc->n_skipped);
+        slog (L_DEBUG, "Input unchanged since the last compile, skipped "
+                       "(%d so far)\n", g_atomic_int_get (&lc->n_skipped));
+        g_free (input);
+        g_free (command);
+        g_free (curdir);
+        return TRUE;
+    }
+    ec->force_compile = FALSE;
+
+    /* Only runs that really happen dump a preamble format, the format
+     * leaves the output alone and stays out of the input hash */
+    if (!root && preformat_active ()) {
+        gchar* texcmd = preformat_get_command (config_hot.steps, ec);
+        if (texcmd) {
+            g_free (command);
+            command = g_strdup_printf ("%s %s", C_TEXSEC, texcmd);
+            g_free (texcmd);
+        }
+    }
+
+    /* Edits arriving while the typesetter runs mark the editor again */
+    g_atomic_int_set (&ec->modified_since_compile, FALSE);
+
+    /* Tabs in the background must not slow down the one being edited */
+    if (ec->job.niced)
+        niceness = config_hot.background_nice;
 
-    g_free (lc->compilelog);
-    memset (lc->errorlines, 0, BUFSIZ * sizeof(gint));
+    /* Previews are updated by the next edit instead, a second pass only
+     * delays them; rubber and latexmk do their own reruns */
+    gboolean may_rerun = ec->settle_refs &&
+                         !rubber_active () && !latexmk_active ();
+    gchar* auxhash = may_rerun? auxcache_aux_hash (ec): NULL;
+
+    g_free (ec->compilelog);
+    logparser_reset (ec->log, curdir);
+    gint64 started = g_get_monotonic_time ();
 
     /* run pdf compilation */
-    Tuple2 cresult = utils_popen_r (command, curdir);
-    cerrors = (glong)cresult.first;
+    Tuple2 cresult = utils_popen_r_lines (command, curdir,
+                                          latex_parse_log_line, ec,
+                                          motion_set_job_pid, niceness);
+    ec->cstatus = (glong)cresult.first;
     gchar* coutput = (gchar*)cresult.second;
 
-    lc->compilelog = latex_analyse_log (coutput, filename, basename);
-    lc->modified_since_compile = FALSE;
+    ec->compilelog = latex_analyse_log (coutput, ec->jobfile);
+
+    /* one more run when the cross references moved, so that they are
+     * right without waiting for the next edit */
+    if (may_rerun && ec->cstatus == 0 &&
+        auxcache_rerun_needed (ec, auxhash, ec->compilelog)) {
+        slog (L_DEBUG, "cross references changed, typesetting again\n");
+        g_free (ec->compilelog);
+        logparser_reset (ec->log, curdir);
+        cresult = utils_popen_r_lines (command, curdir,
+                                       latex_parse_log_line, ec,
+                                       motion_set_job_pid, niceness);
+        ec->cstatus = (glong)cresult.first;
+        ec->compilelog = latex_analyse_log ((gchar*)cresult.second,
+                                            ec->jobfile);
+    }
+
+    /* the staging directory holds the pdf of the last run, failed ones
+     * included; only successful ones are shown */
+    if (ec->cstatus == 0 && !latex_publish_output (ec)) {
+        ec->cstatus = -1;
+    }
+    if (ec->cstatus == 0) {
+        auxcache_compiled (ec);
+    }
 
-    /* find error line */
-    if (cerrors && (g_utf8_strlen (lc->compilelog, -1) != 0)) {
-        latex_analyse_errors (lc);
+    /* Read by the compile delay, see debounce_delay. Niced runs are slowed
+     * down by whatever they give way to */
+    if (ec->cstatus == 0 && !ec->job.niced) {
+        gint ms = (g_get_monotonic_time () - started) / 1000;
+        gint average = g_atomic_int_get (&ec->compile_ms);
+        g_atomic_int_set (&ec->compile_ms,
+                          average? (3 * average + ms) / 4: ms);
     }
 
+    g_free (ec->compiled_hash);
+    ec->compiled_hash = (ec->cstatus == 0)? input: NULL;
+    if (ec->cstatus != 0) g_free (input);
+
+    /* Rubber does not pass the typesetter output through */
+    if (rubber_active () && ec->compilelog) {
+        logparser_reset (ec->log, curdir);
+        logparser_feed_text (ec->log, ec->compilelog);
+    }
+    logparser_finish (ec->log);
+
+    ec->errors = ec->cstatus && ec->compilelog &&
+                 g_utf8_strlen (ec->compilelog, -1) != 0;
+
     g_free (command);
+    g_free (curdir);
+    g_free (auxhash);
 
-    return cerrors == 0;
+    return ec->cstatus == 0;
 }
 
 void latex_update_auxfile (GuEditor* ec) {
@@ -200,29 +445,24 @@ void latex_update_auxfile (GuEditor* ec) {
                                       "-interaction=nonstopmode "
                                       "--output-directory=\"%s\" \"%s\"",
                                       C_TEXSEC,
-                                      config_get_string ("Compile", "typesetter"),
-                                      C_TMPDIR,
+                                      external_typesetter (),
+                                      ec->builddir,
                                       ec->workfile);
     Tuple2 res = utils_popen_r (command, dirname);
+    if ((glong)res.first == 0) {
+        auxcache_compiled (ec);
+    }
     g_free (dirname);
     g_free (res.second);
     g_free (command);
 }
 
 int latex_remove_auxfile (GuEditor* ec) {
-    gchar* auxfile = NULL;
+    gchar* auxfile = g_strconcat (ec->jobfile, ".aux", NULL);
     int res = -1;
-    // TODO: merge this into function with several other instances.
-    // for instance the lines in analyse_log
-    if (ec->filename == NULL) {
-        auxfile = g_strconcat (ec->basename, ".aux", NULL);
-    }
-    else {
-        auxfile = g_strconcat (C_TMPDIR, C_DIRSEP,
-                  g_path_get_basename(ec->basename), ".aux", NULL);
-        }
 
     // TODO: extend for other build files
+    auxcache_clear (ec);
     if (g_file_test (auxfile, G_FILE_TEST_EXISTS)) {
         res = g_remove (auxfile);
     }
@@ -230,7 +470,7 @@ int latex_remove_auxfile (GuEditor* ec) {
     return res;
 }
 
-gboolean latex_precompile_check (gchar* editortext) {
+gboolean latex_precompile_check (GuSnapshot* snap) {
     /* both documentclass and documentstyle appear to be valid.
      * http://pangea.stanford.edu/computing/unix/formatting/parts.php
      * TOD: Improve and add document scan tags and make compatible with
@@ -238,9 +478,9 @@ gboolean latex_precompile_check (gchar* editortext) {
 
     // TODO: see issue #269
 
-    gboolean class = utils_subinstr("\\documentclass", editortext, FALSE);
-    gboolean style = utils_subinstr("\\documentstyle", editortext, FALSE);
-    gboolean input = utils_subinstr("\\input", editortext, FALSE);
+    gboolean class = snapshot_contains (snap, "\\documentclass");
+    gboolean style = snapshot_contains (snap, "\\documentstyle");
+    gboolean input = snapshot_contains (snap, "\\input");
 
     return (class || style || input);
 }
@@ -275,22 +515,31 @@ void latex_export_pdffile (GuLatex* lc, GuEditor* ec, const gchar* path,
 gboolean latex_run_makeindex (GuEditor* ec) {
     int retcode = 1;
 
+    if (!auxcache_pass_needed (ec, "makeindex")) {
+        return TRUE;
+    }
+
     if (g_find_program_in_path ("makeindex")) {
 
+        gchar* jobname = g_path_get_basename (ec->jobfile);
         gchar* command = g_strdup_printf ("%s makeindex \"%s.idx\"",
-                                          C_TEXSEC,
-                                          g_path_get_basename(ec->basename));
+                                          C_TEXSEC, jobname);
 
-        Tuple2 res = utils_popen_r (command, C_TMPDIR);
+        Tuple2 res = utils_popen_r (command, ec->builddir);
+        g_free (jobname);
         retcode = (glong)res.first;
         g_free (command);
     }
-    if (retcode == 0) return TRUE;
+    if (retcode == 0) {
+        auxcache_pass_done (ec, "makeindex");
+        return TRUE;
+    }
     return FALSE;
 }
 
 gboolean latex_can_synctex (void) {
-    if (gummi->latex->tex_version >= 2008) {
+    // Until the probes answer it is assumed, early compiles keep SyncTeX
+    if (gummi->latex->tex_version < 0 || gummi->latex->tex_version >= 2008) {
         return TRUE;
     }
     return FALSE;
@@ -298,10 +547,9 @@ gboolean latex_can_synctex (void) {
 
 
 gboolean latex_use_synctex (void) {
-    return (config_get_boolean ("Compile", "synctex") &&
-            config_get_boolean ("Preview", "autosync"));
+    return (config_hot.synctex && config_hot.autosync);
 }
 
 gboolean latex_use_shellescaping (void) {
-    return config_get_boolean ("Compile", "shellescape");
+    return config_hot.shellescape;
 }
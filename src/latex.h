@@ -33,6 +33,7 @@
 #include <glib.h>
 
 #include "editor.h"
+#include "logparser.h"
 #include "gui/gui-preview.h"
 
 #define GU_LATEX(x) ((GuLatex*)x)
@@ -40,19 +41,18 @@ typedef struct _GuLatex GuLatex;
 
 struct _GuLatex {
     gchar* typesetter;
-    /* use fixed size for errorlines in consider of performance */
-    gint errorlines[BUFSIZ];
-    gchar* compilelog;
-    gboolean modified_since_compile;
+    gint n_skipped;     /* compiles skipped for unchanged input */
 
-    int tex_version;
+    int tex_version;    /* -1 until the typesetters are probed */
 
 };
 
 GuLatex* latex_init (void);
-gboolean latex_precompile_check (gchar* editortext);
-gchar* latex_update_workfile (GuEditor* ec);
+gboolean latex_precompile_check (GuSnapshot* snap);
+gboolean latex_write_workfile (GuEditor* ec, GuSnapshot* snap);
+gboolean latex_update_workfile (GuEditor* ec);
 gboolean latex_update_pdffile (GuLatex* lc, GuEditor* ec);
+const gchar* latex_project_root (GuEditor* ec);
 void latex_update_auxfile (GuEditor* ec);
 void latex_export_pdffile (GuLatex* lc, GuEditor* ec, const gchar* path,
         gboolean prompt_overrite);
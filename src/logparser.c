@@ -0,0 +1,439 @@
+/**
+ * @file   logparser.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logparser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "utils.h"
+
+/* The typesetter output is parsed while it is being produced. TeX reports
+ * the file it reads by printing "(filename" and a ")" when it is done with
+ * it, the stack of open files is what attributes a message without a
+ * file:line: prefix to a source file. Lines that hold messages are never
+ * used for tracking parentheses as they frequently contain unbalanced
+ * ones. On unix C_TEXSEC raises max_print_line, elsewhere lines that TeX
+ * broke at 79 columns are joined before they are parsed. */
+
+#ifdef WIN32
+#   define LOG_WRAP_COLUMN 79
+#else
+#   define LOG_WRAP_COLUMN 0
+#endif
+
+static void logparser_entry_clear (gpointer data) {
+    GuLogEntry* entry = GU_LOG_ENTRY (data);
+    g_free (entry->file);
+    g_free (entry->message);
+    g_free (entry->package);
+}
+
+GuLogParser* logparser_new (void) {
+    GuLogParser* lp = g_new0 (GuLogParser, 1);
+
+    lp->entries = g_array_new (FALSE, TRUE, sizeof (GuLogEntry));
+    g_array_set_clear_func (lp->entries, logparser_entry_clear);
+    lp->files = g_ptr_array_new_with_free_func (g_free);
+    lp->wrapped = g_string_new (NULL);
+    lp->wrap_column = LOG_WRAP_COLUMN;
+    lp->continued = -1;
+    lp->awaiting_line = -1;
+
+    lp->file_line = g_regex_new ("^((?:[A-Za-z]:)?[^:]+):(\\d+): (.*)$",
+                                 G_REGEX_OPTIMIZE, 0, NULL);
+    lp->warning = g_regex_new ("^(LaTeX|Package|Class)(?: (\\S+))? "
+                               "Warning: (.*)$", G_REGEX_OPTIMIZE, 0, NULL);
+    lp->badbox = g_regex_new ("^(?:Over|Under)full \\\\[hv]box"
+                              "(?:.* at lines? (\\d+))?",
+                              G_REGEX_OPTIMIZE, 0, NULL);
+    lp->package_error = g_regex_new ("^(?:(?:Package|Class) (\\S+)|LaTeX) "
+                                     "Error: ", G_REGEX_OPTIMIZE, 0, NULL);
+    g_mutex_init (&lp->mutex);
+    return lp;
+}
+
+void logparser_free (GuLogParser* lp) {
+    g_array_free (lp->entries, TRUE);
+    g_ptr_array_free (lp->files, TRUE);
+    g_string_free (lp->wrapped, TRUE);
+    g_free (lp->basedir);
+    g_free (lp->continuation);
+    g_regex_unref (lp->file_line);
+    g_regex_unref (lp->warning);
+    g_regex_unref (lp->badbox);
+    g_regex_unref (lp->package_error);
+    g_mutex_clear (&lp->mutex);
+    g_free (lp);
+}
+
+void logparser_reset (GuLogParser* lp, const gchar* basedir) {
+    g_mutex_lock (&lp->mutex);
+    g_array_set_size (lp->entries, 0);
+    g_ptr_array_set_size (lp->files, 0);
+    g_string_truncate (lp->wrapped, 0);
+    g_free (lp->basedir);
+    lp->basedir = g_strdup (basedir);
+    g_free (lp->continuation);
+    lp->continuation = NULL;
+    lp->continued = -1;
+    lp->awaiting_line = -1;
+    lp->in_badbox = FALSE;
+    lp->n_lines = 0;
+    g_mutex_unlock (&lp->mutex);
+}
+
+/* Makes paths comparable, GFile resolves "." and ".." components. Project
+ * builds read open files through links to their workfiles, those are
+ * followed so that messages end up in the right tab */
+static gchar* logparser_canonical_path (const gchar* dir, const gchar* path) {
+    gchar* abspath = NULL;
+    gchar* result = NULL;
+    gchar* target = NULL;
+    GFile* file = NULL;
+
+    if (g_path_is_absolute (path)) {
+        abspath = g_strdup (path);
+    } else {
+        abspath = g_build_filename (dir ? dir : ".", path, NULL);
+    }
+    file = g_file_new_for_path (abspath);
+    result = g_file_get_path (file);
+    g_object_unref (file);
+    g_free (abspath);
+
+    if (g_file_test (result, G_FILE_TEST_IS_SYMLINK) &&
+        (target = g_file_read_link (result, NULL)) &&
+        g_path_is_absolute (target)) {
+        g_free (result);
+        return target;
+    }
+    g_free (target);
+    return result;
+}
+
+static gboolean logparser_is_file (const gchar* token) {
+    const gchar* ext = strrchr (token, '.');
+    const gchar* p = NULL;
+
+    if (token[0] == '\0' || g_ascii_isdigit (token[0])) return FALSE;
+    if (g_path_is_absolute (token) || g_str_has_prefix (token, "./") ||
+        g_str_has_prefix (token, "../"))
+        return TRUE;
+
+    /* Anything else needs to look like name.ext */
+    if (ext == NULL || ext == token || ext[1] == '\0' || strlen (ext) > 6)
+        return FALSE;
+    for (p = ext + 1; *p; p++) {
+        if (!g_ascii_isalnum (*p)) return FALSE;
+    }
+    return TRUE;
+}
+
+static gchar* logparser_current_file (GuLogParser* lp) {
+    gint i;
+
+    for (i = (gint)lp->files->len - 1; i >= 0; i--) {
+        if (g_ptr_array_index (lp->files, i))
+            return g_strdup (g_ptr_array_index (lp->files, i));
+    }
+    return NULL;
+}
+
+static void logparser_track_files (GuLogParser* lp, const gchar* line) {
+    const gchar* p = line;
+
+    while (*p) {
+        if (*p == '(') {
+            const gchar* start = ++p;
+            const gchar* end = NULL;
+            gchar* token = NULL;
+
+            /* Names with spaces are quoted by recent TeX versions */
+            if (*start == '"') {
+                start++;
+                if (!(end = strchr (start, '"'))) end = start + strlen (start);
+                p = *end ? end + 1 : end;
+            } else {
+                for (end = start; *end && !strchr (" ()[]{}<>", *end); end++);
+                p = end;
+            }
+            token = g_strndup (start, end - start);
+            g_ptr_array_add (lp->files, logparser_is_file (token) ?
+                    logparser_canonical_path (lp->basedir, token) : NULL);
+            g_free (token);
+        } else if (*p == ')') {
+            if (lp->files->len > 0)
+                g_ptr_array_remove_index (lp->files, lp->files->len - 1);
+            p++;
+        } else {
+            p++;
+        }
+    }
+}
+
+static gint logparser_add (GuLogParser* lp, GuLogSeverity severity,
+                           gchar* file, gint line, const gchar* message,
+                           const gchar* package) {
+    GuLogEntry entry;
+
+    entry.file = file;
+    entry.line = line;
+    entry.severity = severity;
+    entry.message = g_strdup (message);
+    entry.package = g_strdup (package);
+    g_array_append_val (lp->entries, entry);
+
+    slog (L_DEBUG, "log: %s:%d: %s\n", file ? file : "?", line, message);
+    return lp->entries->len - 1;
+}
+
+static gchar* logparser_error_package (GuLogParser* lp, const gchar* msg) {
+    GMatchInfo* match = NULL;
+    gchar* package = NULL;
+
+    if (g_regex_match (lp->package_error, msg, 0, &match)) {
+        package = g_match_info_fetch (match, 1);
+        if (STR_EQU (package, "")) {
+            g_free (package);
+            package = g_strdup ("LaTeX");
+        }
+    }
+    g_match_info_free (match);
+    return package;
+}
+
+/* LaTeX warnings end in "on input line <n>." */
+static void logparser_find_input_line (GuLogEntry* entry) {
+    const gchar* p = NULL;
+
+    if (entry->line == 0 && (p = strstr (entry->message, "input line ")))
+        entry->line = atoi (p + strlen ("input line "));
+}
+
+static void logparser_continue_message (GuLogParser* lp, const gchar* text) {
+    GuLogEntry* entry = &g_array_index (lp->entries, GuLogEntry,
+                                        lp->continued);
+    gchar* stripped = g_strstrip (g_strdup (text));
+    gchar* message = g_strconcat (entry->message, " ", stripped, NULL);
+
+    g_free (entry->message);
+    g_free (stripped);
+    entry->message = message;
+    logparser_find_input_line (entry);
+}
+
+static gboolean logparser_parse_line (GuLogParser* lp, const gchar* line) {
+    GMatchInfo* match = NULL;
+    gboolean error = FALSE;
+
+    /* The material of a bad box is printed up to the next empty line */
+    if (lp->in_badbox) {
+        lp->in_badbox = (*line != '\0');
+        return FALSE;
+    }
+
+    if (lp->continued >= 0) {
+        if (lp->continuation && *line &&
+            g_str_has_prefix (line, lp->continuation)) {
+            logparser_continue_message (lp, line + strlen (lp->continuation));
+            return FALSE;
+        }
+        g_free (lp->continuation);
+        lp->continuation = NULL;
+        lp->continued = -1;
+    }
+
+    /* "l.<n> <context>" tells where the previous error happened */
+    if (line[0] == 'l' && line[1] == '.' && g_ascii_isdigit (line[2])) {
+        if (lp->awaiting_line >= 0) {
+            g_array_index (lp->entries, GuLogEntry,
+                           lp->awaiting_line).line = atoi (line + 2);
+            lp->awaiting_line = -1;
+        }
+        return FALSE;
+    }
+
+    if (g_regex_match (lp->file_line, line, 0, &match)) {
+        gchar* file = g_match_info_fetch (match, 1);
+        gchar* num = g_match_info_fetch (match, 2);
+        gchar* msg = g_match_info_fetch (match, 3);
+        gchar* package = logparser_error_package (lp, msg);
+
+        logparser_add (lp, LOG_ERROR,
+                       logparser_canonical_path (lp->basedir, file),
+                       atoi (num), msg, package);
+        lp->awaiting_line = -1;
+        error = TRUE;
+        g_free (file);
+        g_free (num);
+        g_free (msg);
+        g_free (package);
+        goto done;
+    }
+    g_match_info_free (match);
+
+    if (g_str_has_prefix (line, "! ")) {
+        gchar* package = logparser_error_package (lp, line + 2);
+
+        lp->awaiting_line = logparser_add (lp, LOG_ERROR,
+                logparser_current_file (lp), 0, line + 2, package);
+        g_free (package);
+        return TRUE;
+    }
+
+    if (g_regex_match (lp->warning, line, 0, &match)) {
+        gchar* kind = g_match_info_fetch (match, 1);
+        gchar* name = g_match_info_fetch (match, 2);
+        gchar* msg = g_match_info_fetch (match, 3);
+        gboolean plain = STR_EQU (name, "");
+
+        lp->continued = logparser_add (lp, LOG_WARNING,
+                logparser_current_file (lp), 0, msg, plain ? kind : name);
+        logparser_find_input_line (&g_array_index (lp->entries, GuLogEntry,
+                                                   lp->continued));
+        /* Package and class warnings continue on lines that start with
+         * "(name)", plain LaTeX warnings on indented ones */
+        lp->continuation = plain ? g_strdup ("  ")
+                                 : g_strdup_printf ("(%s)", name);
+        g_free (kind);
+        g_free (name);
+        g_free (msg);
+        goto done;
+    }
+    g_match_info_free (match);
+
+    if (g_regex_match (lp->badbox, line, 0, &match)) {
+        gchar* num = g_match_info_fetch (match, 1);
+
+        logparser_add (lp, LOG_BADBOX, logparser_current_file (lp),
+                       num ? atoi (num) : 0, line, NULL);
+        lp->in_badbox = TRUE;
+        g_free (num);
+        goto done;
+    }
+
+    logparser_track_files (lp, line);
+
+done:
+    g_match_info_free (match);
+    return error;
+}
+
+gboolean logparser_feed_line (GuLogParser* lp, const gchar* line) {
+    gboolean error = FALSE;
+
+    g_mutex_lock (&lp->mutex);
+    lp->n_lines++;
+
+    if (lp->wrap_column > 0 && strlen (line) == (gsize)lp->wrap_column) {
+        g_string_append (lp->wrapped, line);
+    } else if (lp->wrapped->len > 0) {
+        g_string_append (lp->wrapped, line);
+        error = logparser_parse_line (lp, lp->wrapped->str);
+        g_string_truncate (lp->wrapped, 0);
+    } else {
+        error = logparser_parse_line (lp, line);
+    }
+
+    g_mutex_unlock (&lp->mutex);
+    return error;
+}
+
+void logparser_feed_text (GuLogParser* lp, const gchar* text) {
+    gchar** lines = g_strsplit (text, "\n", -1);
+    gint i;
+
+    for (i = 0; lines[i]; i++) {
+        g_strchomp (lines[i]);
+        logparser_feed_line (lp, lines[i]);
+    }
+    g_strfreev (lines);
+}
+
+void logparser_finish (GuLogParser* lp) {
+    g_mutex_lock (&lp->mutex);
+    if (lp->wrapped->len > 0) {
+        logparser_parse_line (lp, lp->wrapped->str);
+        g_string_truncate (lp->wrapped, 0);
+    }
+    g_ptr_array_set_size (lp->files, 0);
+    g_free (lp->continuation);
+    lp->continuation = NULL;
+    lp->continued = -1;
+    lp->awaiting_line = -1;
+    lp->in_badbox = FALSE;
+    g_mutex_unlock (&lp->mutex);
+}
+
+guint logparser_count (GuLogParser* lp, GuLogSeverity severity) {
+    guint i, count = 0;
+
+    g_mutex_lock (&lp->mutex);
+    for (i = 0; i < lp->entries->len; i++) {
+        if (g_array_index (lp->entries, GuLogEntry, i).severity == severity)
+            count++;
+    }
+    g_mutex_unlock (&lp->mutex);
+    return count;
+}
+
+guint logparser_lines_seen (GuLogParser* lp) {
+    guint n = 0;
+
+    g_mutex_lock (&lp->mutex);
+    n = lp->n_lines;
+    g_mutex_unlock (&lp->mutex);
+    return n;
+}
+
+gint* logparser_get_lines (GuLogParser* lp, const gchar* path,
+                           GuLogSeverity severity) {
+    GArray* lines = g_array_new (TRUE, TRUE, sizeof (gint));
+    gchar* canonical = NULL;
+    guint i;
+
+    if (path == NULL) return (gint*)g_array_free (lines, FALSE);
+    canonical = logparser_canonical_path (NULL, path);
+
+    g_mutex_lock (&lp->mutex);
+    for (i = 0; i < lp->entries->len; i++) {
+        GuLogEntry* entry = &g_array_index (lp->entries, GuLogEntry, i);
+        if (entry->severity == severity && entry->line > 0 &&
+            STR_EQU (entry->file, canonical))
+            g_array_append_val (lines, entry->line);
+    }
+    g_mutex_unlock (&lp->mutex);
+
+    g_free (canonical);
+    return (gint*)g_array_free (lines, FALSE);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file   logparser.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_LOGPARSER_H__
+#define __GUMMI_LOGPARSER_H__
+
+#include <glib.h>
+
+typedef enum {
+    LOG_ERROR = 0,
+    LOG_WARNING,
+    LOG_BADBOX
+} GuLogSeverity;
+
+#define GU_LOG_ENTRY(x) ((GuLogEntry*)x)
+typedef struct _GuLogEntry GuLogEntry;
+
+struct _GuLogEntry {
+    gchar* file;        /* canonical path, NULL when unknown */
+    gint line;          /* 0 when unknown */
+    GuLogSeverity severity;
+    gchar* message;
+    gchar* package;     /* "LaTeX" or the package/class name, NULL for TeX */
+};
+
+#define GU_LOG_PARSER(x) ((GuLogParser*)x)
+typedef struct _GuLogParser GuLogParser;
+
+struct _GuLogParser {
+    GArray* entries;        /* GuLogEntry */
+    GPtrArray* files;       /* open file stack, NULL for other parentheses */
+    gchar* basedir;         /* relative file names are resolved against it */
+
+    GString* wrapped;       /* line broken by TeX at wrap_column */
+    gint wrap_column;
+    gint continued;         /* entry whose message continues, or -1 */
+    gchar* continuation;    /* prefix of its continuation lines */
+    gint awaiting_line;     /* error entry waiting for "l.<n>", or -1 */
+    gboolean in_badbox;     /* skipping the box contents of a bad box */
+
+    guint n_lines;
+    GRegex* file_line;
+    GRegex* warning;
+    GRegex* badbox;
+    GRegex* package_error;
+    GMutex mutex;
+};
+
+GuLogParser* logparser_new (void);
+void logparser_free (GuLogParser* lp);
+void logparser_reset (GuLogParser* lp, const gchar* basedir);
+
+/**
+ * logparser_feed_line:
+ *
+ * Returns: TRUE if the line added an error to the parser
+ *
+ * Parses one line of typesetter output, may be called from any thread.
+ */
+gboolean logparser_feed_line (GuLogParser* lp, const gchar* line);
+void logparser_feed_text (GuLogParser* lp, const gchar* text);
+void logparser_finish (GuLogParser* lp);
+guint logparser_count (GuLogParser* lp, GuLogSeverity severity);
+guint logparser_lines_seen (GuLogParser* lp);
+
+/**
+ * logparser_get_lines:
+ *
+ * Returns: A newly allocated, zero terminated array of the line numbers of
+ * all entries of the given severity in the file at path
+ */
+gint* logparser_get_lines (GuLogParser* lp, const gchar* path,
+                           GuLogSeverity severity);
+
+#endif /* __GUMMI_LOGPARSER_H__ */
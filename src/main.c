@@ -36,6 +36,7 @@
 #include <string.h>
 
 #include "biblio.h"
+#include "build.h"
 #include "configfile.h"
 #include "constants.h"
 #include "environment.h"
@@ -54,12 +55,19 @@ extern Gummi* gummi;
 extern GummiGui* gui;
 static int debug = 0;
 static int showversion = 0;
+static int build = 0;
+static int jobs = 0;
 
 static GOptionEntry entries[] = {
     { (const gchar*)"debug", (gchar)'d', 0, G_OPTION_ARG_NONE,
         &debug, (gchar*)"show debug info", NULL},
     { (const gchar*)"version", (gchar)'v', 0, G_OPTION_ARG_NONE,
         &showversion, (gchar*)"show version and exit", NULL},
+    { (const gchar*)"build", (gchar)'b', 0, G_OPTION_ARG_NONE,
+        &build, (gchar*)"typeset the files without opening a window", NULL},
+    { (const gchar*)"jobs", (gchar)'j', 0, G_OPTION_ARG_INT,
+        &jobs, (gchar*)"number of files to build at the same time "
+                       "(default: one per processor)", (gchar*)"N"},
     { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
 };
 
@@ -80,6 +88,13 @@ int main (int argc, char *argv[]) {
         return 0;
     }
 
+    // Batch builds never touch the display
+    if (build) {
+        slog_init (debug);
+        config_init ();
+        return build_run (argv + 1, jobs);
+    }
+
     // Initialize GTK
     gdk_threads_init ();
     gtk_init (&argc, &argv);
@@ -166,5 +181,6 @@ int main (int argc, char *argv[]) {
 
     gui_main (builder);
     config_save ();
+    config_clean_up ();
     return 0;
 }
@@ -53,100 +53,369 @@
 #include "gui/gui-preview.h"
 #include "latex.h"
 #include "snippets.h"
+#include "snapshot.h"
 #include "utils.h"
 
 extern GummiGui* gui;
 extern Gummi* gummi;
 
-/* Typesetter pid */
-pid_t typesetter_pid = 0;
-
 GuMotion* motion_init (void) {
     GuMotion* m = g_new0 (GuMotion, 1);
 
     m->key_press_timer = 0;
+    m->debounce = debounce_new ();
     g_mutex_init(&m->signal_mutex);
-    g_mutex_init(&m->compile_mutex);
     g_cond_init(&m->compile_cv);
-    m->keep_running = TRUE;
+    g_cond_init(&m->job_done_cv);
     m->keep_running = FALSE;
-    m->typesetter_pid = &typesetter_pid;
+
+    /* One worker is kept for the active tab */
+    m->n_workers = CLAMP (g_get_num_processors (), 1, MOTION_MAX_WORKERS);
+    slog (L_DEBUG, "Using %u compile workers\n", m->n_workers);
 
     return m;
 }
 
+static void motion_signal_typesetter (GuMotion* m, GuEditor* ec);
+static gboolean motion_finish_job (GuMotion* mc, GuEditor* ec);
+
 void motion_start_compile_thread (GuMotion* m) {
+    guint i;
+
+    g_mutex_lock (&m->signal_mutex);
     m->keep_running = TRUE;
-    m->compile_thread = g_thread_new ("motion", motion_compile_thread, m);
+    g_mutex_unlock (&m->signal_mutex);
+    for (i = 0; i < m->n_workers; ++i)
+        m->workers[i] = g_thread_new ("motion", motion_compile_thread, m);
 }
 
 void motion_stop_compile_thread (GuMotion* m) {
     L_F_DEBUG;
+    guint i;
 
+    g_mutex_lock (&m->signal_mutex);
     m->keep_running = FALSE;
-    motion_do_compile(m);
-    g_thread_join(m->compile_thread);
+    g_cond_broadcast (&m->compile_cv);
+    g_mutex_unlock (&m->signal_mutex);
+    for (i = 0; i < m->n_workers; ++i) {
+        if (m->workers[i]) g_thread_join (m->workers[i]);
+        m->workers[i] = NULL;
+    }
 }
 
 void motion_pause_compile_thread (GuMotion* m) {
     L_F_DEBUG;
 
+    g_mutex_lock (&m->signal_mutex);
     m->pause = TRUE;
-    motion_do_compile(m);
+    g_mutex_unlock (&m->signal_mutex);
 }
 
 void motion_resume_compile_thread (GuMotion* m) {
     L_F_DEBUG;
 
+    g_mutex_lock (&m->signal_mutex);
     m->pause = FALSE;
+    g_mutex_unlock (&m->signal_mutex);
     motion_do_compile(m);
 }
 
-void motion_kill_typesetter (GuMotion* m) {
-    if (*m->typesetter_pid) {
-        /* Kill children spawned by typesetter command/script, don't know
-         * how to do this programatically yet(glib doesn't not provides any
-         * function for killing a process), so use pkill for now. For
-         * win32 there's currently nothing we can do about it. */
 #ifndef WIN32
-        gchar* command = g_strdup_printf("pkill -15 -P %d", *m->typesetter_pid);
-        system(command);
-        g_free(command);
-
-        /* Make sure typesetter command is terminated */
-        if (kill(*m->typesetter_pid, 15)) {
-            slog(L_ERROR, "Could not kill process: %s\n",
-                                    g_strerror(errno));
-        }
-#else
-        if (!TerminateProcess(*m->typesetter_pid, 0)) {
-            gchar *msg = g_win32_error_message(GetLastError());
-            slog (L_ERROR, "Could not kill process: %s\n",
-                                    msg ? msg : "(null)");
-            g_free(msg);
-        }
+/* The typesetter leads a process group, see utils_popen_r_lines. That way
+ * latexmk, bibtex or the dvi scripts go down together with it */
+static void motion_kill_group (GPid pid, gint sig) {
+    if (killpg (pid, sig) != 0 && errno != ESRCH) {
+        slog (L_ERROR, "Could not kill process group %d: %s\n", pid,
+                       g_strerror (errno));
+    }
+}
+
+static gboolean motion_escalate_cb (gpointer user) {
+    GuEditor* ec = GU_EDITOR (user);
+    GuMotion* mc = gummi->motion;
+
+    g_mutex_lock (&mc->signal_mutex);
+    if (ec->job.kill_timer && ec->job.pid) {
+        slog (L_WARNING, "Typesetter[pid=%d] ignored SIGTERM for %d ms, "
+                         "killing it\n", ec->job.pid, MOTION_KILL_TIMEOUT);
+        motion_kill_group (ec->job.pid, SIGKILL);
+    }
+    ec->job.kill_timer = 0;
+    g_mutex_unlock (&mc->signal_mutex);
+    return FALSE;
+}
+#endif
+
+/**
+ * @brief Publish the typesetter of the running job of an editor
+ *
+ * Called by the compile thread with the process id once the typesetter
+ * runs and with 0 before it is reaped, see utils_popen_r_lines. The main
+ * thread only signals the process group under signal_mutex, this way it
+ * never hits a group that is gone.
+ */
+void motion_set_job_pid (GPid pid, gpointer user) {
+    GuEditor* ec = GU_EDITOR (user);
+    GuMotion* mc = gummi? gummi->motion: NULL;
+
+    /* batch builds have nothing to cancel their jobs */
+    if (!mc) {
+        ec->job.pid = pid;
+        return;
+    }
+
+    g_mutex_lock (&mc->signal_mutex);
+    ec->job.pid = pid;
+#ifndef WIN32
+    /* a job runs several commands, e.g. a format dump or a rerun; those
+     * started after the cancel request go down right away and are
+     * escalated like the first one. motion_forget_editor may be waiting */
+    if (pid && ec->job.cancel_time) {
+        motion_kill_group (pid, SIGTERM);
+        if (!ec->job.kill_timer)
+            ec->job.kill_timer = g_timeout_add (MOTION_KILL_TIMEOUT,
+                                                motion_escalate_cb, ec);
+        g_cond_broadcast (&mc->job_done_cv);
+    }
+#endif
+    if (!pid && ec->job.kill_timer) {
+        g_source_remove (ec->job.kill_timer);
+        ec->job.kill_timer = 0;
+    }
+    g_mutex_unlock (&mc->signal_mutex);
+}
+
+/* Called with signal_mutex held, on the main thread */
+static void motion_signal_typesetter (GuMotion* m, GuEditor* ec) {
+    GPid pid = ec->job.pid;
+
+    if (ec->job.cancel_time) return;
+
+    /* Recorded also between two commands of the job, motion_set_job_pid
+     * stops the ones that start afterwards. Results of the killed run must
+     * not reach the preview */
+    ec->job.cancel_time = g_get_monotonic_time ();
+    if (ec->job.running && !ec->job.cancelled) {
+        ec->job.cancelled = TRUE;
+        m->n_cancelled++;
+    }
+    if (!pid) return;
 
+#ifndef WIN32
+    motion_kill_group (pid, SIGTERM);
+    ec->job.kill_timer = g_timeout_add (MOTION_KILL_TIMEOUT,
+                                        motion_escalate_cb, ec);
+#else
+    /* For win32 there's currently no way to reach the children */
+    if (!TerminateProcess(pid, 0)) {
+        gchar *msg = g_win32_error_message(GetLastError());
+        slog (L_ERROR, "Could not kill process: %s\n",
+                                msg ? msg : "(null)");
+        g_free(msg);
+    }
 #endif
 
+    slog(L_DEBUG, "Typeseter[pid=%d]: Killed\n", pid);
+}
+
+void motion_new_revision (GuMotion* mc) {
+    g_mutex_lock (&mc->signal_mutex);
+    mc->revision++;
+    g_mutex_unlock (&mc->signal_mutex);
+}
+
+guint64 motion_get_revision (GuMotion* mc) {
+    guint64 revision;
 
-        slog(L_DEBUG, "Typeseter[pid=%d]: Killed\n", *m->typesetter_pid);
-        *m->typesetter_pid = 0;
+    g_mutex_lock (&mc->signal_mutex);
+    revision = mc->revision;
+    g_mutex_unlock (&mc->signal_mutex);
+    return revision;
+}
 
-        /* XXX: Ugly hack: delay compile signal */
-        motion_start_timer (m);
+/* Called with signal_mutex held */
+static void motion_queue_job (GuMotion* mc, GuEditor* ec,
+                              gboolean background) {
+    if (ec->job.pending) {
+        mc->n_coalesced++;
+        if (!background) ec->job.background = FALSE;
+    } else {
+        ec->job.pending = TRUE;
+        ec->job.background = background;
+        mc->queue = g_list_append (mc->queue, ec);
+        mc->n_queued++;
     }
+    g_cond_broadcast (&mc->compile_cv);
 }
 
 gboolean motion_do_compile (gpointer user) {
     L_F_DEBUG;
     GuMotion* mc = GU_MOTION (user);
+    GuEditor* editor = gummi_get_active_editor ();
+    gboolean outdated = FALSE;
+
+    if (!editor)
+        return config_hot.real_time;
+
+    /* Hand the current text to the worker, it must not touch the buffer */
+    snapshot_unref (editor_publish_snapshot (editor, motion_get_revision (mc)));
+
+    /* Requests arriving while a job is still pending are folded into it,
+     * the worker picks up whatever snapshot is current when it starts */
+    g_mutex_lock (&mc->signal_mutex);
+    motion_queue_job (mc, editor, FALSE);
+
+    /* The running typesetter works on an outdated buffer, abort it so the
+     * pending job can start right away */
+    outdated = editor->job.running && !editor->job.cancelled &&
+               editor->job.revision != mc->revision;
+    if (outdated)
+        motion_signal_typesetter (mc, editor);
+    g_mutex_unlock (&mc->signal_mutex);
 
-    if (!g_mutex_trylock (&mc->signal_mutex)) goto ret;
-    g_cond_signal (&mc->compile_cv);
+    return config_hot.real_time;
+}
+
+/**
+ * @brief Queue compiles for the tabs that changed since their last compile
+ *
+ * Runs on the main thread after the active tab got its result, so that
+ * switching to one of them finds its pdf up to date.
+ */
+void motion_queue_background (GuMotion* mc) {
+    GuEditor* active = gummi_get_active_editor ();
+    GList* tabs = gummi_get_all_tabs ();
+    guint64 revision;
+
+    if (!config_hot.background) return;
+
+    revision = motion_get_revision (mc);
+    for (; tabs; tabs = tabs->next) {
+        GuEditor* ec = GU_TAB_CONTEXT (tabs->data)->editor;
+
+        if (ec == active || !g_atomic_int_get (&ec->modified_since_compile))
+            continue;
+
+        snapshot_unref (editor_publish_snapshot (ec, revision));
+        g_mutex_lock (&mc->signal_mutex);
+        motion_queue_job (mc, ec, TRUE);
+        g_mutex_unlock (&mc->signal_mutex);
+    }
+}
+
+/**
+ * @brief Drop the jobs of an editor that is about to be destroyed
+ *
+ * Kills its typesetter if it is running and waits for the worker to let go
+ * of the editor.
+ */
+void motion_forget_editor (GuMotion* mc, GuEditor* ec) {
+    gint64 deadline = 0;
+
+    g_mutex_lock (&mc->signal_mutex);
+    if (ec->job.pending) {
+        mc->queue = g_list_remove (mc->queue, ec);
+        ec->job.pending = FALSE;
+    }
+    if (ec->job.running)
+        motion_signal_typesetter (mc, ec);
+
+    /* The main loop is blocked here, escalate without it. Past the
+     * deadline every command of the cancelled job is killed outright, also
+     * one that starts later; motion_set_job_pid wakes us up for those */
+    deadline = g_get_monotonic_time () +
+               MOTION_KILL_TIMEOUT * G_TIME_SPAN_MILLISECOND;
+    while (ec->job.running) {
+        if (deadline &&
+            !g_cond_wait_until (&mc->job_done_cv, &mc->signal_mutex,
+                                deadline)) {
+            deadline = 0;
+        } else if (!deadline) {
+            g_cond_wait (&mc->job_done_cv, &mc->signal_mutex);
+        }
+#ifndef WIN32
+        if (!deadline && ec->job.cancelled && ec->job.pid)
+            motion_kill_group (ec->job.pid, SIGKILL);
+#endif
+    }
+    if (ec->job.kill_timer) {
+        g_source_remove (ec->job.kill_timer);
+        ec->job.kill_timer = 0;
+    }
     g_mutex_unlock (&mc->signal_mutex);
+}
 
-ret:
-    return (config_value_as_str_equals ("Compile", "scheme", "real_time"));
+/**
+ * @brief Take the next job off the queue, called with signal_mutex held
+ *
+ * The active editor goes first. Background jobs never take the last idle
+ * worker, so that an edit in the active tab does not have to wait for them.
+ */
+static GuEditor* motion_next_job (GuMotion* mc) {
+    GuEditor* active = gummi_get_active_editor ();
+    GuEditor* next = NULL;
+    GList* item;
+
+    for (item = mc->queue; item; item = item->next) {
+        GuEditor* ec = GU_EDITOR (item->data);
+
+        if (ec->job.running) continue;
+        if (ec == active || !ec->job.background) {
+            next = ec;
+            break;
+        }
+        if (!next && (mc->n_workers == 1 ||
+                      mc->n_background + 1 < mc->n_workers))
+            next = ec;
+    }
+    if (next) {
+        mc->queue = g_list_remove (mc->queue, next);
+        next->job.pending = FALSE;
+        next->job.running = TRUE;
+        next->job.cancelled = FALSE;
+        next->job.niced = next->job.background && next != active;
+        if (next->job.niced) mc->n_background++;
+    }
+    return next;
+}
+
+/**
+ * @brief Mark the running job of ec as done
+ * @return TRUE if the job was cancelled while running
+ */
+static gboolean motion_finish_job (GuMotion* mc, GuEditor* ec) {
+    gboolean cancelled = FALSE;
+
+    g_mutex_lock (&mc->signal_mutex);
+    ec->job.running = FALSE;
+    if (ec->job.niced) mc->n_background--;
+    cancelled = ec->job.cancelled;
+    if (!cancelled)
+        mc->n_completed++;
+    if (ec->job.cancel_time) {
+        gint64 latency = g_get_monotonic_time () - ec->job.cancel_time;
+        mc->cancel_usec += latency;
+        mc->cancel_usec_max = MAX (mc->cancel_usec_max, latency);
+        ec->job.cancel_time = 0;
+        slog (L_DEBUG, "Cancelled job gone after %.1f ms\n",
+                       latency / 1000.0);
+    }
+    /* the escalation must not hit the next job of this editor */
+    if (ec->job.kill_timer) {
+        g_source_remove (ec->job.kill_timer);
+        ec->job.kill_timer = 0;
+    }
+    slog (L_DEBUG, "Compile jobs: %u queued, %u coalesced, %u cancelled "
+                   "(%.1f ms on average, %.1f ms at most), %u completed\n",
+                   mc->n_queued, mc->n_coalesced, mc->n_cancelled,
+                   mc->n_cancelled? mc->cancel_usec / 1000.0 /
+                                    mc->n_cancelled: 0.0,
+                   mc->cancel_usec_max / 1000.0, mc->n_completed);
+    g_cond_broadcast (&mc->job_done_cv);
+    g_cond_broadcast (&mc->compile_cv);
+    g_mutex_unlock (&mc->signal_mutex);
+
+    return cancelled;
 }
 
 gpointer motion_compile_thread (gpointer data) {
@@ -155,59 +424,84 @@ gpointer motion_compile_thread (gpointer data) {
     GuEditor* editor = NULL;
     GuLatex* latex = NULL;
     gboolean precompile_ok = FALSE;
-    gchar *editortext;
+    gboolean background = FALSE;
+    GuSnapshot* snapshot = NULL;
 
     latex = gummi_get_latex ();
 
     while (TRUE) {
-        if (!g_mutex_trylock (&mc->compile_mutex)) continue;
-        slog (L_DEBUG, "Compile thread sleeping...\n");
-        g_cond_wait (&mc->compile_cv, &mc->compile_mutex);
-        slog (L_DEBUG, "Compile thread awoke.\n");
-
-        if (!(editor = gummi_get_active_editor ())) {
-            g_mutex_unlock (&mc->compile_mutex);
-            continue;
+        editor = NULL;
+        g_mutex_lock (&mc->signal_mutex);
+        while (mc->keep_running &&
+               (mc->pause || !(editor = motion_next_job (mc)))) {
+            slog (L_DEBUG, "Compile thread sleeping...\n");
+            g_cond_wait (&mc->compile_cv, &mc->signal_mutex);
         }
         if (!mc->keep_running) {
-            g_mutex_unlock (&mc->compile_mutex);
-            g_thread_exit (NULL);
+            g_mutex_unlock (&mc->signal_mutex);
+            break;
         }
-
-        if (mc->pause) {
-            g_mutex_unlock (&mc->compile_mutex);
+        background = editor->job.niced;
+        snapshot = editor_get_snapshot (editor);
+        if (snapshot) editor->job.revision = snapshot->revision;
+        g_mutex_unlock (&mc->signal_mutex);
+        slog (L_DEBUG, "Compile thread awoke%s.\n",
+                       background? " for a background tab": "");
+
+        if (!snapshot) {
+            motion_finish_job (mc, editor);
             continue;
         }
 
-        gdk_threads_enter ();
-        editortext = latex_update_workfile (editor);
-        precompile_ok = latex_precompile_check (editortext);
-        g_free (editortext);
-        gdk_threads_leave ();
+        g_mutex_lock (&editor->compile_mutex);
+
+        latex_write_workfile (editor, snapshot);
+        /* project files are built through the root document */
+        precompile_ok = latex_precompile_check (snapshot) ||
+                        latex_project_root (editor) != NULL;
+        snapshot_unref (snapshot);
 
         if (!precompile_ok) {
-            gdk_threads_add_idle (on_document_error, "document_error");
-            g_mutex_unlock (&mc->compile_mutex);
+            g_mutex_unlock (&editor->compile_mutex);
+            motion_finish_job (mc, editor);
+            if (background) {
+                /* not a document of its own, most likely included by
+                 * another one; don't queue it again for every compile */
+                g_atomic_int_set (&editor->modified_since_compile, FALSE);
+            } else {
+                gdk_threads_add_idle (on_document_error, "document_error");
+            }
             continue;
         }
 
         latex_update_pdffile (latex, editor);
 
-        *mc->typesetter_pid = 0;
-        g_mutex_unlock (&mc->compile_mutex);
+        g_mutex_unlock (&editor->compile_mutex);
+
+        if (motion_finish_job (mc, editor)) {
+            /* Output of a killed run is incomplete, make sure the next
+             * job recompiles instead of reusing it */
+            g_atomic_int_set (&editor->modified_since_compile, TRUE);
+            continue;
+        }
 
         if (!mc->keep_running)
-            g_thread_exit (NULL);
+            break;
 
         gdk_threads_add_idle (on_document_compiled, editor);
-        continue;
     }
+    return NULL;
 }
 
 void motion_force_compile (GuMotion *mc) {
+    GuEditor* editor = gummi_get_active_editor ();
+
     /* sort-of signal to force a compile run after certain actions that
      * don't trigger the regular editor content change signals */
-    gummi->latex->modified_since_compile = TRUE;
+    if (editor) {
+        g_atomic_int_set (&editor->modified_since_compile, TRUE);
+        editor->force_compile = TRUE;
+    }
     motion_do_compile (mc);
 }
 
@@ -219,9 +513,12 @@ gboolean motion_idle_cb (gpointer user) {
 }
 
 void motion_start_timer (GuMotion* mc) {
+    GuEditor* editor = gummi_get_active_editor ();
+    gint compile_ms = editor? g_atomic_int_get (&editor->compile_ms): 0;
+
     motion_stop_timer (mc);
-    mc->key_press_timer = g_timeout_add_seconds (
-                                config_get_integer ("Compile", "timer"),
+    mc->key_press_timer = g_timeout_add (
+                                debounce_delay (mc->debounce, compile_ms),
                                 motion_idle_cb, mc);
 }
 
@@ -235,8 +532,9 @@ void motion_stop_timer (GuMotion* mc) {
 gboolean on_key_press_cb (GtkWidget* widget, GdkEventKey* event, void* user) {
     if (!event->is_modifier) {
         motion_stop_timer (GU_MOTION (user));
+        debounce_keystroke (GU_MOTION (user)->debounce);
     }
-    if (config_get_boolean ("Interface", "snippets") &&
+    if (config_hot.snippets &&
         snippets_key_press_cb (gummi_get_snippets (),
                                gummi_get_active_editor (), event))
         return TRUE;
@@ -247,7 +545,7 @@ gboolean on_key_release_cb (GtkWidget* widget, GdkEventKey* event, void* user) {
     if (!event->is_modifier) {
         motion_start_timer (GU_MOTION (user));
     }
-    if (config_get_boolean ("Interface", "snippets") &&
+    if (config_hot.snippets &&
         snippets_key_release_cb (gummi_get_snippets (),
                                  gummi_get_active_editor (), event))
         return TRUE;
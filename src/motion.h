@@ -37,20 +37,60 @@
     #include <sys/types.h>
 #endif
 
+#include "debounce.h"
+
 #define GU_MOTION(x) ((GuMotion*)x)
 typedef struct _GuMotion GuMotion;
+struct _GuEditor;
+
+/* Upper bound for the compile worker pool, it is sized to the cores */
+#define MOTION_MAX_WORKERS 4
+
+/* Milliseconds a cancelled typesetter gets to exit before it is killed */
+#define MOTION_KILL_TIMEOUT 500
+
+/* Compile scheduling state of one editor, protected by the signal_mutex of
+ * the motion. An editor has at most one pending and one running job. */
+typedef struct {
+    gboolean pending;
+    gboolean running;
+    gboolean cancelled;
+    gboolean background;    /* the pending job has low priority */
+    gboolean niced;         /* the running job has low priority */
+    guint64 revision;       /* of the snapshot being compiled */
+    GPid pid;               /* typesetter of the running job and its group,
+                             * see motion_set_job_pid */
+    gint64 cancel_time;     /* when the running job was cancelled */
+    guint kill_timer;       /* escalation to SIGKILL, main loop source */
+} GuCompileJob;
 
 struct _GuMotion {
     guint key_press_timer;
+    GuDebounce* debounce;
     GMutex signal_mutex;
-    GMutex compile_mutex;
-    GThread* compile_thread;
     GCond compile_cv;
-    pid_t* typesetter_pid;
+    GCond job_done_cv;
+    GThread* workers[MOTION_MAX_WORKERS];
+    guint n_workers;
 
     gboolean keep_running;
     gboolean pause;
     gboolean errormode;
+
+    /* Compile scheduler state, protected by signal_mutex. Requests for an
+     * editor are coalesced into its pending job; a worker always compiles
+     * the latest snapshot of it. Jobs of the active editor go first, the
+     * other tabs are kept fresh with the workers that are left. */
+    GList* queue;           /* GuEditor* with a pending job */
+    guint n_background;     /* background jobs running */
+    guint64 revision;
+
+    guint n_queued;
+    guint n_coalesced;
+    guint n_cancelled;
+    guint n_completed;
+    gint64 cancel_usec;     /* time cancelled jobs took to go away */
+    gint64 cancel_usec_max;
 };
 
 GuMotion* motion_init (void);
@@ -60,11 +100,15 @@ void motion_pause_compile_thread (GuMotion* m);
 void motion_resume_compile_thread (GuMotion* m);
 gboolean motion_do_compile (gpointer user);
 void motion_force_compile (GuMotion *mc);
+void motion_new_revision (GuMotion* mc);
+guint64 motion_get_revision (GuMotion* mc);
+void motion_queue_background (GuMotion* mc);
+void motion_forget_editor (GuMotion* mc, struct _GuEditor* ec);
 gpointer motion_compile_thread (gpointer data);
+void motion_set_job_pid (GPid pid, gpointer user);
 gboolean motion_idle_cb (gpointer user);
 void motion_start_timer (GuMotion* mc);
 void motion_stop_timer (GuMotion* mc);
-void motion_kill_typesetter (GuMotion* m);
 
 gboolean on_key_press_cb (GtkWidget* widget, GdkEventKey* event, void* user);
 gboolean on_key_release_cb (GtkWidget* widget, GdkEventKey* event, void* user);
@@ -0,0 +1,681 @@
+/**
+ * @file   pagediff.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pagediff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <zlib.h>
+
+#include "utils.h"
+
+/* Just enough of a PDF reader to tell which pages of a freshly compiled
+ * document differ from the previous run. Objects are located by scanning
+ * the file rather than through the xref table, object streams are inflated
+ * to reach the page dictionaries, content streams are hashed in their
+ * compressed form. pdfTeX and dvipdfmx produce identical bytes for a page
+ * whose input did not change, so this is all that is needed. */
+
+#define PDF_MAX_DEPTH 32
+#define PDF_MAX_OBJECTS (1 << 22)
+
+typedef struct {
+    const gchar* p;
+    const gchar* end;       /* end of the buffer the value lives in */
+} PdfValue;
+
+typedef struct {
+    const gchar* data;
+    const gchar* end;
+    GArray* objects;        /* PdfValue indexed by object number */
+    GPtrArray* buffers;     /* inflated object streams */
+    GHashTable* fonts;      /* font dictionary -> digest, fonts are shared */
+    guint64* signatures;
+    gint n_pages;
+    gint page;
+} PdfScan;
+
+typedef struct {
+    PdfValue mediabox;
+    PdfValue cropbox;
+    PdfValue rotate;
+    PdfValue resources;
+} PdfInherited;
+
+static inline gboolean pdf_is_space (gchar c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' ||
+           c == '\0';
+}
+
+static inline gboolean pdf_is_delim (gchar c) {
+    return c != '\0' && strchr ("()<>[]{}/%", c) != NULL;
+}
+
+static const gchar* pdf_find (const gchar* p, const gchar* end,
+                              const gchar* needle) {
+    gsize len = strlen (needle);
+
+    while (p + len <= end) {
+        p = memchr (p, needle[0], end - p - len + 1);
+        if (p == NULL) return NULL;
+        if (memcmp (p, needle, len) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+static const gchar* pdf_skip_space (const gchar* p, const gchar* end) {
+    while (p < end) {
+        if (*p == '%') {
+            while (p < end && *p != '\n' && *p != '\r') p++;
+        } else if (pdf_is_space (*p)) {
+            p++;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+static const gchar* pdf_skip_token (const gchar* p, const gchar* end) {
+    while (p < end && !pdf_is_space (*p) && !pdf_is_delim (*p)) p++;
+    return p;
+}
+
+static gboolean pdf_parse_int (const gchar* p, const gchar* end, gint* val) {
+    gint64 n = 0;
+    const gchar* start = p;
+
+    while (p < end && g_ascii_isdigit (*p) && n < G_MAXINT)
+        n = n * 10 + (*p++ - '0');
+    if (p == start || n >= G_MAXINT ||
+        (p < end && !pdf_is_space (*p) && !pdf_is_delim (*p)))
+        return FALSE;
+    *val = (gint)n;
+    return TRUE;
+}
+
+/* Parses an indirect reference "num gen R" */
+static gboolean pdf_parse_ref (const gchar* p, const gchar* end, gint* num,
+                               const gchar** after) {
+    gint gen = 0;
+
+    if (!pdf_parse_int (p, end, num)) return FALSE;
+    p = pdf_skip_space (pdf_skip_token (p, end), end);
+    if (!pdf_parse_int (p, end, &gen)) return FALSE;
+    p = pdf_skip_space (pdf_skip_token (p, end), end);
+    if (p >= end || *p != 'R' || pdf_skip_token (p, end) != p + 1)
+        return FALSE;
+    if (after) *after = p + 1;
+    return TRUE;
+}
+
+static const gchar* pdf_skip_value (const gchar* p, const gchar* end,
+                                    gint depth);
+
+/* Skips a value, treating an indirect reference as a single value */
+static const gchar* pdf_skip_item (const gchar* p, const gchar* end,
+                                   gint depth) {
+    const gchar* after = NULL;
+    gint num = 0;
+
+    p = pdf_skip_space (p, end);
+    if (pdf_parse_ref (p, end, &num, &after)) return after;
+    return pdf_skip_value (p, end, depth);
+}
+
+static const gchar* pdf_skip_value (const gchar* p, const gchar* end,
+                                    gint depth) {
+    const gchar* start = NULL;
+    gint nesting = 0;
+
+    p = pdf_skip_space (p, end);
+    if (p >= end || depth > PDF_MAX_DEPTH) return NULL;
+
+    switch (*p) {
+        case '<':
+            if (p + 1 < end && p[1] == '<') {
+                for (p += 2;;) {
+                    p = pdf_skip_space (p, end);
+                    if (p + 1 < end && p[0] == '>' && p[1] == '>')
+                        return p + 2;
+                    if (!(p = pdf_skip_item (p, end, depth + 1)))
+                        return NULL;
+                }
+            }
+            p = memchr (p, '>', end - p);
+            return p ? p + 1 : NULL;
+        case '[':
+            for (p++;;) {
+                p = pdf_skip_space (p, end);
+                if (p < end && *p == ']') return p + 1;
+                if (!(p = pdf_skip_item (p, end, depth + 1))) return NULL;
+            }
+        case '(':
+            for (; p < end; p++) {
+                if (*p == '\\') p++;
+                else if (*p == '(') nesting++;
+                else if (*p == ')' && --nesting == 0) return p + 1;
+            }
+            return NULL;
+        case '/':
+            return pdf_skip_token (p + 1, end);
+        default:
+            start = p;
+            p = pdf_skip_token (p, end);
+            return p == start ? NULL : p;
+    }
+}
+
+static gboolean pdf_is_name (PdfValue v, const gchar* name) {
+    gsize len = strlen (name);
+
+    return v.p && v.p < v.end && v.p[0] == '/' &&
+           pdf_skip_token (v.p + 1, v.end) == v.p + 1 + len &&
+           memcmp (v.p + 1, name, len) == 0;
+}
+
+static PdfValue pdf_dict_get (PdfValue dict, const gchar* key) {
+    PdfValue none = { NULL, NULL };
+    const gchar* p = dict.p;
+    const gchar* end = dict.end;
+    gsize len = strlen (key);
+
+    if (p == NULL) return none;
+    p = pdf_skip_space (p, end);
+    if (p + 1 >= end || p[0] != '<' || p[1] != '<') return none;
+
+    for (p += 2;;) {
+        const gchar* name = NULL;
+        gboolean match = FALSE;
+
+        p = pdf_skip_space (p, end);
+        if (p >= end || *p != '/') return none;
+        name = p + 1;
+        p = pdf_skip_token (name, end);
+        match = (gsize)(p - name) == len && memcmp (name, key, len) == 0;
+        p = pdf_skip_space (p, end);
+        if (match) {
+            PdfValue value = { p, end };
+            return value;
+        }
+        if (!(p = pdf_skip_item (p, end, 0))) return none;
+    }
+}
+
+static PdfValue pdf_get_object (PdfScan* scan, gint num) {
+    PdfValue none = { NULL, NULL };
+
+    if (num < 0 || (guint)num >= scan->objects->len) return none;
+    return g_array_index (scan->objects, PdfValue, num);
+}
+
+static void pdf_set_object (PdfScan* scan, gint num, const gchar* p,
+                            const gchar* end, gboolean replace) {
+    PdfValue* obj = NULL;
+
+    if (num <= 0 || num >= PDF_MAX_OBJECTS) return;
+    if ((guint)num >= scan->objects->len)
+        g_array_set_size (scan->objects, num + 1);
+    obj = &g_array_index (scan->objects, PdfValue, num);
+    if (obj->p == NULL || replace) {
+        obj->p = p;
+        obj->end = end;
+    }
+}
+
+/* Follows indirect references until a direct value is found */
+static PdfValue pdf_resolve (PdfScan* scan, PdfValue v) {
+    gint num = 0, i;
+
+    for (i = 0; v.p && i < PDF_MAX_DEPTH; i++) {
+        v.p = pdf_skip_space (v.p, v.end);
+        if (!pdf_parse_ref (v.p, v.end, &num, NULL)) return v;
+        v = pdf_get_object (scan, num);
+    }
+    v.p = NULL;
+    return v;
+}
+
+static gboolean pdf_resolve_int (PdfScan* scan, PdfValue v, gint* val) {
+    v = pdf_resolve (scan, v);
+    return v.p && pdf_parse_int (v.p, v.end, val);
+}
+
+/* Locates the raw data of the stream whose dictionary starts at obj */
+static gboolean pdf_stream_data (PdfScan* scan, PdfValue obj,
+                                 PdfValue* data) {
+    const gchar* p = NULL;
+    gint length = 0;
+
+    if (!(p = pdf_skip_value (obj.p, obj.end, 0))) return FALSE;
+    while (p < obj.end && pdf_is_space (*p)) p++;
+    if (p + 6 > obj.end || memcmp (p, "stream", 6) != 0) return FALSE;
+    p += 6;
+    if (p < obj.end && *p == '\r') p++;
+    if (p < obj.end && *p == '\n') p++;
+
+    data->p = p;
+    if (pdf_resolve_int (scan, pdf_dict_get (obj, "Length"), &length) &&
+        length <= obj.end - p) {
+        data->end = p + length;
+    } else if (!(data->end = pdf_find (p, obj.end, "endstream"))) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean pdf_ref_stream_data (PdfScan* scan, PdfValue ref,
+                                     PdfValue* data) {
+    gint num = 0;
+
+    if (!ref.p || !pdf_parse_ref (pdf_skip_space (ref.p, ref.end), ref.end,
+                                  &num, NULL))
+        return FALSE;
+    return pdf_stream_data (scan, pdf_get_object (scan, num), data);
+}
+
+/* Checks whether "num gen obj" ends right before kw */
+static gboolean pdf_object_header (PdfScan* scan, const gchar* kw,
+                                   gint* num) {
+    const gchar* p = kw;
+    gint i;
+
+    for (i = 0; i < 2; i++) {
+        const gchar* digits = NULL;
+        if (p == scan->data || !pdf_is_space (p[-1])) return FALSE;
+        while (p > scan->data && pdf_is_space (p[-1])) p--;
+        digits = p;
+        while (p > scan->data && g_ascii_isdigit (p[-1])) p--;
+        if (p == digits) return FALSE;
+    }
+    if (p > scan->data && !pdf_is_space (p[-1]) && !pdf_is_delim (p[-1]))
+        return FALSE;
+    return pdf_parse_int (p, kw, num);
+}
+
+static void pdf_scan_objects (PdfScan* scan) {
+    const gchar* p = scan->data;
+
+    while ((p = pdf_find (p, scan->end, "obj"))) {
+        const gchar* kw = p;
+        PdfValue obj, data;
+        gint num = 0;
+
+        p += 3;
+        if ((p < scan->end && !pdf_is_space (*p) && !pdf_is_delim (*p)) ||
+            !pdf_object_header (scan, kw, &num))
+            continue;
+
+        /* Later definitions win, they belong to incremental updates */
+        pdf_set_object (scan, num, p, scan->end, TRUE);
+
+        /* Do not look for objects inside of binary stream data */
+        obj.p = p;
+        obj.end = scan->end;
+        if (pdf_stream_data (scan, obj, &data)) p = data.end;
+    }
+}
+
+static gchar* pdf_inflate (PdfValue data, gsize* out_len) {
+    z_stream zs;
+    gsize size = MAX ((data.end - data.p) * 4, 4096);
+    gchar* out = g_malloc (size);
+    gint ret = Z_OK;
+
+    memset (&zs, 0, sizeof (zs));
+    if (inflateInit (&zs) != Z_OK) {
+        g_free (out);
+        return NULL;
+    }
+    zs.next_in = (Bytef*)data.p;
+    zs.avail_in = data.end - data.p;
+
+    while (ret == Z_OK) {
+        if (zs.total_out == size) {
+            size *= 2;
+            out = g_realloc (out, size);
+        }
+        zs.next_out = (Bytef*)out + zs.total_out;
+        zs.avail_out = size - zs.total_out;
+        ret = inflate (&zs, Z_NO_FLUSH);
+    }
+    inflateEnd (&zs);
+
+    if (ret != Z_STREAM_END) {
+        g_free (out);
+        return NULL;
+    }
+    *out_len = zs.total_out;
+    return out;
+}
+
+/* Registers the objects stored inside of a compressed object stream */
+static void pdf_load_object_stream (PdfScan* scan, PdfValue obj) {
+    PdfValue filter = pdf_resolve (scan, pdf_dict_get (obj, "Filter"));
+    PdfValue data;
+    gint n = 0, first = 0, i;
+    gchar* buf = NULL;
+    const gchar* p = NULL;
+    gsize len = 0;
+
+    if (!pdf_is_name (filter, "FlateDecode") ||
+        pdf_dict_get (obj, "DecodeParms").p ||
+        !pdf_resolve_int (scan, pdf_dict_get (obj, "N"), &n) ||
+        !pdf_resolve_int (scan, pdf_dict_get (obj, "First"), &first) ||
+        !pdf_stream_data (scan, obj, &data) ||
+        !(buf = pdf_inflate (data, &len)))
+        return;
+    g_ptr_array_add (scan->buffers, buf);
+    if ((gsize)first > len) return;
+
+    p = buf;
+    for (i = 0; i < n; i++) {
+        gint num = 0, offset = 0;
+
+        p = pdf_skip_space (p, buf + first);
+        if (!pdf_parse_int (p, buf + first, &num)) return;
+        p = pdf_skip_space (pdf_skip_token (p, buf + first), buf + first);
+        if (!pdf_parse_int (p, buf + first, &offset) ||
+            offset > (gint)len - first)
+            return;
+        p = pdf_skip_token (p, buf + first);
+        /* Uncompressed definitions take precedence */
+        pdf_set_object (scan, num, buf + first + offset, buf + len, FALSE);
+    }
+}
+
+static void pdf_load_object_streams (PdfScan* scan) {
+    guint i, len = scan->objects->len;
+
+    for (i = 0; i < len; i++) {
+        PdfValue obj = g_array_index (scan->objects, PdfValue, i);
+        if (obj.p && obj.end == scan->end &&
+            pdf_is_name (pdf_dict_get (obj, "Type"), "ObjStm"))
+            pdf_load_object_stream (scan, obj);
+    }
+}
+
+static void pdf_checksum_value (GChecksum* cs, PdfScan* scan, PdfValue v) {
+    const gchar* end = NULL;
+
+    v = pdf_resolve (scan, v);
+    if (v.p && (end = pdf_skip_value (v.p, v.end, 0))) {
+        v.p = pdf_skip_space (v.p, v.end);
+        g_checksum_update (cs, (const guchar*)v.p, end - v.p);
+    }
+    g_checksum_update (cs, (const guchar*)"|", 1);
+}
+
+static void pdf_checksum_stream (GChecksum* cs, PdfScan* scan,
+                                 PdfValue ref) {
+    PdfValue data;
+
+    if (pdf_ref_stream_data (scan, ref, &data))
+        g_checksum_update (cs, (const guchar*)data.p, data.end - data.p);
+    g_checksum_update (cs, (const guchar*)"|", 1);
+}
+
+/* Calls func for each element of an array, or once for a single value */
+static void pdf_foreach (PdfScan* scan, PdfValue v,
+                         void (*func) (GChecksum*, PdfScan*, PdfValue),
+                         GChecksum* cs) {
+    PdfValue item = { NULL, v.end };
+    const gchar* p = NULL;
+
+    if (v.p == NULL) return;
+    v.p = pdf_skip_space (v.p, v.end);
+    if (v.p >= v.end || *v.p != '[') {
+        PdfValue direct = pdf_resolve (scan, v);
+        if (direct.p && pdf_skip_space (direct.p, direct.end) < direct.end &&
+            *pdf_skip_space (direct.p, direct.end) == '[') {
+            pdf_foreach (scan, direct, func, cs);
+        } else {
+            func (cs, scan, v);
+        }
+        return;
+    }
+
+    for (p = v.p + 1;;) {
+        p = pdf_skip_space (p, v.end);
+        if (p >= v.end || *p == ']') return;
+        item.p = p;
+        func (cs, scan, item);
+        if (!(p = pdf_skip_item (p, v.end, 0))) return;
+    }
+}
+
+/* Hashes the glyphs and metrics of a font rather than its dictionary, which
+ * refers to objects whose numbers change with every run. A page that only
+ * changes by its fonts, a subset that grew or a different font file, keeps
+ * its content stream. The digest of a font is computed once per scan */
+static void pdf_checksum_font (GChecksum* cs, PdfScan* scan, PdfValue font) {
+    PdfValue desc = { NULL, NULL };
+    GChecksum* fcs = NULL;
+    guint8 digest[16];
+    gsize digest_len = sizeof (digest);
+    guint64* cached = NULL;
+
+    font = pdf_resolve (scan, font);
+    if (font.p == NULL) {
+        g_checksum_update (cs, (const guchar*)"|", 1);
+        return;
+    }
+
+    if (!(cached = g_hash_table_lookup (scan->fonts, font.p))) {
+        /* Added first so that fonts referring to themselves terminate */
+        cached = g_new0 (guint64, 1);
+        g_hash_table_insert (scan->fonts, (gpointer)font.p, cached);
+
+        fcs = g_checksum_new (G_CHECKSUM_MD5);
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "Subtype"));
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "BaseFont"));
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "Encoding"));
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "FirstChar"));
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "Widths"));
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "W"));
+        pdf_checksum_value (fcs, scan, pdf_dict_get (font, "FontMatrix"));
+        desc = pdf_resolve (scan, pdf_dict_get (font, "FontDescriptor"));
+        pdf_checksum_stream (fcs, scan, pdf_dict_get (desc, "FontFile"));
+        pdf_checksum_stream (fcs, scan, pdf_dict_get (desc, "FontFile2"));
+        pdf_checksum_stream (fcs, scan, pdf_dict_get (desc, "FontFile3"));
+        pdf_foreach (scan, pdf_dict_get (font, "DescendantFonts"),
+                     pdf_checksum_font, fcs);
+
+        g_checksum_get_digest (fcs, digest, &digest_len);
+        memcpy (cached, digest, sizeof (guint64));
+        g_checksum_free (fcs);
+    }
+    g_checksum_update (cs, (const guchar*)cached, sizeof (guint64));
+}
+
+/* Hashes the entries of a resource category of a page, the names are
+ * included as the content stream refers to them by name */
+static void pdf_checksum_resources (GChecksum* cs, PdfScan* scan,
+                                    PdfValue resources, const gchar* key,
+                                    void (*func) (GChecksum*, PdfScan*,
+                                                  PdfValue)) {
+    PdfValue dict = pdf_resolve (scan, pdf_dict_get (
+                        pdf_resolve (scan, resources), key));
+    const gchar* p = NULL;
+
+    if (dict.p == NULL) return;
+    p = pdf_skip_space (dict.p, dict.end);
+    if (p + 1 >= dict.end || p[0] != '<' || p[1] != '<') return;
+
+    for (p += 2;;) {
+        const gchar* name = NULL;
+        PdfValue value;
+
+        p = pdf_skip_space (p, dict.end);
+        if (p >= dict.end || *p != '/') return;
+        name = p;
+        p = pdf_skip_token (p + 1, dict.end);
+        g_checksum_update (cs, (const guchar*)name, p - name);
+        value.p = p;
+        value.end = dict.end;
+        func (cs, scan, value);
+        if (!(p = pdf_skip_item (p, dict.end, 0))) return;
+    }
+}
+
+/* Annotations with a visible border or appearance are drawn by poppler */
+static void pdf_checksum_annot (GChecksum* cs, PdfScan* scan,
+                                PdfValue annot) {
+    PdfValue ap = { NULL, NULL };
+
+    annot = pdf_resolve (scan, annot);
+    pdf_checksum_value (cs, scan, pdf_dict_get (annot, "Subtype"));
+    pdf_checksum_value (cs, scan, pdf_dict_get (annot, "Rect"));
+    pdf_checksum_value (cs, scan, pdf_dict_get (annot, "Border"));
+    pdf_checksum_value (cs, scan, pdf_dict_get (annot, "C"));
+    pdf_checksum_value (cs, scan, pdf_dict_get (annot, "F"));
+    ap = pdf_dict_get (pdf_resolve (scan, pdf_dict_get (annot, "AP")), "N");
+    if (ap.p) pdf_checksum_stream (cs, scan, ap);
+}
+
+static void pdf_inherit (PdfScan* scan, PdfValue node, const gchar* key,
+                         PdfValue* value) {
+    PdfValue v = pdf_dict_get (node, key);
+    if (v.p) *value = v;
+}
+
+static gboolean pdf_walk_pages (PdfScan* scan, PdfValue node,
+                                PdfInherited inh, gint depth) {
+    PdfValue kids;
+    GChecksum* cs = NULL;
+    guint8 digest[32];
+    gsize digest_len = sizeof (digest);
+
+    node = pdf_resolve (scan, node);
+    if (node.p == NULL || depth > PDF_MAX_DEPTH) return FALSE;
+
+    pdf_inherit (scan, node, "MediaBox", &inh.mediabox);
+    pdf_inherit (scan, node, "CropBox", &inh.cropbox);
+    pdf_inherit (scan, node, "Rotate", &inh.rotate);
+    pdf_inherit (scan, node, "Resources", &inh.resources);
+
+    kids = pdf_resolve (scan, pdf_dict_get (node, "Kids"));
+    if (kids.p) {
+        const gchar* p = pdf_skip_space (kids.p, kids.end);
+        if (p >= kids.end || *p != '[') return FALSE;
+        for (p++;;) {
+            PdfValue kid;
+            p = pdf_skip_space (p, kids.end);
+            if (p >= kids.end) return FALSE;
+            if (*p == ']') return TRUE;
+            kid.p = p;
+            kid.end = kids.end;
+            if (!pdf_walk_pages (scan, kid, inh, depth + 1)) return FALSE;
+            if (!(p = pdf_skip_item (p, kids.end, 0))) return FALSE;
+        }
+    }
+
+    if (scan->page >= scan->n_pages) return FALSE;
+
+    cs = g_checksum_new (G_CHECKSUM_MD5);
+    pdf_checksum_value (cs, scan, inh.mediabox);
+    pdf_checksum_value (cs, scan, inh.cropbox);
+    pdf_checksum_value (cs, scan, inh.rotate);
+    pdf_foreach (scan, pdf_dict_get (node, "Contents"),
+                 pdf_checksum_stream, cs);
+    pdf_checksum_resources (cs, scan, inh.resources, "XObject",
+                            pdf_checksum_stream);
+    pdf_checksum_resources (cs, scan, inh.resources, "Font",
+                            pdf_checksum_font);
+    pdf_foreach (scan, pdf_dict_get (node, "Annots"),
+                 pdf_checksum_annot, cs);
+
+    g_checksum_get_digest (cs, digest, &digest_len);
+    memcpy (&scan->signatures[scan->page++], digest, sizeof (guint64));
+    g_checksum_free (cs);
+    return TRUE;
+}
+
+static PdfValue pdf_find_root (PdfScan* scan) {
+    PdfValue root = { NULL, scan->end };
+    const gchar* p = NULL;
+
+    /* The last trailer (or xref stream) describes the current document */
+    if (scan->end - scan->data < 5) return root;
+    for (p = scan->end - 5; p > scan->data; p--) {
+        if (*p == '/' && memcmp (p, "/Root", 5) == 0) {
+            root.p = pdf_skip_space (p + 5, scan->end);
+            break;
+        }
+    }
+    return pdf_resolve (scan, root);
+}
+
+gboolean pagediff_scan (gint fd, const gchar* filename, gint n_pages,
+                        guint64* signatures) {
+    PdfScan scan;
+    PdfInherited inh;
+    GMappedFile* file = NULL;
+    const gchar* contents = NULL;
+    gsize len = 0;
+    gboolean ret = FALSE;
+
+    if (!(file = g_mapped_file_new_from_fd (fd, FALSE, NULL))) return FALSE;
+    contents = g_mapped_file_get_contents (file);
+    len = g_mapped_file_get_length (file);
+    if (contents == NULL || len == 0) {
+        g_mapped_file_unref (file);
+        return FALSE;
+    }
+
+    memset (&scan, 0, sizeof (scan));
+    memset (&inh, 0, sizeof (inh));
+    scan.data = contents;
+    scan.end = contents + len;
+    scan.objects = g_array_new (FALSE, TRUE, sizeof (PdfValue));
+    scan.buffers = g_ptr_array_new_with_free_func (g_free);
+    scan.fonts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        NULL, g_free);
+    scan.signatures = signatures;
+    scan.n_pages = n_pages;
+
+    pdf_scan_objects (&scan);
+    pdf_load_object_streams (&scan);
+
+    ret = pdf_walk_pages (&scan, pdf_dict_get (pdf_find_root (&scan),
+                                               "Pages"), inh, 0) &&
+          scan.page == n_pages;
+
+    slog (L_DEBUG, "Page signatures of %s: %s (%u objects)\n", filename,
+                   ret ? "ok" : "unavailable", scan.objects->len);
+
+    g_array_free (scan.objects, TRUE);
+    g_ptr_array_free (scan.buffers, TRUE);
+    g_hash_table_destroy (scan.fonts);
+    g_mapped_file_unref (file);
+    return ret;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file   pagediff.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_PAGEDIFF_H__
+#define __GUMMI_PAGEDIFF_H__
+
+#include <glib.h>
+
+/**
+ * pagediff_scan:
+ *
+ * Computes a signature for each of the n_pages pages of the PDF file open
+ * as fd from the raw bytes of its content streams, the XObjects and fonts
+ * it draws with and its page boxes. Two pages with the same signature
+ * render identically. filename is only used for logging. Returns FALSE
+ * when the file structure could not be understood, in which case every
+ * page has to be treated as changed. Safe to call from any thread.
+ */
+gboolean pagediff_scan (gint fd, const gchar* filename, gint n_pages,
+                        guint64* signatures);
+
+#endif /* __GUMMI_PAGEDIFF_H__ */
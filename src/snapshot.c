@@ -0,0 +1,214 @@
+/**
+ * @file   snapshot.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "snapshot.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+
+#ifndef WIN32
+#   include <sys/uio.h>
+#   include <unistd.h>
+#else
+#   include <io.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "utils.h"
+
+#ifndef IOV_MAX
+#   define IOV_MAX 16
+#endif
+
+GuSnapshot* snapshot_new (guint64 revision, GPtrArray* chunks) {
+    GuSnapshot* snap = g_new0 (GuSnapshot, 1);
+    GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    guint i;
+
+    snap->refcount = 1;
+    snap->revision = revision;
+    snap->chunks = chunks;
+
+    for (i = 0; i < chunks->len; ++i) {
+        gsize size = 0;
+        gconstpointer data = g_bytes_get_data (chunks->pdata[i], &size);
+        g_checksum_update (checksum, data, size);
+        snap->length += size;
+    }
+    snap->checksum = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+    return snap;
+}
+
+/**
+ * @brief Same text at a newer revision, the chunks are shared
+ */
+GuSnapshot* snapshot_retag (GuSnapshot* snap, guint64 revision) {
+    GuSnapshot* copy = g_new0 (GuSnapshot, 1);
+    guint i;
+
+    copy->refcount = 1;
+    copy->revision = revision;
+    copy->chunks = g_ptr_array_new_full (snap->chunks->len,
+                                         (GDestroyNotify)g_bytes_unref);
+    for (i = 0; i < snap->chunks->len; ++i)
+        g_ptr_array_add (copy->chunks, g_bytes_ref (snap->chunks->pdata[i]));
+    copy->length = snap->length;
+    copy->checksum = g_strdup (snap->checksum);
+    return copy;
+}
+
+GuSnapshot* snapshot_ref (GuSnapshot* snap) {
+    g_atomic_int_inc (&snap->refcount);
+    return snap;
+}
+
+void snapshot_unref (GuSnapshot* snap) {
+    if (!snap || !g_atomic_int_dec_and_test (&snap->refcount)) return;
+
+    g_ptr_array_free (snap->chunks, TRUE);
+    g_free (snap->checksum);
+    g_free (snap);
+}
+
+/**
+ * @brief Look for a string that does not contain a line break
+ *
+ * Chunks end on line boundaries, so such a string never straddles two of
+ * them and the text does not have to be joined.
+ */
+gboolean snapshot_contains (GuSnapshot* snap, const gchar* needle) {
+    guint i;
+
+    for (i = 0; i < snap->chunks->len; ++i) {
+        gsize size = 0;
+        const gchar* data = g_bytes_get_data (snap->chunks->pdata[i], &size);
+        if (size && g_strstr_len (data, size, needle))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean snapshot_write_fd (GuSnapshot* snap, gint fd) {
+#ifndef WIN32
+    struct iovec iov[IOV_MAX];
+    guint next = 0;
+
+    while (next < snap->chunks->len) {
+        gint n = 0;
+        gsize total = 0;
+        gssize written;
+
+        for (; n < IOV_MAX && next + n < snap->chunks->len; ++n) {
+            gsize size = 0;
+            iov[n].iov_base = (gpointer)g_bytes_get_data (
+                    snap->chunks->pdata[next + n], &size);
+            iov[n].iov_len = size;
+            total += size;
+        }
+        do {
+            written = writev (fd, iov, n);
+        } while (written < 0 && errno == EINTR);
+        if (written < 0) return FALSE;
+
+        /* Short write, finish the batch chunk by chunk */
+        if ((gsize)written < total) {
+            gint k = 0;
+            while (k < n && (gsize)written >= iov[k].iov_len)
+                written -= iov[k++].iov_len;
+            for (; k < n; ++k) {
+                const gchar* p = (const gchar*)iov[k].iov_base + written;
+                gsize left = iov[k].iov_len - written;
+                written = 0;
+                while (left > 0) {
+                    gssize w = write (fd, p, left);
+                    if (w < 0 && errno == EINTR) continue;
+                    if (w < 0) return FALSE;
+                    p += w;
+                    left -= w;
+                }
+            }
+        }
+        next += n;
+    }
+#else
+    guint i;
+
+    for (i = 0; i < snap->chunks->len; ++i) {
+        gsize size = 0;
+        const gchar* p = g_bytes_get_data (snap->chunks->pdata[i], &size);
+        while (size > 0) {
+            gint w = _write (fd, p, (guint)size);
+            if (w < 0) return FALSE;
+            p += w;
+            size -= w;
+        }
+    }
+#endif
+    return TRUE;
+}
+
+/**
+ * @brief Write the snapshot to filename
+ *
+ * Like g_file_set_contents the text goes to a temporary file that is
+ * renamed over filename, but the chunks are handed to the kernel as they
+ * are. Safe to call from any thread.
+ */
+gboolean snapshot_write (GuSnapshot* snap, const gchar* filename) {
+    gchar* tmpname = g_strdup_printf ("%s.XXXXXX", filename);
+    gboolean ok = FALSE;
+    gint fd;
+
+    if ((fd = g_mkstemp_full (tmpname, O_RDWR, 0666)) < 0) {
+        slog (L_ERROR, "Could not create temporary file for %s: %s\n",
+                       filename, g_strerror (errno));
+        g_free (tmpname);
+        return FALSE;
+    }
+
+    ok = snapshot_write_fd (snap, fd);
+    if (!ok)
+        slog (L_ERROR, "Could not write %s: %s\n", tmpname,
+                       g_strerror (errno));
+    if (close (fd) != 0)
+        ok = FALSE;
+    if (ok && g_rename (tmpname, filename) != 0) {
+        slog (L_ERROR, "Could not rename %s to %s: %s\n", tmpname, filename,
+                       g_strerror (errno));
+        ok = FALSE;
+    }
+    if (!ok) g_unlink (tmpname);
+    g_free (tmpname);
+    return ok;
+}
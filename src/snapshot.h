@@ -0,0 +1,61 @@
+/**
+ * @file   snapshot.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_SNAPSHOT_H__
+#define __GUMMI_SNAPSHOT_H__
+
+#include <glib.h>
+
+#define GU_SNAPSHOT(x) ((GuSnapshot*)x)
+
+/* Lines per chunk */
+#define SNAPSHOT_CHUNK_LINES 256
+typedef struct _GuSnapshot GuSnapshot;
+
+/* Immutable copy of an editor buffer at some revision. The text is kept as
+ * a list of chunks that end on line boundaries, so unchanged chunks can be
+ * shared between consecutive snapshots and written out without joining
+ * them first. Snapshots are created on the main thread and may be read from
+ * any thread while a reference is held. */
+struct _GuSnapshot {
+    gint refcount;
+    guint64 revision;
+    GPtrArray* chunks;      /* GBytes* */
+    gsize length;
+    gchar* checksum;        /* SHA1 of the whole text */
+};
+
+GuSnapshot* snapshot_new (guint64 revision, GPtrArray* chunks);
+GuSnapshot* snapshot_retag (GuSnapshot* snap, guint64 revision);
+GuSnapshot* snapshot_ref (GuSnapshot* snap);
+void snapshot_unref (GuSnapshot* snap);
+gboolean snapshot_contains (GuSnapshot* snap, const gchar* needle);
+gboolean snapshot_write (GuSnapshot* snap, const gchar* filename);
+
+#endif /* __GUMMI_SNAPSHOT_H__ */
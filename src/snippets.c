@@ -42,6 +42,8 @@
 #include "environment.h"
 #include "utils.h"
 
+static void snippets_build_table (GuSnippets* sc);
+
 GuSnippets* snippets_init () {
     GuSnippets* s = g_new0 (GuSnippets, 1);
 
@@ -135,6 +137,8 @@ void snippets_load (GuSnippets* sc) {
     }
     if (prev) prev->next = NULL;
     fclose (fh);
+
+    snippets_build_table (sc);
 }
 
 void snippets_save (GuSnippets* sc) {
@@ -186,13 +190,53 @@ void snippets_clean_up (GuSnippets* sc) {
         prev = current;
     }
     sc->head = NULL;
+    snippets_invalidate (sc);
+}
+
+/* To be called whenever the snippet list changed */
+void snippets_invalidate (GuSnippets* sc) {
+    if (sc->table)
+        g_hash_table_destroy (sc->table);
+    sc->table = NULL;
+}
+
+/* The first snippet with a trigger wins, like it did with the list */
+static void snippets_build_table (GuSnippets* sc) {
+    slist* current = NULL;
+
+    snippets_invalidate (sc);
+    sc->table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                (GDestroyNotify) snippet_template_free);
+
+    for (current = sc->head; current; current = current->next) {
+        const gchar* comma = NULL;
+        gchar* key = NULL;
+
+        /* comments */
+        if (!current->second || !(comma = strchr (current->first, ',')))
+            continue;
+        key = g_strndup (current->first, comma - current->first);
+        if (!*key || g_hash_table_contains (sc->table, key)) {
+            g_free (key);
+            continue;
+        }
+        g_hash_table_insert (sc->table, key,
+                             snippet_template_new (current->second));
+    }
+    slog (L_DEBUG, "%d snippets indexed\n", g_hash_table_size (sc->table));
+}
+
+/* Edits in the snippets dialog only invalidate the table, it is built
+ * again on the next lookup */
+static GuSnippetTemplate* snippets_lookup (GuSnippets* sc, const gchar* term) {
+    if (!sc->table)
+        snippets_build_table (sc);
+    return g_hash_table_lookup (sc->table, term);
 }
 
 gchar* snippets_get_value (GuSnippets* sc, const gchar* term) {
-    gchar* key = g_strdup_printf ("%s,", term);
-    slist* index = slist_find (sc->head, key, TRUE, FALSE);
-    g_free (key);
-    return (index)? index->second: NULL;
+    GuSnippetTemplate* tpl = snippets_lookup (sc, term);
+    return (tpl)? tpl->snippet: NULL;
 }
 
 void snippets_set_accelerator (GuSnippets* sc, gchar* config) {
@@ -229,16 +273,16 @@ void snippets_set_accelerator (GuSnippets* sc, gchar* config) {
 }
 
 void snippets_activate (GuSnippets* sc, GuEditor* ec, gchar* key) {
-    gchar* snippet = NULL;
+    GuSnippetTemplate* tpl = NULL;
     GuSnippetInfo* new_info = NULL;
     GtkTextIter start, end;
 
     slog (L_DEBUG, "Snippet `%s' activated\n", key);
 
-    snippet = snippets_get_value (sc, key);
-    g_return_if_fail (snippet != NULL);
+    tpl = snippets_lookup (sc, key);
+    g_return_if_fail (tpl != NULL);
 
-    new_info = snippets_parse (snippet);
+    new_info = snippet_info_new_from_template (tpl);
 
     gtk_text_buffer_get_selection_bounds (ec_buffer, &start, &end);
     new_info->start_offset = gtk_text_iter_get_offset (&start);
@@ -335,58 +379,10 @@ gboolean snippets_key_release_cb (GuSnippets* sc, GuEditor* ec, GdkEventKey* ev)
 }
 
 GuSnippetInfo* snippets_parse (char* snippet) {
-    gint i, start, end;
-    GError* err = NULL;
-    gchar** result = NULL;
-    GRegex* regex = NULL;
-    GMatchInfo* match_info = NULL;
-    const gchar* holders[] = { "\\$([0-9]+)", "\\${([0-9]*):?([^}]*)}",
-                               "\\$(FILENAME)", "\\${(FILENAME)}",
-                               "\\$(BASENAME)", "\\${(BASENAME)}",
-                               "\\$(SELECTED_TEXT)", "\\${(SELECTED_TEXT)}"
-                               /* Anyway to combine these? */
-                            };
-
-    GuSnippetInfo* info = snippet_info_new (snippet);
-
-    for (i = 0; i < sizeof(holders) / sizeof(holders[0]); ++i) {
-        if (! (regex = g_regex_new (holders[i], G_REGEX_DOTALL, 0, &err))) {
-            slog (L_ERROR, "g_regex_new (): %s\n", err->message);
-            g_error_free (err);
-            return info;
-        }
-        g_regex_match (regex, snippet, 0, &match_info);
-        while (g_match_info_matches (match_info)) {
-            result = g_match_info_fetch_all (match_info);
-            g_match_info_fetch_pos (match_info, 0, &start, &end);
-
-            /* Convert start, end to UTF8 offset */
-            char* s_start = g_substr(snippet, 0, start);
-            char* s_end = g_substr(snippet, 0, end);
-            start = g_utf8_strlen(s_start, -1);
-            end = g_utf8_strlen(s_end, -1);
-            g_free(s_start);
-            g_free(s_end);
-
-            if (i < 2) {
-                snippet_info_append_holder (info, atoi (result[1]), start,
-                        end -start, result[2]);
-            } else {
-                snippet_info_append_holder (info, -1, start, end -start,
-                        result[1]);
-            }
-            slog (L_DEBUG, "Placeholder: (%s, %s, %s)\n", result[0], result[1],
-                    result[2]);
-            g_match_info_next (match_info, NULL);
-            g_strfreev (result);
-        }
-        g_regex_unref (regex);
-        g_match_info_free (match_info);
-    }
-    info->einfo = g_list_sort (info->einfo, snippet_info_pos_cmp);
-    info->einfo_sorted = g_list_copy (info->einfo);
-    info->einfo_sorted = g_list_sort (info->einfo_sorted, snippet_info_num_cmp);
+    GuSnippetTemplate* tpl = snippet_template_new (snippet);
+    GuSnippetInfo* info = snippet_info_new_from_template (tpl);
 
+    snippet_template_free (tpl);
     return info;
 }
 
@@ -436,6 +432,117 @@ void snippets_accel_disconnect (GuSnippets* sc, const gchar* key) {
     }
 }
 
+static const gchar* snippet_vars[] = {
+    "FILENAME", "BASENAME", "SELECTED_TEXT", NULL
+};
+
+/* Length of the variable name p starts with, 0 if it is none */
+static gsize snippet_var_len (const gchar* p) {
+    gint i;
+
+    for (i = 0; snippet_vars[i]; ++i) {
+        gsize len = strlen (snippet_vars[i]);
+        if (!strncmp (p, snippet_vars[i], len))
+            return len;
+    }
+    return 0;
+}
+
+static void snippet_template_add (GuSnippetTemplate* tpl, glong group,
+                                  gint start, gint len, const gchar* text,
+                                  gsize text_len) {
+    GuSnippetExpandInfo holder = { group, NULL, NULL, start, len, NULL };
+
+    holder.text = text? g_strndup (text, text_len): NULL;
+    g_array_append_val (tpl->holders, holder);
+    slog (L_DEBUG, "Placeholder: (%ld, %d, %d, %s)\n", group, start, len,
+          holder.text);
+}
+
+/**
+ * Finds $N, ${N:text}, $VAR and ${VAR} in one pass. Offsets are counted in
+ * characters, as the text buffer wants them. The default text of ${N:text}
+ * is looked into for the other forms, so that ${1:$FILENAME} works.
+ */
+GuSnippetTemplate* snippet_template_new (const gchar* snippet) {
+    GuSnippetTemplate* tpl = g_new0 (GuSnippetTemplate, 1);
+    const gchar* p = snippet;
+    const gchar* inner_end = NULL;
+    gint offset = 0;
+    gsize len = 0;
+
+    tpl->snippet = g_strdup (snippet);
+    tpl->holders = g_array_new (FALSE, FALSE, sizeof (GuSnippetExpandInfo));
+
+    while (*p) {
+        const gchar* q = p + 1;
+        const gchar* close = NULL;
+
+        if (inner_end && p >= inner_end)
+            inner_end = NULL;
+        if (*p != '$') {
+            p = g_utf8_next_char (p);
+            ++offset;
+            continue;
+        }
+
+        if (g_ascii_isdigit (*q)) {
+            glong group = 0;
+            while (g_ascii_isdigit (*q))
+                group = group * 10 + (*q++ - '0');
+            snippet_template_add (tpl, group, offset, q - p, NULL, 0);
+        } else if ((len = snippet_var_len (q))) {
+            snippet_template_add (tpl, -1, offset, len + 1, q, len);
+            q += len;
+        } else if (*q == '{' && (len = snippet_var_len (q + 1)) &&
+                   q[len + 1] == '}') {
+            snippet_template_add (tpl, -1, offset, len + 3, q + 1, len);
+            q += len + 2;
+        } else if (*q == '{' && !inner_end && (close = strchr (q, '}'))) {
+            glong group = 0;
+            ++q;
+            while (g_ascii_isdigit (*q))
+                group = group * 10 + (*q++ - '0');
+            if (*q == ':') ++q;
+            snippet_template_add (tpl, group, offset,
+                                  g_utf8_strlen (p, close + 1 - p),
+                                  q, close - q);
+            inner_end = close + 1;
+        } else {
+            q = p + 1;
+        }
+        offset += q - p;
+        p = q;
+    }
+    return tpl;
+}
+
+void snippet_template_free (GuSnippetTemplate* tpl) {
+    guint i;
+
+    for (i = 0; i < tpl->holders->len; ++i)
+        g_free (g_array_index (tpl->holders, GuSnippetExpandInfo, i).text);
+    g_array_free (tpl->holders, TRUE);
+    g_free (tpl->snippet);
+    g_free (tpl);
+}
+
+GuSnippetInfo* snippet_info_new_from_template (GuSnippetTemplate* tpl) {
+    GuSnippetInfo* info = snippet_info_new (tpl->snippet);
+    guint i;
+
+    for (i = 0; i < tpl->holders->len; ++i) {
+        GuSnippetExpandInfo* holder =
+            &g_array_index (tpl->holders, GuSnippetExpandInfo, i);
+        snippet_info_append_holder (info, holder->group_number, holder->start,
+                                    holder->len, holder->text);
+    }
+    info->einfo_sorted = g_list_copy (info->einfo);
+    info->einfo_sorted = g_list_sort (info->einfo_sorted, snippet_info_num_cmp);
+
+    return info;
+}
+
 GuSnippetInfo* snippet_info_new (gchar* snippet) {
     GuSnippetInfo* info = g_new0 (GuSnippetInfo, 1);
     info->snippet = g_strdup (snippet);
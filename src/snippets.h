@@ -52,6 +52,16 @@ struct _GuSnippetExpandInfo {
 };
 
 
+/* Placeholders of a snippet, found once when the snippets are loaded */
+#define GU_SNIPPET_TEMPLATE(x) ((GuSnippetTemplate*)x)
+typedef struct _GuSnippetTemplate GuSnippetTemplate;
+
+struct _GuSnippetTemplate {
+    gchar* snippet;
+    GArray* holders;    /* GuSnippetExpandInfo by start position, no marks */
+};
+
+
 /* Storing single snippet info */
 #define GU_SNIPPET_INFO(x) ((GuSnippetInfo*)x)
 typedef struct _GuSnippetInfo GuSnippetInfo;
@@ -78,6 +88,7 @@ typedef struct _GuSnippets GuSnippets;
 struct _GuSnippets {
     gchar* filename;
     slist* head;
+    GHashTable* table;   /* tab trigger -> GuSnippetTemplate, NULL if stale */
     GuSnippetInfo* info;
     GtkAccelGroup* accel_group;
     GList* stackframe;
@@ -89,6 +100,7 @@ void snippets_set_default (GuSnippets* sc);
 void snippets_load (GuSnippets* sc);
 void snippets_save (GuSnippets* sc);
 void snippets_clean_up (GuSnippets* sc);
+void snippets_invalidate (GuSnippets* sc);
 gchar* snippets_get_value (GuSnippets* sc, const gchar* term);
 void snippets_set_accelerator (GuSnippets* sc, gchar* config);
 void snippets_activate (GuSnippets* sc, GuEditor* ec, gchar* key);
@@ -102,7 +114,11 @@ void snippets_accel_connect (GuSnippets* sc, guint keyval, GdkModifierType mod,
         GClosure* closure);
 void snippets_accel_disconnect (GuSnippets* sc, const gchar* key);
 
+GuSnippetTemplate* snippet_template_new (const gchar* snippet);
+void snippet_template_free (GuSnippetTemplate* tpl);
+
 GuSnippetInfo* snippet_info_new (gchar* snippet);
+GuSnippetInfo* snippet_info_new_from_template (GuSnippetTemplate* tpl);
 void snippet_info_free (GuSnippetInfo* info, GuEditor* ec);
 void snippet_info_append_holder (GuSnippetInfo* info, gint group, gint start,
         gint len, gchar* text);
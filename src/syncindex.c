@@ -0,0 +1,397 @@
+/**
+ * @file   syncindex.c
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "syncindex.h"
+
+#include <string.h>
+
+#include <gdk/gdk.h>
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef WIN32
+  #include "syncTeX/synctex_parser.h"
+#else
+  #include <synctex_parser.h>
+#endif
+
+#include "constants.h"
+#include "utils.h"
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+// compatibility fixes for libsynctex (>=1.16 && <=2.00):
+#ifdef USE_SYNCTEX1
+  typedef synctex_scanner_t synctex_scanner_p;
+  typedef synctex_node_t synctex_node_p;
+  #define synctex_display_query(scanner, file, line, column, page) synctex_display_query(scanner, file, line, column)
+  #define synctex_scanner_next_result(scanner) synctex_next_result(scanner)
+#endif
+
+typedef struct {
+    gint tag;
+    gint line;
+    GuSyncBox box;
+} SyncLine;
+
+typedef struct {
+    GuSyncIndex* si;
+    guint generation;
+    gchar* pdffile;
+    gchar* synctex_file;
+    gint64 mtime;
+    gint64 size;
+
+    synctex_scanner_p scanner;
+    GArray* lines;
+} SyncBuild;
+
+GuSyncIndex* syncindex_new (GuSyncIndexFunc ready, gpointer user) {
+    GuSyncIndex* si = g_new0 (GuSyncIndex, 1);
+    si->ready = ready;
+    si->user = user;
+    return si;
+}
+
+static void syncindex_drop (GuSyncIndex* si) {
+    if (si->scanner) synctex_scanner_free (si->scanner);
+    if (si->lines) g_array_free (si->lines, TRUE);
+    g_free (si->synctex_file);
+    si->scanner = NULL;
+    si->lines = NULL;
+    si->synctex_file = NULL;
+    si->mtime = 0;
+    si->size = 0;
+}
+
+void syncindex_clear (GuSyncIndex* si) {
+    syncindex_drop (si);
+    si->pending_mtime = 0;
+    ++si->generation;
+}
+
+/* Builds that are still running hand their result to si, it is freed
+ * when the last of them is done */
+void syncindex_free (GuSyncIndex* si) {
+    if (!si) return;
+
+    syncindex_clear (si);
+    si->ready = NULL;
+    if (si->running)
+        si->freed = TRUE;
+    else
+        g_free (si);
+}
+
+static gboolean syncindex_stat (const gchar* path, gint64* mtime,
+                                gint64* size) {
+    GFile* file = g_file_new_for_path (path);
+    GFileInfo* info = g_file_query_info (file,
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                                         G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    g_object_unref (file);
+    if (!info) return FALSE;
+
+    /* seconds alone can't tell apart two compiles of a short document */
+    *mtime = g_file_info_get_attribute_uint64 (info,
+                        G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+             g_file_info_get_attribute_uint32 (info,
+                        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    *size = g_file_info_get_size (info);
+    g_object_unref (info);
+    return TRUE;
+}
+
+/* -synctex=-1 writes name.synctex, the other build routes name.synctex.gz.
+ * Whichever was written last belongs to the current pdf. */
+static gchar* syncindex_find_file (const gchar* pdffile, gint64* mtime,
+                                   gint64* size) {
+    const gchar* exts[] = { ".synctex", ".synctex.gz", NULL };
+    gint len = strlen (pdffile) - (g_str_has_suffix (pdffile, ".pdf")? 4: 0);
+    gchar* found = NULL;
+    gint i = 0;
+
+    for (i = 0; exts[i]; ++i) {
+        gchar* path = g_strdup_printf ("%.*s%s", len, pdffile, exts[i]);
+        gint64 path_mtime = 0;
+        gint64 path_size = 0;
+
+        if (syncindex_stat (path, &path_mtime, &path_size) &&
+            (!found || path_mtime > *mtime)) {
+            g_free (found);
+            found = path;
+            *mtime = path_mtime;
+            *size = path_size;
+        } else {
+            g_free (path);
+        }
+    }
+    return found;
+}
+
+static GuSyncBox syncindex_node_box (synctex_node_p node) {
+    GuSyncBox box;
+
+    box.page = synctex_node_page (node) - 1;
+    box.x = synctex_node_box_visible_h (node);
+    box.width = synctex_node_box_visible_width (node);
+    box.height = synctex_node_box_visible_height (node);
+    box.y = synctex_node_box_visible_v (node) - box.height;
+    return box;
+}
+
+/* Every node that knows its input line maps that line onto the horizontal
+ * box it sits in, which is also what synctex_display_query reports */
+static void syncindex_collect (GArray* lines, synctex_node_p node,
+                               const GuSyncBox* hbox) {
+    for (; node; node = synctex_node_sibling (node)) {
+        synctex_node_p child = NULL;
+        gboolean is_hbox = FALSE;
+        GuSyncBox own;
+        const GuSyncBox* box = hbox;
+
+        switch (synctex_node_type (node)) {
+            case synctex_node_type_hbox:
+            case synctex_node_type_void_hbox:
+                own = syncindex_node_box (node);
+                box = &own;
+                is_hbox = TRUE;
+                break;
+            default:
+                break;
+        }
+
+        if (box && synctex_node_tag (node) > 0 && synctex_node_line (node) > 0) {
+            SyncLine entry = { synctex_node_tag (node),
+                               synctex_node_line (node), *box };
+            g_array_append_val (lines, entry);
+        }
+        if ((child = synctex_node_child (node))) {
+            syncindex_collect (lines, child, is_hbox? &own: NULL);
+        }
+    }
+}
+
+static gint syncindex_compare (gconstpointer a, gconstpointer b) {
+    const SyncLine* la = a;
+    const SyncLine* lb = b;
+
+    if (la->tag != lb->tag) return la->tag - lb->tag;
+    if (la->line != lb->line) return la->line - lb->line;
+    if (la->box.page != lb->box.page) return la->box.page - lb->box.page;
+    if (la->box.y != lb->box.y) return la->box.y - lb->box.y;
+    if (la->box.x != lb->box.x) return la->box.x - lb->box.x;
+    if (la->box.width != lb->box.width) return la->box.width - lb->box.width;
+    return la->box.height - lb->box.height;
+}
+
+static void syncindex_build_free (SyncBuild* build) {
+    if (build->scanner) synctex_scanner_free (build->scanner);
+    if (build->lines) g_array_free (build->lines, TRUE);
+    g_free (build->synctex_file);
+    g_free (build->pdffile);
+    g_free (build);
+}
+
+static gboolean syncindex_build_finished (gpointer data) {
+    SyncBuild* build = data;
+    GuSyncIndex* si = build->si;
+
+    --si->running;
+    if (si->freed) {
+        if (!si->running) g_free (si);
+        syncindex_build_free (build);
+        return FALSE;
+    }
+    if (build->generation != si->generation) {
+        syncindex_build_free (build);
+        return FALSE;
+    }
+
+    syncindex_drop (si);
+    si->pending_mtime = 0;
+    if (build->scanner) {
+        si->scanner = build->scanner;
+        si->lines = build->lines;
+        si->synctex_file = build->synctex_file;
+        si->mtime = build->mtime;
+        si->size = build->size;
+        build->scanner = NULL;
+        build->lines = NULL;
+        build->synctex_file = NULL;
+    }
+    syncindex_build_free (build);
+
+    if (si->ready) si->ready (si, si->user);
+    return FALSE;
+}
+
+static gpointer syncindex_build_thread (gpointer data) {
+    SyncBuild* build = data;
+    gint64 start = g_get_monotonic_time ();
+    synctex_node_p sheet = NULL;
+    guint unique = 0;
+    guint i = 0;
+    gint page = 0;
+
+    build->scanner = synctex_scanner_new_with_output_file (build->pdffile,
+                                                           C_TMPDIR, 1);
+    if (build->scanner) {
+        build->lines = g_array_new (FALSE, FALSE, sizeof (SyncLine));
+        for (page = 1; (sheet = synctex_sheet_content (build->scanner, page));
+             ++page) {
+            syncindex_collect (build->lines, sheet, NULL);
+        }
+
+        /* many nodes of a line share the same box */
+        g_array_sort (build->lines, syncindex_compare);
+        for (i = 0; i < build->lines->len; ++i) {
+            if (unique == 0 || syncindex_compare (
+                    &g_array_index (build->lines, SyncLine, unique - 1),
+                    &g_array_index (build->lines, SyncLine, i)) != 0) {
+                g_array_index (build->lines, SyncLine, unique++) =
+                    g_array_index (build->lines, SyncLine, i);
+            }
+        }
+        g_array_set_size (build->lines, unique);
+
+        slog (L_DEBUG, "synctex index of %d pages, %u line boxes built in "
+                       "%.1f ms\n", page - 1, unique,
+                       (g_get_monotonic_time () - start) / 1000.0);
+    } else {
+        slog (L_WARNING, "unable to parse %s\n", build->synctex_file);
+    }
+
+    gdk_threads_add_idle (syncindex_build_finished, build);
+    return NULL;
+}
+
+gboolean syncindex_update (GuSyncIndex* si, const gchar* pdffile) {
+    SyncBuild* build = NULL;
+    gint64 mtime = 0;
+    gint64 size = 0;
+    gchar* path = syncindex_find_file (pdffile, &mtime, &size);
+
+    if (!path) {
+        syncindex_clear (si);
+        return FALSE;
+    }
+    if (si->scanner && STR_EQU (path, si->synctex_file) &&
+        mtime == si->mtime && size == si->size) {
+        g_free (path);
+        return TRUE;
+    }
+
+    if (si->pending_mtime == mtime) {
+        g_free (path);
+        return FALSE;
+    }
+
+    /* a running build is superseded, its result gets dropped */
+    build = g_new0 (SyncBuild, 1);
+    build->si = si;
+    build->generation = ++si->generation;
+    build->pdffile = g_strdup (pdffile);
+    build->synctex_file = path;
+    build->mtime = mtime;
+    build->size = size;
+    si->pending_mtime = mtime;
+    ++si->running;
+
+    g_thread_unref (g_thread_new ("synctex", syncindex_build_thread, build));
+    return FALSE;
+}
+
+static guint syncindex_lower_bound (GArray* lines, gint tag, gint line) {
+    guint low = 0;
+    guint high = lines->len;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        SyncLine* entry = &g_array_index (lines, SyncLine, mid);
+        if (entry->tag < tag || (entry->tag == tag && entry->line < line))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+GArray* syncindex_forward (GuSyncIndex* si, const gchar* tex_file,
+                           gint line, gint column) {
+    GArray* boxes = NULL;
+    gint found = -1;
+    gint tag = 0;
+    guint i = 0;
+
+    if (!si->scanner) return NULL;
+
+    boxes = g_array_new (FALSE, FALSE, sizeof (GuSyncBox));
+    if ((tag = synctex_scanner_get_tag (si->scanner, tex_file)) > 0) {
+        for (i = syncindex_lower_bound (si->lines, tag, line);
+             i < si->lines->len; ++i) {
+            SyncLine* entry = &g_array_index (si->lines, SyncLine, i);
+            if (entry->tag != tag || (found != -1 && entry->line != found))
+                break;
+            found = entry->line;
+            g_array_append_val (boxes, entry->box);
+        }
+    }
+
+    /* the scanner is more lenient about how file names are spelled */
+    if (boxes->len == 0 &&
+        synctex_display_query (si->scanner, tex_file, line, column, -1) > 0) {
+        synctex_node_p node = NULL;
+        while ((node = synctex_scanner_next_result (si->scanner))) {
+            GuSyncBox box = syncindex_node_box (node);
+            g_array_append_val (boxes, box);
+        }
+    }
+    return boxes;
+}
+
+gboolean syncindex_reverse (GuSyncIndex* si, gint page, gdouble x, gdouble y,
+                            gchar** file, gint* line) {
+    synctex_node_p node = NULL;
+
+    if (!si->scanner) return FALSE;
+
+    if (synctex_edit_query (si->scanner, page + 1, x, y) > 0 &&
+        (node = synctex_scanner_next_result (si->scanner))) {
+        *file = g_strdup (synctex_scanner_get_name (si->scanner,
+                                                    synctex_node_tag (node)));
+        *line = synctex_node_line (node);
+        return TRUE;
+    }
+    return FALSE;
+}
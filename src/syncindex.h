@@ -0,0 +1,95 @@
+/**
+ * @file   syncindex.h
+ * @brief
+ *
+ * Copyright (C) 2009 Gummi Developers
+ * All Rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GUMMI_SYNCINDEX_H__
+#define __GUMMI_SYNCINDEX_H__
+
+#include <glib.h>
+
+#define GU_SYNC_INDEX(x) ((GuSyncIndex*)x)
+typedef struct _GuSyncIndex GuSyncIndex;
+
+typedef struct {
+    gint page;          /* counted from 0 like poppler does */
+    gint x;             /* upper left corner, in pdf points */
+    gint y;
+    gint width;
+    gint height;
+} GuSyncBox;
+
+typedef void (*GuSyncIndexFunc) (GuSyncIndex* si, gpointer user);
+
+/**
+ * GuSyncIndex:
+ *
+ * Keeps the parsed SyncTeX data of one document around between refreshes.
+ * Parsing happens on a worker thread whenever the .synctex(.gz) file was
+ * rewritten, the finished scanner and a line to box table sorted by
+ * (file, line) replace the previous ones on the main thread.
+ */
+struct _GuSyncIndex {
+    gpointer scanner;       /* synctex_scanner_p, NULL while none is ready */
+    GArray* lines;          /* sorted line to box table */
+    gchar* synctex_file;    /* file the scanner was parsed from */
+    gint64 mtime;
+    gint64 size;
+
+    gint64 pending_mtime;   /* of the file a build is running for, or 0 */
+    guint generation;       /* drops results of superseded builds */
+    guint running;          /* builds that have not reported back yet */
+    gboolean freed;         /* goes away once the last of them did */
+    GuSyncIndexFunc ready;
+    gpointer user;
+};
+
+GuSyncIndex* syncindex_new (GuSyncIndexFunc ready, gpointer user);
+void syncindex_free (GuSyncIndex* si);
+void syncindex_clear (GuSyncIndex* si);
+
+/**
+ * syncindex_update:
+ *
+ * Returns TRUE when the index is up to date with the SyncTeX output of
+ * @pdffile. Otherwise a rebuild is started, if none is running yet, and
+ * the ready callback fires once it is done.
+ */
+gboolean syncindex_update (GuSyncIndex* si, const gchar* pdffile);
+
+/**
+ * syncindex_forward:
+ *
+ * Looks up the boxes typeset from @line of @tex_file, or from the next
+ * line that produced output. Returns NULL when no index is ready.
+ */
+GArray* syncindex_forward (GuSyncIndex* si, const gchar* tex_file,
+                           gint line, gint column);
+gboolean syncindex_reverse (GuSyncIndex* si, gint page, gdouble x, gdouble y,
+                            gchar** file, gint* line);
+
+#endif /* __GUMMI_SYNCINDEX_H__ */
@@ -41,6 +41,7 @@ GuTabmanager* tabmanager_init (void) {
     tm->tabs = NULL;
     tm->active_editor = NULL;
     tm->active_tab = NULL;
+    tm->previewed = NULL;
 
     return tm;
 }
@@ -90,12 +91,27 @@ gint tabmanager_remove_tab (GuTabContext* tab) {
     g_tabs = g_list_remove (g_tabs, tab);
     tabmanager_set_active_tab (total - 2);
 
+    previewgui_drop_session (gui->previewgui, tab->preview);
+    if (gummi->tabmanager->previewed == tab)
+        gummi->tabmanager->previewed = NULL;
+
+    // a worker may still be compiling it
+    motion_forget_editor (gummi->motion, tab->editor);
     editor_destroy (tab->editor);
     gtk_notebook_remove_page (g_tabnotebook, position);
     g_free (tab);
     return (total - 1); // return number of remaining tabs
 }
 
+gboolean tabmanager_has_editor (GuEditor* ec) {
+    GList* tab = NULL;
+
+    for (tab = g_tabs; tab; tab = tab->next) {
+        if (GU_TAB_CONTEXT (tab->data)->editor == ec) return TRUE;
+    }
+    return FALSE;
+}
+
 /*--------------------------------------------------------------------------*/
 
 
@@ -110,6 +126,33 @@ void tabmanager_set_active_tab (int position) {
     }
 }
 
+/* Parks the preview of the tab that was shown and brings back the one of
+ * the active tab. Only when the active tab has none parked, or it is still
+ * the one shown, the preview is reset and a compile is started */
+void tabmanager_show_preview (void) {
+    GuTabmanager* tm = gummi->tabmanager;
+    GuTabContext* shown = tm->previewed;
+    GuPreviewSession* session = NULL;
+
+    if (shown != g_active_tab) {
+        // closed tabs have given up their session already
+        if (shown && g_list_find (g_tabs, shown))
+            shown->preview = previewgui_park_session (gui->previewgui);
+
+        if (g_active_tab) {
+            session = g_active_tab->preview;
+            g_active_tab->preview = NULL;
+        }
+        tm->previewed = g_active_tab;
+    }
+
+    if (previewgui_resume_session (gui->previewgui, session)) {
+        // compiles only when the text changed since the last run
+        motion_do_compile (gummi->motion);
+    } else {
+        previewgui_reset (gui->previewgui);
+    }
+}
 
 void tabmanager_create_tab (OpenAct act, const gchar* filename, gchar* opt) {
     gint pos = 0;
@@ -140,7 +183,7 @@ void tabmanager_create_tab (OpenAct act, const gchar* filename, gchar* opt) {
     gui_set_filename_display (g_active_tab, TRUE, TRUE);
     add_to_recent_list (editor->filename);
 
-    previewgui_reset (gui->previewgui);
+    tabmanager_show_preview ();
 }
 
 void tabmanager_set_content (OpenAct act, const gchar* filename, gchar* opt) {
@@ -177,7 +220,7 @@ void tabmanager_update_tab (const gchar* filename) {
 
     slog (L_INFO, "Environment updated for %s\n",
             g_active_tab->editor->filename);
-    previewgui_reset (gui->previewgui);
+    tabmanager_show_preview ();
 }
 
 gboolean tabmanager_has_tabs () {
@@ -204,3 +247,26 @@ gboolean tabmanager_check_exists (const gchar* filename) {
     }
     return FALSE;
 }
+
+/* Switches to the tab editing @filename, which may also be the workfile
+ * of a tab, and opens the file in a new tab when none does */
+GuEditor* tabmanager_activate_file (const gchar* filename) {
+    GList* tabs = NULL;
+    gint pos = 0;
+
+    for (tabs = g_tabs; tabs; tabs = tabs->next, ++pos) {
+        GuEditor* ec = GU_TAB_CONTEXT (tabs->data)->editor;
+        if (STR_EQU (ec->filename, filename) ||
+            STR_EQU (ec->workfile, filename)) {
+            if (ec != g_active_editor) {
+                tabmanagergui_set_current_page (pos);
+            }
+            return ec;
+        }
+    }
+
+    if (!utils_path_exists (filename)) return NULL;
+
+    tabmanager_create_tab (A_LOAD, filename, NULL);
+    return g_active_editor;
+}
@@ -51,15 +51,18 @@ typedef struct _GuTabmanager GuTabmanager;
 struct _GuTabmanager {
     GuEditor* active_editor;
     GuTabContext* active_tab;
+    GuTabContext* previewed;    // tab the preview currently shows
     GList* tabs;
 };
 
 GuTabmanager* tabmanager_init (void);
 
 void tabmanager_foreach_editor (GFunc func, gpointer user_data);
+gboolean tabmanager_has_editor (GuEditor* ec);
 
 gchar* tabmanager_get_tabname (GuTabContext* tc);
 void tabmanager_set_active_tab (int position);
+void tabmanager_show_preview (void);
 
 gint tabmanager_remove_tab (GuTabContext* tab);
 
@@ -69,6 +72,7 @@ void tabmanager_create_tab (OpenAct act, const gchar* filename, gchar* opt);
 void tabmanager_update_tab (const gchar* filename);
 gboolean tabmanager_has_tabs ();
 gboolean tabmanager_check_exists (const gchar* filename);
+GuEditor* tabmanager_activate_file (const gchar* filename);
 
 void tabmanager_set_content (OpenAct act, const gchar* filename, gchar* opt);
 
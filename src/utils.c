@@ -28,6 +28,7 @@
  */
 
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -43,6 +44,7 @@
 #else
     #include <sys/types.h>
     #include <sys/wait.h>
+    #include <sys/resource.h>
 #endif
 
 #ifndef WEXITSTATUS
@@ -73,7 +75,6 @@
 static gint slog_debug = 0;
 static GtkWindow* parent = 0;
 GThread* main_thread = 0;
-extern pid_t typesetter_pid;
 
 
 void slog_init (gint debug) {
@@ -318,16 +319,117 @@ gboolean utils_copy_file (const gchar* source, const gchar* dest, GError** err)
     return TRUE;
 }
 
+gboolean utils_publish_file (const gchar* source, const gchar* dest,
+                             GError** err) {
+    static gint serial = 0;
+    gchar* partial = NULL;
+    gboolean ok = FALSE;
+
+    g_return_val_if_fail (source != NULL, FALSE);
+    g_return_val_if_fail (dest != NULL, FALSE);
+    g_return_val_if_fail (err == NULL || *err == NULL, FALSE);
+
+#ifndef WIN32
+    /* source must not stay a second name of dest, the next run of a
+     * typesetter would truncate and rewrite the published file in place */
+    if (g_rename (source, dest) == 0)
+        return TRUE;
+#endif
+
+    /* other file system: copy next to dest so that the rename stays on one
+     * file system. Its name is unique, concurrent publishes to dest must
+     * not share it */
+    partial = g_strdup_printf ("%s.%d-%d.part", dest, (gint)getpid (),
+                               g_atomic_int_add (&serial, 1));
+    g_remove (partial);
+    if (!utils_copy_file (source, partial, err)) {
+        g_remove (partial);
+        g_free (partial);
+        return FALSE;
+    }
+#ifdef WIN32
+    /* rename does not replace existing files here */
+    g_remove (dest);
+#endif
+    ok = (g_rename (partial, dest) == 0);
+    if (!ok) {
+        g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "%s: %s", dest, g_strerror (errno));
+        g_remove (partial);
+    } else {
+        g_remove (source);
+    }
+    g_free (partial);
+    return ok;
+}
+
+void utils_remove_tree (const gchar* path) {
+    GDir* dir = NULL;
+    const gchar* name = NULL;
+
+    if ((dir = g_dir_open (path, 0, NULL))) {
+        while ((name = g_dir_read_name (dir))) {
+            gchar* child = g_build_filename (path, name, NULL);
+            if (g_file_test (child, G_FILE_TEST_IS_DIR) &&
+                !g_file_test (child, G_FILE_TEST_IS_SYMLINK)) {
+                utils_remove_tree (child);
+            } else {
+                g_remove (child);
+            }
+            g_free (child);
+        }
+        g_dir_close (dir);
+    }
+    g_rmdir (path);
+}
+
 Tuple2 utils_popen_r (const gchar* cmd, const gchar* chdir) {
-    gchar buf[BUFSIZ];
+    return utils_popen_r_lines (cmd, chdir, NULL, NULL, NULL, 0);
+}
+
+#ifndef WIN32
+typedef struct {
+    gint niceness;
+    gboolean own_group;
+} UtilsChildSetup;
+
+/* Runs in the child between fork and exec */
+static void utils_child_setup (gpointer user) {
+    UtilsChildSetup* setup = user;
+
+    if (setup->own_group)
+        setpgid (0, 0);
+    if (setup->niceness > 0)
+        setpriority (PRIO_PROCESS, 0,
+                     getpriority (PRIO_PROCESS, 0) + setup->niceness);
+}
+#endif
+
+/* Output that is not valid UTF-8 is assumed to be latin-1, see bug 446 */
+static gchar* utils_output_to_utf8 (const gchar* text, gssize len) {
+    if (g_utf8_validate (text, len, NULL)) {
+        return NULL;
+    }
+    return g_convert_with_fallback (text, len, "UTF-8", "ISO-8859-1",
+                                    NULL, NULL, NULL, NULL);
+}
+
+Tuple2 utils_popen_r_lines (const gchar* cmd, const gchar* chdir,
+                            GuLineFunc func, gpointer user,
+                            GuPidFunc pid_func, gint niceness) {
+    GPid child = 0;
+    GSpawnChildSetupFunc setup = NULL;
+    gpointer setup_data = NULL;
     int pout = 0;
     gchar* ret = NULL;
-    gchar* rot = NULL;
-    glong len = 0;
     gint status = 0;
     int n_args = 0;
     gchar** args = NULL;
     GError* error = NULL;
+    GIOChannel* channel = NULL;
+    GString* output = NULL;
+    GString* line = NULL;
+    gsize terminator = 0;
 
     g_assert (cmd != NULL);
 
@@ -337,40 +439,78 @@ Tuple2 utils_popen_r (const gchar* cmd, const gchar* chdir) {
         /* Not reached */
     }
 
+#ifndef WIN32
+    /* Commands that can be cancelled lead a process group of their own, so
+     * that the helpers they start can be signalled along with them */
+    UtilsChildSetup child_setup = { niceness, pid_func != NULL };
+    if (niceness > 0 || pid_func) {
+        setup = utils_child_setup;
+        setup_data = &child_setup;
+    }
+#endif
     if (!g_spawn_async_with_pipes (chdir, args, NULL,
                 G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
-                NULL, NULL, &typesetter_pid, NULL, &pout, NULL, &error)) {
+                setup, setup_data, &child, NULL, &pout,
+                NULL, &error)) {
         slog(L_G_FATAL, "%s", error->message);
         /* Not reached */
     }
-
-    // TODO: replace with GIOChannel implementation:
-    while ((len = read (pout, buf, BUFSIZ)) > 0) {
-        buf[len - (len == BUFSIZ)] = 0;
-        rot = g_strdup (ret);
-        g_free (ret);
-        if (ret)
-            ret = g_strconcat (rot, buf, NULL);
-        else
-            ret = g_strdup (buf);
-        g_free (rot);
+    g_strfreev (args);
+#ifndef WIN32
+    /* also from this side, the group must exist before pid is handed out */
+    if (pid_func) setpgid (child, child);
+#endif
+    if (pid_func) pid_func (child, user);
+
+    /* The output is collected into a single growing buffer, typesetters
+     * can easily write megabytes with verbose packages loaded. Lines are
+     * handed to func as soon as the child prints them. */
+    output = g_string_sized_new (BUFSIZ);
+    line = g_string_sized_new (256);
+
+    channel = g_io_channel_unix_new (pout);
+    g_io_channel_set_encoding (channel, NULL, NULL);
+    g_io_channel_set_close_on_unref (channel, TRUE);
+
+    while (g_io_channel_read_line_string (channel, line, &terminator,
+                                          &error) == G_IO_STATUS_NORMAL) {
+        g_string_append_len (output, line->str, line->len);
+
+        if (func) {
+            gchar* converted = utils_output_to_utf8 (line->str, terminator);
+            if (converted) {
+                func (converted, user);
+                g_free (converted);
+            } else {
+                g_string_truncate (line, terminator);
+                func (line->str, user);
+            }
+        }
+    }
+    if (error) {
+        slog (L_ERROR, "Error reading output of %s: %s\n", cmd,
+                       error->message);
+        g_error_free (error);
     }
 
     // close the file descriptor:
-    close(pout);
+    g_io_channel_unref (channel);
+    g_string_free (line, TRUE);
+
+    // nobody may signal the pid once it is reaped
+    if (pid_func) pid_func (0, user);
 
     #ifdef WIN32 // TODO: check this
-        status = WaitForSingleObject(typesetter_pid, INFINITE);
+        status = WaitForSingleObject(child, INFINITE);
     #else
-        waitpid(typesetter_pid, &status, 0);
+        waitpid(child, &status, 0);
     #endif
 
-    // See bug 446:
-    if (ret) {
-        if (!g_utf8_validate (ret, -1, NULL)) {
-            ret = g_convert_with_fallback (ret, -1, "UTF-8",
-                    "ISO-8859-1", NULL, NULL, NULL, NULL);
-        }
+    ret = utils_output_to_utf8 (output->str, output->len);
+    if (ret == NULL && output->len > 0) {
+        ret = g_string_free (output, FALSE);
+    } else {
+        g_string_free (output, TRUE);
     }
 
     return (Tuple2){NULL, (gpointer)(glong)status, (gpointer)ret};
@@ -132,6 +132,25 @@ gchar* utils_pango_font_desc_to_css (PangoFontDescription* font_desc);
  */
 gboolean utils_copy_file (const gchar* source, const gchar* dest, GError** err);
 
+/**
+ * utils_publish_file:
+ *
+ * Returns: return TRUE if succeed
+ *
+ * Moves source over dest in a single rename, readers of dest see either
+ * the old or the new file, never a partial one. source is gone afterwards,
+ * also when it had to be copied to another file system.
+ */
+gboolean utils_publish_file (const gchar* source, const gchar* dest,
+                             GError** err);
+
+/**
+ * utils_remove_tree:
+ *
+ * Removes a directory with everything below it.
+ */
+void utils_remove_tree (const gchar* path);
+
 /**
  * utils_popen_r:
  *
@@ -142,6 +161,26 @@ gboolean utils_copy_file (const gchar* source, const gchar* dest, GError** err);
  */
 Tuple2 utils_popen_r (const gchar* cmd, const gchar* chdir);
 
+typedef void (*GuLineFunc) (const gchar* line, gpointer user);
+typedef void (*GuPidFunc) (GPid pid, gpointer user);
+
+/**
+ * utils_popen_r_lines:
+ *
+ * Returns: Same as utils_popen_r
+ *
+ * Like utils_popen_r, but also calls func with every line of output (without
+ * the line terminator) while the command is still running. func is called
+ * from the thread that runs the command. If pid_func is not NULL the
+ * command leads a process group of its own; pid_func is called with its
+ * process id once it runs and with 0 before it is reaped, so that the id
+ * is never handed out after it may have been reused. A positive niceness
+ * lowers the priority of the command.
+ */
+Tuple2 utils_popen_r_lines (const gchar* cmd, const gchar* chdir,
+                            GuLineFunc func, gpointer user,
+                            GuPidFunc pid_func, gint niceness);
+
 /**
  * utils_path_to_relative:
  *